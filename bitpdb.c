@@ -33,6 +33,7 @@
 #include <sys/mman.h>
 
 #include "bitpdb.h"
+#include "hugepage.h"
 #include "index.h"
 #include "puzzle.h"
 #include "tileset.h"
@@ -49,13 +50,18 @@ bitpdb_allocate(tileset ts)
 	struct bitpdb *bpdb;
 	int error;
 
-	bpdb = malloc(sizeof *bpdb);
+	bpdb = aligned_alloc(alignof(struct bitpdb), sizeof *bpdb);
 	if (bpdb == NULL)
 		return (NULL);
 
 	make_index_aux(&bpdb->aux, ts);
 	bpdb->mapped = 0;
-	bpdb->data = malloc(bitpdb_size(&bpdb->aux));
+	bpdb->huge = HUGE_NONE;
+	if (huge_pages)
+		bpdb->data = huge_alloc(bitpdb_size(&bpdb->aux), &bpdb->huge);
+	else
+		bpdb->data = malloc(bitpdb_size(&bpdb->aux));
+
 	if (bpdb->data == NULL) {
 		error = errno;
 		free(bpdb);
@@ -73,8 +79,8 @@ extern void
 bitpdb_free(struct bitpdb *bpdb)
 {
 
-	if (bpdb->mapped)
-		munmap(bpdb->data, bitpdb_size(&bpdb->aux));
+	if (bpdb->mapped || bpdb->huge != HUGE_NONE)
+		huge_unmap(bpdb->data, bitpdb_size(&bpdb->aux), bpdb->huge);
 	else
 		free(bpdb->data);
 
@@ -151,7 +157,8 @@ bitpdb_store(FILE *f, struct bitpdb *bpdb)
  * Load a bitpdb from file descriptor fd by mapping it into RAM.  This
  * might perform better than bitpdb_load().  Use flags to decide what
  * protection the mapping has and whether changes are written back to
- * the input file.
+ * the input file.  If the file is on hugetlbfs, the mapping is backed
+ * by huge pages.
  */
 extern struct bitpdb *
 bitpdb_mmap(tileset ts, int fd, int mapflags)
@@ -180,13 +187,13 @@ bitpdb_mmap(tileset ts, int fd, int mapflags)
 		return (NULL);
 	}
 
-	bpdb = malloc(sizeof *bpdb);
+	bpdb = aligned_alloc(alignof(struct bitpdb), sizeof *bpdb);
 	if (bpdb == NULL)
 		return (NULL);
 
 	make_index_aux(&bpdb->aux, ts);
 	bpdb->mapped = 1;
-	bpdb->data = mmap(NULL, bitpdb_size(&bpdb->aux), prot, flags, fd, 0);
+	bpdb->data = huge_map(bitpdb_size(&bpdb->aux), prot, flags, fd, &bpdb->huge);
 	if (bpdb->data == MAP_FAILED) {
 		error = errno;
 		free(bpdb);
@@ -282,6 +289,39 @@ bitpdb_diff_lookup(struct bitpdb *bpdb, const struct puzzle *p, int old_h)
 	return (bitpdb_diff_lookup_idx(bpdb, p, old_h, &idx));
 }
 
+/*
+ * Compute the bit offset of the entry for p in bpdb, prefetch the
+ * entry and return the offset.  This is the first half of a
+ * differential lookup split into two parts for better memory level
+ * parallelism.
+ */
+extern size_t
+bitpdb_locate(struct bitpdb *bpdb, const struct puzzle *p)
+{
+	struct index idx;
+	size_t offset;
+
+	compute_index(&bpdb->aux, &idx, p);
+	offset = index_offset(&bpdb->aux, &idx);
+	prefetch(bpdb->data + offset / CHAR_BIT);
+
+	return (offset);
+}
+
+/*
+ * Finish a differential lookup started with bitpdb_locate(), which
+ * returned offset.  old_h is as in bitpdb_diff_lookup().
+ */
+extern int
+bitpdb_fetch(struct bitpdb *bpdb, size_t offset, int old_h)
+{
+	int entry;
+
+	entry = (bpdb->data[offset / CHAR_BIT] >> (offset % CHAR_BIT) & 1) << 1;
+
+	return (old_h + 1 - ((entry ^ old_h ^ old_h << 1) & 2));
+}
+
 /*
  * Determine the h value for puzzle configuration p by looking up a
  * shortest path in the quotient graph induced by bpdb->aux.ts in bpdb.
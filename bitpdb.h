@@ -68,6 +68,7 @@
 struct bitpdb {
 	struct index_aux aux;
 	int mapped;
+	int huge; /* how data is backed by huge pages, see hugepage.h */
 	unsigned char *data;
 };
 
@@ -80,6 +81,8 @@ extern int		 bitpdb_store(FILE *, struct bitpdb *);
 extern struct bitpdb	*bitpdb_from_pdb(struct patterndb *);
 extern int		 bitpdb_lookup_puzzle(struct bitpdb *, const struct puzzle *);
 extern int		 bitpdb_diff_lookup(struct bitpdb *, const struct puzzle *, int);
+extern size_t		 bitpdb_locate(struct bitpdb *, const struct puzzle *);
+extern int		 bitpdb_fetch(struct bitpdb *, size_t, int);
 
 /* bitpdbzstd.c */
 
@@ -28,10 +28,13 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "builtins.h"
 #include "catalogue.h"
@@ -39,9 +42,168 @@
 #include "puzzle.h"
 #include "tileset.h"
 #include "heuristic.h"
+#include "hugepage.h"
+#include "numa.h"
+#include "perimeter.h"
+#include "warmup.h"
 
 enum { LINEBUF_LEN = 512 };
 
+/*
+ * Note in cat->tile_heus that the PDB with index pdbidx contains the
+ * tiles in cat->pdbs_ts[pdbidx].
+ */
+static void
+add_tile_heus(struct pdb_catalogue *cat, size_t pdbidx)
+{
+	tileset ts;
+
+	for (ts = cat->pdbs_ts[pdbidx]; !tileset_empty(ts); ts = tileset_remove_least(ts))
+		cat->tile_heus[tileset_get_least(ts)] |= 1ull << pdbidx;
+}
+
+/*
+ * Fill in cat->plan from cat->parts.
+ */
+static void
+compile_plan(struct pdb_catalogue *cat)
+{
+	unsigned long long parts;
+	size_t i;
+
+	memset(cat->plan, 0, sizeof cat->plan);
+	for (i = 0; i < cat->n_heuristics; i++)
+		for (parts = cat->parts[i]; parts != 0; parts &= parts - 1)
+			cat->plan[i][ctzll(parts)] = 0xff;
+}
+
+/*
+ * Add the PDBs in heus that are suitable for the vectorised index
+ * functions to the array of n_batches batches, adding new batches as
+ * needed but no more than max in total.  Return a bitmap of the PDBs
+ * added.
+ */
+static unsigned long long
+add_batches(struct index_batch *batches, unsigned char *n_batches, size_t max,
+    struct pdb_catalogue *cat, unsigned long long heus)
+{
+	struct heuristic *heu;
+	struct patterndb *pdb;
+	struct index_batch *b;
+	const struct index_table *idxt;
+	unsigned long long added = 0;
+	size_t i, j;
+	tileset tsnz;
+
+	for (; heus != 0; heus &= heus - 1) {
+		i = ctzll(heus);
+		heu = cat->heus + i;
+
+		/* only PDBs provide hdata */
+		if (heu->hdata == NULL)
+			continue;
+
+		pdb = heu->provider;
+		tsnz = tileset_remove(pdb->aux.ts, ZERO_TILE);
+		if (tileset_count(tsnz) != 6)
+			continue;
+
+		idxt = tileset_has(pdb->aux.ts, ZERO_TILE) ? pdb->aux.idxt : NULL;
+		for (j = 0; j < *n_batches; j++)
+			if (batches[j].morphism == heu->morphism && batches[j].idxt == idxt
+			    && batches[j].n_lanes < VECTORWIDTH)
+				break;
+
+		if (j == *n_batches) {
+			if (j >= max)
+				continue;
+
+			batches[j].n_lanes = 0;
+			batches[j].morphism = heu->morphism;
+			batches[j].idxt = idxt;
+			++*n_batches;
+		}
+
+		b = batches + j;
+		b->ts[b->n_lanes] = tsnz;
+		b->tables[b->n_lanes] = heu->hdata;
+		b->heus[b->n_lanes++] = i;
+		added |= 1ull << i;
+	}
+
+	for (j = 0; j < *n_batches; j++) {
+		b = batches + j;
+		for (i = b->n_lanes; i < VECTORWIDTH; i++) {
+			b->ts[i] = b->ts[0];
+			b->tables[i] = b->tables[0];
+			b->heus[i] = b->heus[0];
+		}
+	}
+
+	return (added);
+}
+
+/*
+ * Drop the batches of less than BATCH_MIN_LANES PDBs from batches and
+ * return a bitmap of the PDBs in the remaining batches.
+ */
+static unsigned long long
+prune_batches(struct index_batch *batches, unsigned char *n_batches)
+{
+	struct index_batch *b;
+	unsigned long long heus = 0;
+	size_t i, j;
+
+	for (i = 0; i < *n_batches;) {
+		b = batches + i;
+		if (b->n_lanes < BATCH_MIN_LANES) {
+			*b = batches[--*n_batches];
+			continue;
+		}
+
+		for (j = 0; j < b->n_lanes; j++)
+			heus |= 1ull << b->heus[j];
+
+		i++;
+	}
+
+	return (heus);
+}
+
+/*
+ * Fill in the batches of cat and the PDBs whose indices are updated
+ * incrementally.
+ */
+static void
+compile_batches(struct pdb_catalogue *cat)
+{
+	unsigned long long all;
+	size_t i, tile;
+
+	all = cat->n_heus == CATALOGUE_HEUS_LEN ? ~0ull : (1ull << cat->n_heus) - 1;
+	cat->n_batches = 0;
+	add_batches(cat->batches, &cat->n_batches, CATALOGUE_BATCHES_LEN, cat, all);
+	cat->batch_heus = prune_batches(cat->batches, &cat->n_batches);
+
+	for (tile = 0; tile < TILE_COUNT; tile++) {
+		cat->n_tile_batches[tile] = 0;
+		add_batches(cat->tile_batches[tile], cat->n_tile_batches + tile,
+		    TILE_BATCHES_LEN, cat, cat->tile_heus[tile]);
+		cat->tile_batch_heus[tile] = prune_batches(cat->tile_batches[tile],
+		    cat->n_tile_batches + tile);
+	}
+
+	/* only PDBs provide hdata */
+	cat->index_heus = 0;
+	for (i = 0; i < cat->n_heus; i++)
+		if (cat->heus[i].hdata != NULL)
+			cat->index_heus |= 1ull << i;
+
+	for (tile = 0; tile < TILE_COUNT; tile++)
+		cat->tile_index_heus[tile] = cat->tile_heus[tile] & cat->index_heus
+		    & ~cat->tile_batch_heus[tile];
+}
+
 /*
  * Add a PDB for the tile set represented by string tsbuf to the last
  * heuristic in cat.  If the PDB is not already present, load or
@@ -93,12 +255,104 @@ add_pdb(struct pdb_catalogue *cat, const char *tsbuf, const char *pdbdir,
 	}
 
 	cat->pdbs_ts[pdbidx] = ts;
+	add_tile_heus(cat, pdbidx);
 	if (heu_open(cat->heus + pdbidx, pdbdir, ts, heutype, heuflags) != 0)
 		return (-1);
 
 	return (pdbidx);
 }
 
+/*
+ * Add an endgame table of the radius given in radiusstr to cat.  If
+ * pdbdir is not NULL, load the table from pdbdir or, if it is not
+ * present, generate it and store it there.  Print status information
+ * to f if f is not NULL.  On error, return -1 and set errno.
+ */
+static int
+add_endgame(struct pdb_catalogue *cat, const char *radiusstr,
+    const char *pdbdir, FILE *f)
+{
+	struct perimeter *per;
+	FILE *egfile;
+	long radius;
+	int fd, error;
+	char pathbuf[PATH_MAX], *end;
+
+	radius = strtol(radiusstr, &end, 10);
+	if (*radiusstr == '\0' || *end != '\0' || radius < 0 || radius > PERIMETER_MAX_RADIUS) {
+		if (f != NULL)
+			fprintf(f, "Invalid endgame table radius: %s\n", radiusstr);
+
+		errno = EINVAL;
+		return (-1);
+	}
+
+	if (cat->endgame != NULL) {
+		perimeter_free(cat->endgame);
+		cat->endgame = NULL;
+	}
+
+	if (pdbdir != NULL) {
+		if (snprintf(pathbuf, PATH_MAX, "%s/endgame-%ld.egt", pdbdir, radius) >= PATH_MAX) {
+			errno = ENAMETOOLONG;
+			return (-1);
+		}
+
+		fd = open(pathbuf, O_RDONLY);
+		if (fd != -1) {
+			if (f != NULL)
+				fprintf(f, "Loading endgame table %s\n", pathbuf);
+
+			cat->endgame = perimeter_mmap(fd);
+			error = errno;
+			close(fd);
+			errno = error;
+
+			return (cat->endgame != NULL ? 0 : -1);
+		}
+
+		/* don't annoy the user with useless ENOENT messages */
+		if (errno != ENOENT && f != NULL)
+			fprintf(f, "%s: %s\n", pathbuf, strerror(errno));
+	}
+
+	if (f != NULL)
+		fprintf(f, "Creating endgame table of radius %ld\n", radius);
+
+	per = perimeter_generate(radius, f);
+	if (per == NULL)
+		return (-1);
+
+	cat->endgame = per;
+	if (pdbdir == NULL)
+		return (0);
+
+	/* failing to write the table back is not fatal */
+	egfile = fopen(pathbuf, "wb");
+	if (egfile == NULL) {
+		if (f != NULL)
+			fprintf(f, "%s: %s\n", pathbuf, strerror(errno));
+
+		return (0);
+	}
+
+	if (f != NULL)
+		fprintf(f, "Writing endgame table to file %s\n", pathbuf);
+
+	if (perimeter_store(egfile, per) != 0) {
+		if (f != NULL)
+			fprintf(f, "%s: %s\n", pathbuf, strerror(errno));
+
+		fclose(egfile);
+		remove(pathbuf);
+		return (0);
+	}
+
+	fclose(egfile);
+
+	return (0);
+}
+
 /*
  * Load a catalogue from catfile, if pdbdir is not NULL, search for PDBs
  * in pdbdir. Generate missing PDBs and store them in pdbdir if pdbdir
@@ -109,8 +363,10 @@ add_pdb(struct pdb_catalogue *cat, const char *tsbuf, const char *pdbdir,
  * so the order of components should be the same every time.  If the
  * same PDB is used in multiple heuristics, it is loaded only once
  * still.  For better performance, the PDB is loaded as a memory mapped
- * file.  On error, NULL is returned and errno set to indicate the
- * problem.
+ * file.  A line of the form "endgame r" adds an endgame table holding
+ * the exact distances of all configurations at most r moves from the
+ * solved configuration.  It is kept in pdbdir like the PDBs.  On error,
+ * NULL is returned and errno set to indicate the problem.
  */
 extern struct pdb_catalogue *
 catalogue_load(const char *catfile, const char *pdbdir, int flags, FILE *f)
@@ -155,6 +411,15 @@ catalogue_load(const char *catfile, const char *pdbdir, int flags, FILE *f)
 		if (linebuf[0] == '#')
 			continue;
 
+		if (strncmp(linebuf, "endgame ", strlen("endgame ")) == 0) {
+			if (add_endgame(cat, linebuf + strlen("endgame "), pdbdir, f) != 0) {
+				error = errno;
+				goto fail;
+			}
+
+			continue;
+		}
+
 		/* empty lines demark groups of PDBs forming a heuristic */
 		if (linebuf[0] == '\0') {
 			if (!tileset_empty(ctiles)) {
@@ -190,7 +455,7 @@ catalogue_load(const char *catfile, const char *pdbdir, int flags, FILE *f)
 
 		ctiles = tileset_union(ctiles, cat->pdbs_ts[pdbidx]);
 
-		cat->parts[cat->n_heuristics] |= 1 << pdbidx;
+		cat->parts[cat->n_heuristics] |= 1ull << pdbidx;
 	}
 
 	if (ferror(catcfg)) {
@@ -210,6 +475,9 @@ catalogue_load(const char *catfile, const char *pdbdir, int flags, FILE *f)
 		cat->n_heuristics++;
 	}
 
+	compile_plan(cat);
+	compile_batches(cat);
+
 	if (f != NULL)
 		fprintf(f, "Loaded %zu PDBs and %zu heuristics from %s\n",
 		    cat->n_heus, cat->n_heuristics, catfile);
@@ -223,6 +491,9 @@ fail:
 	for (i = 0; i < cat->n_heus; i++)
 		heu_free(cat->heus + i);
 
+	if (cat->endgame != NULL)
+		perimeter_free(cat->endgame);
+
 earlyfail:
 	free(cat);
 
@@ -230,6 +501,176 @@ earlyfail:
 	return (NULL);
 }
 
+/*
+ * Return the index of the first PDB in cat using the same delta table
+ * as PDB i.  Only that PDB owns the table.
+ */
+static size_t
+delta_owner(const struct pdb_catalogue *cat, size_t i)
+{
+	size_t j;
+
+	for (j = 0; cat->deltas[j] != cat->deltas[i]; j++)
+		;
+
+	return (j);
+}
+
+/*
+ * Release the tables owned by replica, a replica of a catalogue made
+ * by catalogue_replicate().  The endgame table is shared with the
+ * original catalogue and left alone.
+ */
+static void
+replica_free(struct pdb_catalogue *replica)
+{
+	size_t i;
+
+	if (replica == NULL)
+		return;
+
+	for (i = 0; i < replica->n_heus; i++)
+		heu_free(replica->heus + i);
+
+	for (i = replica->n_heus; i-- > 0; )
+		if (delta_owner(replica, i) == i)
+			free(replica->deltas[i]);
+
+	free(replica);
+}
+
+/*
+ * Make a copy of cat whose PDBs and delta tables reside on NUMA node
+ * node.  PDBs that cannot be copied are shared with cat.  Print status
+ * information to f if f is not NULL.  Return the copy on success.  On
+ * failure, return NULL and set errno.
+ */
+static struct pdb_catalogue *
+replica_make(struct pdb_catalogue *cat, int node, FILE *f)
+{
+	struct pdb_catalogue *replica;
+	struct patterndb *pdb;
+	size_t i, j, size;
+	int error;
+	char tsstr[TILESET_LIST_LEN];
+
+	replica = malloc(sizeof *replica);
+	if (replica == NULL)
+		return (NULL);
+
+	*replica = *cat;
+	replica->replicas = NULL;
+
+	for (i = 0; i < cat->n_heus; i++) {
+		replica->deltas[i] = NULL;
+		if (cat->heus[i].derived)
+			continue;
+
+		if (heu_replicate(replica->heus + i, cat->heus + i, node) != 0) {
+			if (f != NULL) {
+				tileset_list_string(tsstr, cat->heus[i].ts);
+				fprintf(f, "Cannot replicate PDB %s to node %d, sharing it: %s\n",
+				    tsstr, node, strerror(errno));
+			}
+
+			/* share the original, it must not be released with the replica */
+			replica->heus[i].derived = 1;
+		}
+	}
+
+	/* derived heuristics use the replica of the heuristic they were derived from */
+	for (i = 0; i < cat->n_heus; i++) {
+		if (!cat->heus[i].derived)
+			continue;
+
+		for (j = 0; j < cat->n_heus; j++)
+			if (!cat->heus[j].derived && cat->heus[j].provider == cat->heus[i].provider)
+				break;
+
+		if (j == cat->n_heus)
+			continue;
+
+		replica->heus[i].provider = replica->heus[j].provider;
+		replica->heus[i].hdata = replica->heus[j].hdata;
+	}
+
+	for (i = 0; i < cat->n_heus; i++) {
+		if (cat->deltas[i] == NULL)
+			continue;
+
+		j = delta_owner(cat, i);
+		if (j != i) {
+			replica->deltas[i] = replica->deltas[j];
+			continue;
+		}
+
+		pdb = cat->heus[i].provider;
+		size = search_space_size(&pdb->aux) * pdb->aux.n_tile;
+		replica->deltas[i] = malloc(size);
+		if (replica->deltas[i] == NULL)
+			goto fail;
+
+		if (numa_bind(replica->deltas[i], size, node) != 0 && f != NULL)
+			fprintf(f, "Cannot place delta table on node %d: %s\n", node, strerror(errno));
+
+		memcpy(replica->deltas[i], cat->deltas[i], size);
+	}
+
+	compile_batches(replica);
+
+	return (replica);
+
+fail:
+	error = errno;
+	replica_free(replica);
+	errno = error;
+
+	return (NULL);
+}
+
+/*
+ * If there is more than one NUMA node, make a replica of cat for each
+ * node and remember them in cat.  Threads on a node then find its
+ * replica with catalogue_local().  cat must not be modified afterwards.
+ * The endgame table is not replicated.  Print status information to f
+ * if f is not NULL.  Return 0 on success.  On failure, return -1, set
+ * errno, and leave cat unchanged.
+ */
+extern int
+catalogue_replicate(struct pdb_catalogue *cat, FILE *f)
+{
+	int node, n_nodes = numa_nodes(), error;
+
+	if (n_nodes <= 1 || cat->replicas != NULL)
+		return (0);
+
+	cat->replicas = calloc(n_nodes, sizeof *cat->replicas);
+	if (cat->replicas == NULL)
+		return (-1);
+
+	for (node = 0; node < n_nodes; node++) {
+		if (f != NULL)
+			fprintf(f, "Replicating PDB catalogue to NUMA node %d\n", node);
+
+		cat->replicas[node] = replica_make(cat, node, f);
+		if (cat->replicas[node] == NULL)
+			goto fail;
+	}
+
+	return (0);
+
+fail:
+	error = errno;
+	for (node = 0; node < n_nodes; node++)
+		replica_free(cat->replicas[node]);
+
+	free(cat->replicas);
+	cat->replicas = NULL;
+	errno = error;
+
+	return (-1);
+}
+
 /*
  * Release store associated with PDB catalogue cat.  Also release
  * storage associated with all PDBs we opened.  *cat is undefined
@@ -239,13 +680,146 @@ extern void
 catalogue_free(struct pdb_catalogue *cat)
 {
 	size_t i;
+	int node;
+
+	if (cat->replicas != NULL) {
+		for (node = 0; node < numa_nodes(); node++)
+			replica_free(cat->replicas[node]);
+
+		free(cat->replicas);
+	}
 
 	for (i = 0; i < cat->n_heus; i++)
 		heu_free(cat->heus + i);
 
+	for (i = cat->n_heus; i-- > 0; )
+		if (delta_owner(cat, i) == i)
+			free(cat->deltas[i]);
+
+	if (cat->endgame != NULL)
+		perimeter_free(cat->endgame);
+
 	free(cat);
 }
 
+/*
+ * Print to f how much of each PDB in cat is backed by huge pages.
+ * Derived heuristics share their tables with the heuristic they were
+ * derived from and are skipped.
+ */
+extern void
+catalogue_huge_report(struct pdb_catalogue *cat, FILE *f)
+{
+	size_t i, size;
+	const void *table;
+	char tsstr[TILESET_LIST_LEN];
+
+	for (i = 0; i < cat->n_heus; i++) {
+		if (cat->heus[i].derived)
+			continue;
+
+		table = heu_table(cat->heus + i, &size);
+		if (table == NULL)
+			continue;
+
+		tileset_list_string(tsstr, cat->heus[i].ts);
+		huge_report(f, tsstr, table, size);
+	}
+}
+
+/*
+ * Bring the tables of all PDBs in cat into memory with table_warmup()
+ * so the search does not wait for them to be read from disk.  flags
+ * is passed on to table_warmup().  If f is not NULL, print for each
+ * PDB how long this took and how much of it is resident to f.  Return
+ * 0 on success.  If some PDB could not be locked into memory, return
+ * -1 and set errno.  All PDBs are warmed up regardless.
+ */
+extern int
+catalogue_warmup(struct pdb_catalogue *cat, int flags, FILE *f)
+{
+	struct timespec begin, end, start;
+	size_t i, size, resident, total = 0;
+	const void *table;
+	int error = 0;
+	char tsstr[TILESET_LIST_LEN];
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	end = start;
+
+	for (i = 0; i < cat->n_heus; i++) {
+		if (cat->heus[i].derived)
+			continue;
+
+		table = heu_table(cat->heus + i, &size);
+		if (table == NULL)
+			continue;
+
+		tileset_list_string(tsstr, cat->heus[i].ts);
+
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		if (table_warmup(table, size, flags) != 0) {
+			error = errno;
+			if (f != NULL)
+				fprintf(f, "%s: cannot lock into memory: %s\n", tsstr, strerror(error));
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		total += size;
+
+		if (f == NULL)
+			continue;
+
+		resident = table_resident(table, size);
+		if (resident == (size_t)-1)
+			fprintf(f, "%s: warmed up in %.3f s, residency unknown\n", tsstr,
+			    (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9);
+		else
+			fprintf(f, "%s: warmed up in %.3f s, %.1f of %.1f MiB resident\n", tsstr,
+			    (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9,
+			    resident / 1048576.0, size / 1048576.0);
+	}
+
+	if (f != NULL)
+		fprintf(f, "Warmed up %.1f MiB of PDBs in %.3f s%s\n", total / 1048576.0,
+		    (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9,
+		    flags & WARMUP_LOCK && error == 0 ? ", locked into memory" : "");
+
+	if (error != 0) {
+		errno = error;
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * Compute the indices of p in the PDBs of batch b.  Instead of map
+ * ranks, store the map offsets as used by index_offset() in mapoffset.
+ */
+static inline void
+batch_index(permindex pidx[VECTORWIDTH], tsrank mapoffset[VECTORWIDTH],
+    const struct index_batch *b, const struct puzzle *p)
+{
+	struct puzzle morphed;
+
+	if (b->morphism != 0) {
+		morphed = *p;
+		morph(&morphed, b->morphism);
+		p = &morphed;
+	}
+
+	if (b->n_lanes <= VECTORWIDTH / 2) {
+		compute_index_8a6(pidx, mapoffset, p, b->ts);
+		if (b->idxt != NULL)
+			eqclass_offsets_8a6(mapoffset, b->idxt, zero_location(p));
+	} else {
+		compute_index_16a6(pidx, mapoffset, p, b->ts);
+		if (b->idxt != NULL)
+			eqclass_offsets_16a6(mapoffset, b->idxt, zero_location(p));
+	}
+}
+
 /*
  * Amend a PDB catalogue to also include transposed PDBs.
  */
@@ -258,10 +832,30 @@ extern void
 catalogue_partial_hvals(struct partial_hvals *ph,
     struct pdb_catalogue *cat, const struct puzzle *p)
 {
-	size_t i;
+	struct index_batch *b;
+	permindex pidx[VECTORWIDTH];
+	tsrank mapoffset[VECTORWIDTH];
+	size_t i, j;
+	int h[VECTORWIDTH];
+
+	for (i = 0; i < cat->n_batches; i++) {
+		b = cat->batches + i;
+		batch_index(pidx, mapoffset, b, p);
+		if (b->n_lanes <= VECTORWIDTH / 2)
+			pdb_lookup_8a6(h, pidx, mapoffset, b->tables);
+		else
+			pdb_lookup_16a6(h, pidx, mapoffset, b->tables);
+
+		for (j = 0; j < b->n_lanes; j++)
+			ph->hvals[b->heus[j]] = h[j];
+	}
 
 	for (i = 0; i < cat->n_heus; i++)
-		ph->hvals[i] = heu_hval(cat->heus + i, p);
+		if (~cat->batch_heus & 1ull << i)
+			ph->hvals[i] = heu_hval(cat->heus + i, p);
+
+	ph->stale = 0;
+	ph->indexed = 0;
 }
 
 /*
@@ -272,12 +866,232 @@ catalogue_partial_hvals(struct partial_hvals *ph,
 extern void
 catalogue_diff_hvals(struct partial_hvals *ph, struct pdb_catalogue *cat,
     const struct puzzle *p, unsigned tile)
+{
+	struct hval_locations hl;
+
+	catalogue_diff_locate(&hl, cat, ph, p, tile);
+	catalogue_diff_fetch(ph, cat, &hl, tile);
+}
+
+/*
+ * Compute and prefetch the locations of the PDB entries for p that
+ * change when moving tile.  ph holds the partial h values of the
+ * configuration p was reached from, the indices in it are updated for
+ * PDBs not covered by a batch where possible.  This is the first half
+ * of catalogue_diff_hvals().  By calling this function for multiple
+ * configurations before calling catalogue_diff_fetch() on any of
+ * them, the latency of the PDB lookups is overlapped.
+ */
+extern void
+catalogue_diff_locate(struct hval_locations *hl, struct pdb_catalogue *cat,
+    const struct partial_hvals *ph, const struct puzzle *p, unsigned tile)
+{
+	struct index_batch *b;
+	struct patterndb *pdb;
+	struct puzzle p_morphed;
+	const struct puzzle *pp;
+	unsigned long long heus;
+	permindex pidx[VECTORWIDTH];
+	tsrank mapoffset[VECTORWIDTH];
+	size_t i, j, loc;
+	unsigned mtile;
+
+	for (i = 0; i < cat->n_tile_batches[tile]; i++) {
+		b = cat->tile_batches[tile] + i;
+		batch_index(pidx, mapoffset, b, p);
+		for (j = 0; j < b->n_lanes; j++) {
+			loc = (size_t)mapoffset[j] * A6_PERMUTATIONS + pidx[j];
+			hl->locs[b->heus[j]] = loc;
+			prefetch(b->tables[j] + loc);
+		}
+	}
+
+	for (heus = cat->tile_index_heus[tile]; heus != 0; heus &= heus - 1) {
+		i = ctzll(heus);
+		pdb = cat->heus[i].provider;
+		pp = p;
+		mtile = tile;
+		if (cat->heus[i].morphism != 0) {
+			p_morphed = *p;
+			morph(&p_morphed, cat->heus[i].morphism);
+			pp = &p_morphed;
+			mtile = automorphisms[cat->heus[i].morphism][0][tile];
+		}
+
+		if (ph->indexed & 1ull << i) {
+			hl->idx[i] = ph->idx[i];
+			compute_index_diff(&pdb->aux, hl->idx + i, pp, mtile);
+		} else
+			compute_index(&pdb->aux, hl->idx + i, pp);
+
+		hl->locs[i] = index_offset(&pdb->aux, hl->idx + i);
+		prefetch(cat->heus[i].hdata + hl->locs[i]);
+	}
+
+	heus = cat->tile_heus[tile] & ~cat->tile_batch_heus[tile] & ~cat->index_heus;
+	for (; heus != 0; heus &= heus - 1) {
+		i = ctzll(heus);
+		hl->locs[i] = heu_locate(cat->heus + i, p);
+	}
+}
+
+/*
+ * Update ph, a struct partial_hvals for a configuration neighboring
+ * the configuration hl was computed for by moving tile, to contain the
+ * partial h values for that configuration.  This is the second half of
+ * catalogue_diff_hvals().
+ */
+extern void
+catalogue_diff_fetch(struct partial_hvals *ph, struct pdb_catalogue *cat,
+    const struct hval_locations *hl, unsigned tile)
+{
+	unsigned long long heus;
+	size_t i;
+
+	for (heus = cat->tile_heus[tile]; heus != 0; heus &= heus - 1) {
+		i = ctzll(heus);
+		ph->hvals[i] = heu_fetch(cat->heus + i, hl->locs[i], ph->hvals[i]);
+	}
+
+	catalogue_ph_take_indices(ph, cat, hl, tile);
+}
+
+/*
+ * Look up the stale entries of ph, the partial h values for p, making
+ * ph whole again.
+ */
+extern void
+catalogue_ph_refresh(struct partial_hvals *ph, struct pdb_catalogue *cat,
+    const struct puzzle *p)
+{
+	unsigned long long heus;
+	size_t i;
+
+	for (heus = ph->stale; heus != 0; heus &= heus - 1) {
+		i = ctzll(heus);
+		ph->hvals[i] = heu_hval(cat->heus + i, p);
+	}
+
+	ph->stale = 0;
+}
+
+/*
+ * Compute delta tables for all PDBs in cat so children can be
+ * evaluated with catalogue_delta_hvals() as needed for EPEIDA*.  PDBs
+ * derived from the same pattern database by a morphism, such as those
+ * added by catalogue_add_transpositions(), share its delta table.
+ * Print status information to f if f is not NULL.  Return 0 on
+ * success, -1 on error with errno set.  On error, no delta tables
+ * remain in cat.  If some PDB is not suitable for delta tables (i.e.
+ * it is not backed by a plain pattern database), set errno to EINVAL.
+ */
+extern int
+catalogue_add_deltas(struct pdb_catalogue *cat, FILE *f)
+{
+	struct patterndb *pdb;
+	size_t i, j;
+	int error;
+	char tsstr[TILESET_LIST_LEN];
+
+	for (i = 0; i < cat->n_heus; i++) {
+		if (cat->deltas[i] != NULL)
+			continue;
+
+		tileset_list_string(tsstr, cat->pdbs_ts[i]);
+		pdb = heu_pdb(cat->heus + i);
+		if (pdb == NULL) {
+			if (f != NULL)
+				fprintf(f, "Cannot compute delta table for PDB %s\n", tsstr);
+
+			error = EINVAL;
+			goto fail;
+		}
+
+		cat->delta_ts[i] = tileset_remove(pdb->aux.ts, ZERO_TILE);
+
+		for (j = 0; j < i; j++)
+			if (cat->heus[j].provider == pdb)
+				break;
+
+		if (j < i) {
+			cat->deltas[i] = cat->deltas[j];
+			continue;
+		}
+
+		if (f != NULL)
+			fprintf(f, "Computing delta table for PDB %s\n", tsstr);
+
+		cat->deltas[i] = pdb_deltas(pdb);
+		if (cat->deltas[i] == NULL) {
+			error = errno;
+			goto fail;
+		}
+	}
+
+	return (0);
+
+fail:
+	for (i = cat->n_heus; i-- > 0; )
+		if (delta_owner(cat, i) == i)
+			free(cat->deltas[i]);
+
+	for (i = 0; i < cat->n_heus; i++)
+		cat->deltas[i] = NULL;
+
+	errno = error;
+	return (-1);
+}
+
+/*
+ * Compute the location of the delta table entry for configuration p
+ * in PDB i of cat, store it in hl and prefetch the entry.
+ */
+static void
+delta_locate(struct hval_locations *hl, struct pdb_catalogue *cat,
+    const struct puzzle *p, size_t i)
+{
+	struct patterndb *pdb = cat->heus[i].provider;
+	struct index idx;
+	struct puzzle p_morphed;
+
+	if (cat->heus[i].morphism != 0) {
+		p_morphed = *p;
+		morph(&p_morphed, cat->heus[i].morphism);
+		p = &p_morphed;
+	}
+
+	compute_index(&pdb->aux, &idx, p);
+	hl->locs[i] = index_offset(&pdb->aux, &idx);
+	prefetch(cat->deltas[i] + hl->locs[i] * pdb->aux.n_tile);
+}
+
+/*
+ * Compute the locations of the entries for p in all PDBs of cat and
+ * prefetch the corresponding delta table entries.
+ */
+extern void
+catalogue_delta_locations(struct hval_locations *hl,
+    struct pdb_catalogue *cat, const struct puzzle *p)
 {
 	size_t i;
 
 	for (i = 0; i < cat->n_heus; i++)
-		if (tileset_has(cat->pdbs_ts[i], tile))
-			ph->hvals[i] = heu_hval(cat->heus + i, p);
+		delta_locate(hl, cat, p, i);
+}
+
+/*
+ * Given the locations hl of the entries of a configuration neighboring
+ * p by moving tile, update those entries that change to the locations
+ * for p and prefetch the corresponding delta table entries.
+ */
+extern void
+catalogue_delta_locate(struct hval_locations *hl, struct pdb_catalogue *cat,
+    const struct puzzle *p, unsigned tile)
+{
+	unsigned long long heus;
+
+	for (heus = cat->tile_heus[tile]; heus != 0; heus &= heus - 1)
+		delta_locate(hl, cat, p, ctzll(heus));
 }
 
 /*
@@ -316,6 +1130,7 @@ catalogue_add_transpositions(struct pdb_catalogue *cat)
 		heu_morph(newcat.heus + newcat.n_heus, newcat.heus + i, 4);
 		assert(newcat.heus[newcat.n_heus].ts == ts);
 		newcat.pdbs_ts[newcat.n_heus] = newcat.heus[newcat.n_heus].ts;
+		add_tile_heus(&newcat, newcat.n_heus);
 		transposed[i] = newcat.n_heus++;
 
 	continue_outer1:
@@ -328,7 +1143,7 @@ catalogue_add_transpositions(struct pdb_catalogue *cat)
 		/* process bits one by one */
 		newset = 0;
 		for (set = newcat.parts[i]; set != 0; set &= set - 1)
-			newset |= transposed[ctzll(set)];
+			newset |= 1ull << transposed[ctzll(set)];
 
 		/* do we already have this one? */
 		for (j = 0; j < newcat.n_heuristics; j++)
@@ -347,6 +1162,8 @@ catalogue_add_transpositions(struct pdb_catalogue *cat)
 		;
 	}
 
+	compile_plan(&newcat);
+	compile_batches(&newcat);
 	*cat = newcat;
 
 	return (0);
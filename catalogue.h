@@ -29,6 +29,11 @@
 #define CATALOGUE_H
 
 #include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+# include <immintrin.h>
+#endif
 
 #include "builtins.h"
 #include "pdb.h"
@@ -45,59 +50,201 @@
  * of which PDBs make up which heuristic.  The member heuristics
  * contains a bitmap of which heuristics each PDB is used for.  The
  * member pdbs_ts contains for the PDB's tile sets for better cache
- * locality.
+ * locality.  The member tile_heus contains for each tile a bitmap of
+ * the PDBs whose tile set contains that tile.
+ *
+ * The member plan holds the same information as parts, but as a
+ * matrix of byte masks so the PDBs making up a heuristic can be summed
+ * up with SIMD instructions.
+ *
+ * If delta tables have been computed with catalogue_add_deltas(), the
+ * member deltas holds them for each PDB and delta_ts the tile set they
+ * are for (which differs from pdbs_ts for PDBs with a morphism
+ * applied).  PDBs sharing a pattern database share its delta table.
+ *
+ * The member endgame holds an endgame table with the exact distances
+ * of the configurations near the solved configuration or NULL if the
+ * catalogue has none.
+ *
+ * The PDBs suitable for the vectorised index functions are grouped
+ * into batches: batches covers all of them, tile_batches those
+ * containing each tile.  As the vectorised functions compute all
+ * lanes at once, a batch of less than BATCH_MIN_LANES PDBs is slower
+ * than looking up its PDBs one by one and is dropped.  The members
+ * batch_heus and tile_batch_heus hold bitmaps of the PDBs covered.
+ *
+ * The member index_heus holds a bitmap of the PDBs whose indices can
+ * be updated with compute_index_diff() and tile_index_heus those of
+ * them containing each tile that are not covered by tile_batches.
+ *
+ * If catalogue_replicate() has been called, the member replicas holds
+ * a copy of the catalogue for each NUMA node, otherwise it is NULL.
  */
 enum {
 	CATALOGUE_HEUS_LEN = 64,
 	HEURISTICS_LEN = 64,
+	CATALOGUE_BATCHES_LEN = 8,
+	TILE_BATCHES_LEN = 2,
+	BATCH_MIN_LANES = 4,
 
 	/* flags for catalogue_load() */
 	CAT_IDENTIFY = 1 << 0,
 };
 
+struct perimeter;
+
+/*
+ * A batch of PDBs whose entries are located with a single call to
+ * compute_index_16a6() or compute_index_8a6().  All PDBs in a batch
+ * have six nonzero tiles and use the same morphism.  If they account
+ * for the zero tile, idxt points to their index table, otherwise it is
+ * NULL.  The member ts holds the tile sets without the zero tile, heus
+ * holds the index of each lane's PDB in the catalogue.  Unused lanes
+ * repeat the first lane.
+ */
+struct index_batch {
+	tileset ts[VECTORWIDTH];
+	const atomic_uchar *tables[VECTORWIDTH];
+	const struct index_table *idxt;
+	unsigned char heus[VECTORWIDTH];
+	unsigned char n_lanes, morphism;
+};
+
 struct pdb_catalogue {
+	unsigned char plan[HEURISTICS_LEN][CATALOGUE_HEUS_LEN];
 	struct heuristic heus[CATALOGUE_HEUS_LEN];
 	tileset pdbs_ts[CATALOGUE_HEUS_LEN];
+	unsigned long long tile_heus[TILE_COUNT];
 	unsigned long long parts[HEURISTICS_LEN];
+	unsigned char *deltas[CATALOGUE_HEUS_LEN];
+	tileset delta_ts[CATALOGUE_HEUS_LEN];
+	struct perimeter *endgame;
 	size_t n_heus, n_heuristics;
+	struct index_batch batches[CATALOGUE_BATCHES_LEN];
+	struct index_batch tile_batches[TILE_COUNT][TILE_BATCHES_LEN];
+	unsigned long long batch_heus, tile_batch_heus[TILE_COUNT];
+	unsigned long long index_heus, tile_index_heus[TILE_COUNT];
+	unsigned char n_batches, n_tile_batches[TILE_COUNT];
+	struct pdb_catalogue **replicas;
 };
 
 /*
  * A struct partial_hvals stores the partial h values of a puzzle
  * configuration for the PDBs in a PDB catalogue.  This is useful so we
  * can avoid superfluous PDB lookups by not looking up values that did
- * not change change whenever we can.  The member fake_entries stores a
- * bitmap of those PDB whose entries we have not bothered to look up as
- * they do not contribute to the best heuristic for this puzzle
- * configuration.
+ * not change change whenever we can.  The member stale stores a
+ * bitmap of those PDBs whose entries we have not bothered to look up as
+ * another heuristic already proved the configuration to be beyond the
+ * bound.  Heuristics using stale entries are ignored by
+ * catalogue_ph_hval() until catalogue_ph_refresh() is called.  The
+ * member indexed is a bitmap of the PDBs for which idx holds the index
+ * of the configuration, allowing catalogue_diff_locate() to update the
+ * index instead of computing it anew.  Use catalogue_ph_copy() to copy
+ * a struct partial_hvals as idx is large but usually mostly unused.
  */
 struct partial_hvals {
 	unsigned char hvals[CATALOGUE_HEUS_LEN];
+	unsigned long long stale, indexed;
+	struct index idx[CATALOGUE_HEUS_LEN];
+};
+
+/*
+ * The locations of the PDB entries affected by moving a tile as
+ * computed by catalogue_diff_locate().  Only the entries for PDBs
+ * containing the tile moved are meaningful.  For EPEIDA*, the same
+ * structure holds the locations of a configuration's entries in all
+ * PDBs as computed by catalogue_delta_locations().  For the PDBs in
+ * cat->tile_index_heus[tile], idx holds the indices the locations were
+ * computed from.
+ */
+struct hval_locations {
+	size_t locs[CATALOGUE_HEUS_LEN];
+	struct index idx[CATALOGUE_HEUS_LEN];
 };
 
 extern struct pdb_catalogue	*catalogue_load(const char *, const char *, int, FILE *);
 extern void	catalogue_free(struct pdb_catalogue *);
+extern void	catalogue_huge_report(struct pdb_catalogue *, FILE *);
+extern int	catalogue_warmup(struct pdb_catalogue *, int, FILE *);
+extern int	catalogue_replicate(struct pdb_catalogue *, FILE *);
 extern int	catalogue_add_transpositions(struct pdb_catalogue *cat);
 extern void	catalogue_partial_hvals(struct partial_hvals *, struct pdb_catalogue *, const struct puzzle *);
 extern void	catalogue_diff_hvals(struct partial_hvals *, struct pdb_catalogue *, const struct puzzle *, unsigned);
+extern void	catalogue_diff_locate(struct hval_locations *, struct pdb_catalogue *, const struct partial_hvals *, const struct puzzle *, unsigned);
+extern void	catalogue_diff_fetch(struct partial_hvals *, struct pdb_catalogue *, const struct hval_locations *, unsigned);
+extern void	catalogue_ph_refresh(struct partial_hvals *, struct pdb_catalogue *, const struct puzzle *);
+extern int	catalogue_add_deltas(struct pdb_catalogue *, FILE *);
+extern void	catalogue_delta_locations(struct hval_locations *, struct pdb_catalogue *, const struct puzzle *);
+extern void	catalogue_delta_locate(struct hval_locations *, struct pdb_catalogue *, const struct puzzle *, unsigned);
+
+/*
+ * Return the h value of heuristic i for the partial h values ph.  The
+ * partial h values of PDBs not in heuristic i are masked out, using
+ * parts as an AVX-512 mask or the byte masks in plan otherwise, and the
+ * rest is summed up with psadbw.
+ */
+static inline unsigned
+catalogue_heu_hval(struct pdb_catalogue *cat, const struct partial_hvals *ph, size_t i)
+{
+#ifdef __AVX512BW__
+	__m512i hvals = _mm512_maskz_loadu_epi8(cat->parts[i], ph->hvals);
+
+	return (_mm512_reduce_add_epi64(_mm512_sad_epu8(hvals, _mm512_setzero_si512())));
+#elif defined(__AVX2__)
+	__m256i lo, hi, sum;
+	__m128i sum128;
+
+	lo = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)ph->hvals + 0),
+	    _mm256_loadu_si256((const __m256i *)cat->plan[i] + 0));
+	hi = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)ph->hvals + 1),
+	    _mm256_loadu_si256((const __m256i *)cat->plan[i] + 1));
+	sum = _mm256_add_epi64(_mm256_sad_epu8(lo, _mm256_setzero_si256()),
+	    _mm256_sad_epu8(hi, _mm256_setzero_si256()));
+	sum128 = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	sum128 = _mm_add_epi64(sum128, _mm_unpackhi_epi64(sum128, sum128));
+
+	return (_mm_cvtsi128_si32(sum128));
+#elif defined(__SSE2__)
+	__m128i sum = _mm_setzero_si128(), hvals;
+	size_t j;
+
+	for (j = 0; j < 4; j++) {
+		hvals = _mm_and_si128(_mm_loadu_si128((const __m128i *)ph->hvals + j),
+		    _mm_loadu_si128((const __m128i *)cat->plan[i] + j));
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(hvals, _mm_setzero_si128()));
+	}
+
+	sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+
+	return (_mm_cvtsi128_si32(sum));
+#else /* no SSE2, no AVX2, no AVX-512 */
+	unsigned long long parts;
+	unsigned sum = 0;
+
+	for (parts = cat->parts[i]; parts != 0; parts &= parts - 1)
+		sum += ph->hvals[ctzll(parts)];
+
+	return (sum);
+#endif /* __AVX512BW__ */
+}
 
 /*
  * Given a struct partial_hvals, return the h value indicated
  * by this structure.  This is the maximum of all heuristics it
- * contains.
+ * contains.  Heuristics with stale entries are skipped, so if ph has
+ * any, the result is only a lower bound.
  */
 static inline unsigned
 catalogue_ph_hval(struct pdb_catalogue *cat, const struct partial_hvals *ph)
 {
 	size_t i;
-	unsigned long long parts;
 	unsigned max = 0, sum;
 
 	for (i = 0; i < cat->n_heuristics; i++) {
-		sum = 0;
-		for (parts = cat->parts[i]; parts != 0; parts &= parts - 1)
-			sum += ph->hvals[ctzll(parts)];
+		if (cat->parts[i] & ph->stale)
+			continue;
 
+		sum = catalogue_heu_hval(cat, ph, i);
 		if (sum > max)
 			max = sum;
 	}
@@ -120,33 +267,165 @@ catalogue_hval(struct pdb_catalogue *cat, const struct puzzle *p)
 	return (catalogue_ph_hval(cat, &ph));
 }
 
+/*
+ * Return the replica of cat on NUMA node node made by
+ * catalogue_replicate() or cat itself if there are no replicas.
+ */
+static inline struct pdb_catalogue *
+catalogue_local(struct pdb_catalogue *cat, int node)
+{
+	return (cat->replicas != NULL ? cat->replicas[node] : cat);
+}
+
 /*
  * Given a struct partial_hvals, return a bitmap indicating the
  * heuristics whose h value is equal to the maximum h value for
  * ph.
  */
-static inline unsigned
+static inline unsigned long long
 catalogue_max_heuristics(struct pdb_catalogue *cat, const struct partial_hvals *ph)
 {
 	size_t i;
-	unsigned long long parts;
-	unsigned max = 0, sum, heumap = 0;
+	unsigned long long heumap = 0;
+	unsigned max = 0, sum;
 
 	for (i = 0; i < cat->n_heuristics; i++) {
-		sum = 0;
-		for (parts = cat->parts[i]; parts != 0; parts &= parts - 1)
-			sum += ph->hvals[ctzll(parts)];
-
+		sum = catalogue_heu_hval(cat, ph, i);
 		if (sum > max) {
 			max = sum;
 			heumap = 0;
 		}
 
 		if (sum == max)
-			heumap |= 1 << i;
+			heumap |= 1ull << i;
 	}
 
 	return (heumap);
 }
 
+/*
+ * Copy the struct partial_hvals src to dst, skipping the unused
+ * entries of src->idx.
+ */
+static inline void
+catalogue_ph_copy(struct partial_hvals *dst, const struct pdb_catalogue *cat,
+    const struct partial_hvals *src)
+{
+	memcpy(dst->hvals, src->hvals, sizeof dst->hvals);
+	dst->stale = src->stale;
+	dst->indexed = src->indexed;
+	memcpy(dst->idx, src->idx, cat->n_heus * sizeof *dst->idx);
+}
+
+/*
+ * Store the indices computed by catalogue_diff_locate() in hl in ph,
+ * the partial h values of the configuration hl was computed for.  The
+ * indices for the other PDBs containing tile are now out of date.
+ */
+static inline void
+catalogue_ph_take_indices(struct partial_hvals *ph, const struct pdb_catalogue *cat,
+    const struct hval_locations *hl, unsigned tile)
+{
+	unsigned long long heus;
+	size_t i;
+
+	for (heus = cat->tile_index_heus[tile]; heus != 0; heus &= heus - 1) {
+		i = ctzll(heus);
+		ph->idx[i] = hl->idx[i];
+	}
+
+	ph->indexed = (ph->indexed & ~cat->tile_heus[tile]) | cat->tile_index_heus[tile];
+}
+
+/*
+ * Update ph, the partial h values of a configuration whose PDB entries
+ * are found at hl, to contain the partial h values of the configuration
+ * reached by moving tile in direction dir.  Instead of looking up the
+ * new entries, compute them from the delta tables of cat, which must
+ * have been computed with catalogue_add_deltas().
+ */
+static inline void
+catalogue_delta_hvals(struct partial_hvals *ph, struct pdb_catalogue *cat,
+    const struct hval_locations *hl, unsigned tile, unsigned dir)
+{
+	unsigned long long heus;
+	size_t i;
+	unsigned mtile, mdir;
+
+	for (heus = cat->tile_heus[tile]; heus != 0; heus &= heus - 1) {
+		i = ctzll(heus);
+		mtile = tile;
+		mdir = dir;
+		if (cat->heus[i].morphism != 0) {
+			mtile = automorphisms[cat->heus[i].morphism][0][tile];
+			mdir = morphed_directions[cat->heus[i].morphism][dir];
+		}
+
+		ph->hvals[i] += pdb_delta(cat->deltas[i], cat->delta_ts[i],
+		    hl->locs[i], mtile, mdir);
+	}
+
+	ph->indexed &= ~cat->tile_heus[tile];
+}
+
+/*
+ * Like catalogue_diff_fetch(), but stop once some heuristic exceeds
+ * budget, the distance left until the search bound is exceeded.  The
+ * heuristics are evaluated cheapest first: those not containing tile
+ * need no lookups at all, the others only need the entries not already
+ * fetched for a previous heuristic.  The entries not fetched are marked
+ * stale in ph.  Return the h value for ph, or if the budget was
+ * exceeded, the value of the heuristic that exceeded it.  ph must not
+ * have stale entries when this function is called.
+ */
+static inline unsigned
+catalogue_bounded_fetch(struct partial_hvals *ph, struct pdb_catalogue *cat,
+    const struct hval_locations *hl, unsigned tile, size_t budget)
+{
+	unsigned long long heus, stale = cat->tile_heus[tile];
+	size_t i, j;
+	unsigned max = 0, sum;
+
+	catalogue_ph_take_indices(ph, cat, hl, tile);
+
+	/* heuristics whose value did not change */
+	for (i = 0; i < cat->n_heuristics; i++) {
+		if (cat->parts[i] & stale)
+			continue;
+
+		sum = catalogue_heu_hval(cat, ph, i);
+		if (sum > budget) {
+			ph->stale = stale;
+			return (sum);
+		}
+
+		if (sum > max)
+			max = sum;
+	}
+
+	for (i = 0; i < cat->n_heuristics; i++) {
+		if ((cat->parts[i] & cat->tile_heus[tile]) == 0)
+			continue;
+
+		for (heus = cat->parts[i] & stale; heus != 0; heus &= heus - 1) {
+			j = ctzll(heus);
+			ph->hvals[j] = heu_fetch(cat->heus + j, hl->locs[j], ph->hvals[j]);
+		}
+
+		stale &= ~cat->parts[i];
+
+		sum = catalogue_heu_hval(cat, ph, i);
+		if (sum > budget) {
+			ph->stale = stale;
+			return (sum);
+		}
+
+		if (sum > max)
+			max = sum;
+	}
+
+	ph->stale = stale;
+	return (max);
+}
+
 #endif /* CATALOGUE_H */
@@ -191,12 +191,15 @@ struct half_eta_config {
  * the worker function for make_half_etas().
  */
 static void
-half_eta_worker(void *cfgarg, struct index *idx)
+half_eta_worker(void *cfgarg, struct index *idx, permindex end)
 {
 	struct half_eta_config *cfg = cfgarg;
 	size_t offset, n_eqclass;
 	tileset map;
 
+	/* the cohorts are always handed out whole */
+	(void)end;
+
 	n_eqclass = eqclass_count(&cfg->pcfg.pdb->aux, idx->maprank);
 	map = tileset_unrank(12, idx->maprank);
 
@@ -222,6 +225,7 @@ make_half_etas(const float *restrict etas_a, const float *restrict etas_b,
 	/* it doesn't really matter which tile set we use as long as it has 6 tiles */
 	make_index_aux(&cfg.aux6, tileset_least(6 + 1));
 	cfg.pcfg.pdb = pdbdummy;
+	cfg.pcfg.split = 0;
 	cfg.pcfg.worker = half_eta_worker;
 	cfg.etas_a = etas_a;
 	cfg.etas_b = etas_b;
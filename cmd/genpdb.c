@@ -34,11 +34,12 @@
 #include "tileset.h"
 #include "index.h"
 #include "pdb.h"
+#include "parallel.h"
 
 static void
 usage(const char *argv0)
 {
-	fprintf(stderr, "Usage: %s [-q] [-f file] [-t tile,tile,...] [-j nproc]\n", argv0);
+	fprintf(stderr, "Usage: %s [-q] [-f file] [-t tile,tile,...] [-j nproc] [-s scatter_mb]\n", argv0);
 
 	exit(EXIT_FAILURE);
 }
@@ -52,7 +53,7 @@ main(int argc, char *argv[])
 	const char *fname = NULL;
 	FILE *f = NULL;
 
-	while (optchar = getopt(argc, argv, "f:j:t:q"), optchar != -1)
+	while (optchar = getopt(argc, argv, "f:j:s:t:q"), optchar != -1)
 		switch (optchar) {
 		case 'f':
 			fname = optarg;
@@ -68,6 +69,10 @@ main(int argc, char *argv[])
 
 			break;
 
+		case 's':
+			pdb_scatter = strtoull(optarg, NULL, 0) << 20;
+			break;
+
 		case 't':
 			if (tileset_parse(&ts, optarg) != 0) {
 				fprintf(stderr, "Cannot parse tile set: %s\n", optarg);
@@ -106,6 +111,8 @@ main(int argc, char *argv[])
 	}
 
 	pdb_generate(pdb, verbose ? stderr : NULL);
+	if (verbose)
+		parallel_report(stderr);
 
 	if (f != NULL && pdb_store(f, pdb) != 0) {
 		perror("pdb_store");
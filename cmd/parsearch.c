@@ -33,35 +33,82 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "search.h"
 #include "catalogue.h"
 #include "fsm.h"
+#include "hugepage.h"
 #include "pdb.h"
+#include "perimeter.h"
 #include "index.h"
+#include "isa.h"
+#include "numa.h"
 #include "puzzle.h"
 #include "tileset.h"
+#include "ttable.h"
+#include "warmup.h"
 
-enum { CHUNK_SIZE = 1024 };
+enum {
+	CHUNK_SIZE = 1024,
+	/* check if checkpoints are due every CHECKPOINT_STEPS steps */
+	CHECKPOINT_STEPS = 1 << 16,
+};
 
+/*
+ * If ckdir is not NULL, the searches in progress are saved to files in
+ * ckdir named after the line numbers of their puzzles every
+ * ida_checkpoint_interval seconds.  Once a search is done, its
+ * checkpoint is replaced with an empty file with suffix .done.  With
+ * resume set, puzzles that are done are skipped and the others are
+ * continued from their checkpoints.
+ */
 struct psearch_config {
 	pthread_mutex_t lock;
 	FILE *puzzles;
 	struct pdb_catalogue *cat;
 	const struct fsm *fsm;
-	int idaflags;
+	const char *ckdir;
+	size_t lineno;
+	int idaflags, resume;
+	atomic_int next_worker;
 };
 
-static void *
-lookup_worker(void *cfgarg)
-{
-	struct psearch_config *cfg = cfgarg;
+/*
+ * A search in progress by lookup_worker() along with the line of input
+ * its puzzle came from and that line's number.
+ */
+struct psearch_slot {
+	struct ida_search *search;
 	struct puzzle p;
 	struct path path;
-	unsigned long long expansions;
+	size_t lineno;
+	char linebuf[BUFSIZ];
+};
+
+/*
+ * Write the name of the checkpoint file for the puzzle on line lineno
+ * with suffix appended to name.
+ */
+static void
+checkpoint_name(char name[FILENAME_MAX], const struct psearch_config *cfg,
+    size_t lineno, const char *suffix)
+{
+	snprintf(name, FILENAME_MAX, "%s/%zu%s", cfg->ckdir, lineno, suffix);
+}
+
+/*
+ * Read the next valid puzzle from cfg->puzzles and start a search for
+ * it in slot using cat.  Return 1 if a search was started, 0 on end of
+ * input.
+ */
+static int
+start_search(struct psearch_config *cfg, struct pdb_catalogue *cat,
+    struct psearch_slot *slot)
+{
 	int error;
-	char linebuf[BUFSIZ], *line;
+	char *line, name[FILENAME_MAX];
 
 	for (;;) {
 		error = pthread_mutex_lock(&cfg->lock);
@@ -71,7 +118,8 @@ lookup_worker(void *cfgarg)
 			abort();
 		}
 
-		line = fgets(linebuf, BUFSIZ, cfg->puzzles);
+		line = fgets(slot->linebuf, BUFSIZ, cfg->puzzles);
+		slot->lineno = ++cfg->lineno;
 		error = pthread_mutex_unlock(&cfg->lock);
 		if (error != 0) {
 			errno = error;
@@ -79,24 +127,164 @@ lookup_worker(void *cfgarg)
 			abort();
 		}
 
-		if (line == NULL)
-			return (NULL);
+		if (line == NULL) {
+			slot->search = NULL;
+			return (0);
+		}
 
-		if (puzzle_parse(&p, linebuf) != 0) {
-			fprintf(stderr, "Invalid puzzle, ignoring: %s", linebuf);
+		if (puzzle_parse(&slot->p, slot->linebuf) != 0) {
+			fprintf(stderr, "Invalid puzzle, ignoring: %s", slot->linebuf);
 			continue;
 		}
 
-		expansions = search_ida(cfg->cat, cfg->fsm, &p, &path, NULL, NULL, cfg->idaflags);
-		linebuf[strcspn(linebuf, "\n")] = '\0';
-		flockfile(stdout);
-		printf("%s %3zu %12llu ", linebuf, path.pathlen, expansions);
-		path_string(linebuf, &path);
-		printf("%s\n", linebuf);
-		funlockfile(stdout);
+		if (cfg->ckdir != NULL && cfg->resume) {
+			checkpoint_name(name, cfg, slot->lineno, ".done");
+			if (access(name, F_OK) == 0)
+				continue;
+		}
+
+		slot->search = search_ida_start(cat, cfg->fsm, &slot->p,
+		    SEARCH_PATH_LEN, &slot->path, NULL, NULL, cfg->idaflags);
+		if (slot->search == NULL) {
+			perror("search_ida_start");
+			abort();
+		}
+
+		if (cfg->ckdir != NULL && cfg->resume) {
+			checkpoint_name(name, cfg, slot->lineno, "");
+			if (search_ida_load(slot->search, name) != 0 && errno != ENOENT) {
+				perror(name);
+				fprintf(stderr, "Proceeding anyway...\n");
+			}
+		}
+
+		return (1);
 	}
 }
 
+/*
+ * Finish the search in slot and print its results.  Then mark the
+ * search as done in cfg->ckdir.
+ */
+static void
+finish_search(struct psearch_config *cfg, struct psearch_slot *slot)
+{
+	FILE *done;
+	unsigned long long expansions;
+	char pathbuf[PATH_STR_LEN], name[FILENAME_MAX];
+
+	expansions = search_ida_finish(slot->search);
+	slot->search = NULL;
+	slot->linebuf[strcspn(slot->linebuf, "\n")] = '\0';
+	path_string(pathbuf, &slot->path);
+	flockfile(stdout);
+	printf("%s %3zu %12llu %s\n", slot->linebuf, slot->path.pathlen, expansions, pathbuf);
+	funlockfile(stdout);
+
+	if (cfg->ckdir == NULL)
+		return;
+
+	checkpoint_name(name, cfg, slot->lineno, ".done");
+	done = fopen(name, "w");
+	if (done == NULL || fclose(done) != 0)
+		perror(name);
+
+	checkpoint_name(name, cfg, slot->lineno, "");
+	if (remove(name) != 0 && errno != ENOENT)
+		perror(name);
+}
+
+/*
+ * Save the n searches in slots to cfg->ckdir.
+ */
+static void
+save_searches(struct psearch_config *cfg, struct psearch_slot *slots, size_t n)
+{
+	size_t i;
+	char name[FILENAME_MAX];
+
+	for (i = 0; i < n; i++) {
+		if (slots[i].search == NULL)
+			continue;
+
+		checkpoint_name(name, cfg, slots[i].lineno, "");
+
+		/* searches that have found a solution can't be saved */
+		if (search_ida_save(slots[i].search, name) != 0 && errno != EINVAL)
+			perror(name);
+	}
+}
+
+/*
+ * Search puzzles from cfg->puzzles until none are left.  Keep up to
+ * ida_interleave searches going at once, advancing them in turn so
+ * the PDB lookups of each are overlapped with the work on the others.
+ * If checkpointing is enabled, save the searches periodically.  If
+ * numa_aware is set, pin the thread to its node and use the node's
+ * replica of the PDB catalogue.
+ */
+static void *
+lookup_worker(void *cfgarg)
+{
+	struct psearch_config *cfg = cfgarg;
+	struct psearch_slot *slots;
+	struct pdb_catalogue *cat = cfg->cat;
+	struct timespec last, now;
+	unsigned long steps = 0;
+	size_t i, n = ida_interleave, n_active = 0;
+	int node;
+
+	if (numa_aware) {
+		node = numa_worker_node(atomic_fetch_add(&cfg->next_worker, 1));
+		if (numa_pin(node) != 0)
+			perror("numa_pin");
+
+		cat = catalogue_local(cat, node);
+	}
+
+	slots = malloc(n * sizeof *slots);
+	if (slots == NULL) {
+		perror("malloc");
+		abort();
+	}
+
+	for (i = 0; i < n; i++)
+		n_active += start_search(cfg, cat, slots + i);
+
+	if (cfg->ckdir != NULL && clock_gettime(CLOCK_MONOTONIC, &last) != 0) {
+		perror("clock_gettime");
+		abort();
+	}
+
+	while (n_active > 0) {
+		for (i = 0; i < n; i++) {
+			if (slots[i].search == NULL || search_ida_step(slots[i].search))
+				continue;
+
+			finish_search(cfg, slots + i);
+			if (!start_search(cfg, cat, slots + i))
+				n_active--;
+		}
+
+		if (cfg->ckdir == NULL || ++steps % CHECKPOINT_STEPS != 0)
+			continue;
+
+		if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+			perror("clock_gettime");
+			abort();
+		}
+
+		if (now.tv_sec - last.tv_sec >= ida_checkpoint_interval) {
+			save_searches(cfg, slots, n);
+			last = now;
+		}
+	}
+
+	free(slots);
+
+	return (NULL);
+}
+
 /*
  * Read puzzles from puzzles and look them up in cat, using fsm for
  * pruning.  Use up to pdb_threads job to do that.  Print solutions and
@@ -104,7 +292,7 @@ lookup_worker(void *cfgarg)
  */
 static void
 lookup_multiple(struct pdb_catalogue *cat, const struct fsm *fsm,
-    FILE *puzzles, int idaflags)
+    FILE *puzzles, const char *ckdir, int idaflags, int resume)
 {
 	struct psearch_config cfg;
 	pthread_t pool[PDB_MAX_JOBS];
@@ -113,7 +301,11 @@ lookup_multiple(struct pdb_catalogue *cat, const struct fsm *fsm,
 	cfg.puzzles = puzzles;
 	cfg.cat = cat;
 	cfg.fsm = fsm;
+	cfg.ckdir = ckdir;
+	cfg.lineno = 0;
 	cfg.idaflags = idaflags;
+	cfg.resume = resume;
+	cfg.next_worker = 0;
 	error = pthread_mutex_init(&cfg.lock, NULL);
 	if (error != 0) {
 		errno = error;
@@ -157,7 +349,7 @@ lookup_multiple(struct pdb_catalogue *cat, const struct fsm *fsm,
 static void
 usage(const char *argv0)
 {
-	fprintf(stderr, "Usage: %s [-Fit] [-j nproc] [-m fsmfile] [-d pdbdir] catalogue puzzles\n", argv0);
+	fprintf(stderr, "Usage: %s [-FHNeilrtw] [-C interval] [-I interleave] [-c ckdir] [-j nproc] [-M ttable_mb] [-P radius] [-m fsmfile] [-d pdbdir] catalogue puzzles\n", argv0);
 
 	exit(EXIT_FAILURE);
 }
@@ -168,19 +360,63 @@ main(int argc, char *argv[])
 	struct pdb_catalogue *cat;
 	const struct fsm *fsm = &fsm_simple, *newfsm;
 	FILE *puzzles, *fsmfile;
-	int optchar, catflags = 0, idaflags = 0, transpose = 0;
-	char *pdbdir = NULL;
+	size_t ttable_mb = 0;
+	int optchar, catflags = 0, idaflags = 0, transpose = 0, warmup = 0, warmflags = 0, resume = 0;
+	char *pdbdir = NULL, *ckdir = NULL, *fsmname = NULL;
 
-	while (optchar = getopt(argc, argv, "Fd:ij:m:t"), optchar != -1)
+	while (optchar = getopt(argc, argv, "C:FHI:M:NP:c:d:eij:lm:rtw"), optchar != -1)
 		switch (optchar) {
+		case 'C':
+			ida_checkpoint_interval = atoi(optarg);
+			break;
+
 		case 'F':
 			idaflags |= IDA_LAST_FULL;
 			break;
 
+		case 'H':
+			huge_pages = 1;
+			break;
+
+		case 'I':
+			ida_interleave = atoi(optarg);
+			if (ida_interleave < 1 || ida_interleave > IDA_MAX_INTERLEAVE) {
+				fprintf(stderr, "Interleave count must be between 1 and %d\n",
+				    IDA_MAX_INTERLEAVE);
+				return (EXIT_FAILURE);
+			}
+
+			break;
+
+		case 'M':
+			ttable_mb = strtoull(optarg, NULL, 0);
+			break;
+
+		case 'N':
+			numa_aware = 1;
+			break;
+
+		case 'P':
+			ida_perimeter = perimeter_generate(atoi(optarg), stderr);
+			if (ida_perimeter == NULL) {
+				perror("perimeter_generate");
+				return (EXIT_FAILURE);
+			}
+
+			break;
+
+		case 'c':
+			ckdir = optarg;
+			break;
+
 		case 'd':
 			pdbdir = optarg;
 			break;
 
+		case 'e':
+			idaflags |= IDA_EPE;
+			break;
+
 		case 'i':
 			catflags |= CAT_IDENTIFY;
 			break;
@@ -195,47 +431,100 @@ main(int argc, char *argv[])
 
 			break;
 
+		case 'l':
+			warmup = 1;
+			warmflags |= WARMUP_LOCK;
+			break;
+
 		case 'm':
-			fsmfile = fopen(optarg, "rb");
-			if (fsmfile == NULL) {
-				perror(optarg);
-				fprintf(stderr, "Proceeding anyway...\n");
-				break;
-			}
+			fsmname = optarg;
+			break;
 
-			newfsm = fsm_load(fsmfile);
-			if (fsm == NULL) {
-				perror("fsm_load");
-				fprintf(stderr, "Proceeding anyway...\n");
-			} else
-				fsm = newfsm;
 
-			fclose(fsmfile);
+		case 'r':
+			resume = 1;
 			break;
 
-
 		case 't':
 			transpose = 0;
 			break;
 
+		case 'w':
+			warmup = 1;
+			break;
+
 		default:
 			usage(argv[0]);
 		}
 
-	if (argc != optind + 2)
+	if (argc != optind + 2 || resume && ckdir == NULL)
 		usage(argv[0]);
 
+	fprintf(stderr, "Using %s index functions\n", isa_name(isa_current));
+
+	/* deferred until all options are known so -H applies */
+	if (fsmname != NULL) {
+		fsmfile = fopen(fsmname, "rb");
+		if (fsmfile == NULL) {
+			perror(fsmname);
+			fprintf(stderr, "Proceeding anyway...\n");
+		} else {
+			newfsm = fsm_load(fsmfile);
+			if (newfsm == NULL) {
+				perror("fsm_load");
+				fprintf(stderr, "Proceeding anyway...\n");
+			} else
+				fsm = newfsm;
+
+			fclose(fsmfile);
+		}
+	}
+
+	if (ttable_mb != 0) {
+		ida_ttable = ttable_allocate(ttable_mb << 20);
+		if (ida_ttable == NULL) {
+			perror("ttable_allocate");
+			return (EXIT_FAILURE);
+		}
+	}
+
 	cat = catalogue_load(argv[optind], pdbdir, catflags, NULL);
 	if (cat == NULL) {
 		perror("catalogue_load");
 		return (EXIT_FAILURE);
 	}
 
+	if (huge_pages) {
+		catalogue_huge_report(cat, stderr);
+		if (fsm->arena != NULL)
+			huge_report(stderr, "finite state machine", fsm->arena, fsm->arena_size);
+
+		if (ida_ttable != NULL)
+			huge_report(stderr, "transposition table", ida_ttable->buckets,
+			    (ida_ttable->mask + 1) * sizeof *ida_ttable->buckets);
+	}
+
+	if (warmup && catalogue_warmup(cat, warmflags, stderr) != 0) {
+		perror("catalogue_warmup");
+		fprintf(stderr, "Proceeding anyway...\n");
+	}
+
 	if (transpose && catalogue_add_transpositions(cat) != 0) {
 		perror("catalogue_add_transpositions");
 		fprintf(stderr, "Proceeding anyway...\n");
 	}
 
+	if (idaflags & IDA_EPE && catalogue_add_deltas(cat, NULL) != 0) {
+		perror("catalogue_add_deltas");
+		fprintf(stderr, "Proceeding anyway...\n");
+		idaflags &= ~IDA_EPE;
+	}
+
+	if (numa_aware && catalogue_replicate(cat, stderr) != 0) {
+		perror("catalogue_replicate");
+		fprintf(stderr, "Proceeding anyway...\n");
+	}
+
 	puzzles = fopen(argv[optind + 1], "r");
 	if (puzzles == NULL) {
 		perror("fopen");
@@ -250,7 +539,7 @@ main(int argc, char *argv[])
 	 */
 	setvbuf(stdout, NULL, _IOLBF, 0);
 
-	lookup_multiple(cat, fsm, puzzles, idaflags);
+	lookup_multiple(cat, fsm, puzzles, ckdir, idaflags, resume);
 
 	return (EXIT_SUCCESS);
 }
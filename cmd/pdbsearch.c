@@ -36,17 +36,23 @@
 #include "search.h"
 #include "catalogue.h"
 #include "fsm.h"
+#include "hugepage.h"
 #include "pdb.h"
+#include "perimeter.h"
 #include "index.h"
+#include "isa.h"
+#include "numa.h"
 #include "puzzle.h"
 #include "tileset.h"
+#include "ttable.h"
+#include "warmup.h"
 
 enum { CHUNK_SIZE = 1024 };
 
 static void
 usage(const char *argv0)
 {
-	fprintf(stderr, "Usage: %s [-Fit] [-j nproc] [-m fsmfile] [-d pdbdir] catalogue\n", argv0);
+	fprintf(stderr, "Usage: %s [-FHNeiklprtw] [-C interval] [-I interleave] [-b backward_mb] [-c checkpoint] [-j nproc] [-M ttable_mb] [-P radius] [-m fsmfile] [-d pdbdir] catalogue\n", argv0);
 
 	exit(EXIT_FAILURE);
 }
@@ -59,19 +65,68 @@ main(int argc, char *argv[])
 	struct path path;
 	struct puzzle p;
 	FILE *fsmfile;
-	int optchar, catflags = 0, idaflags = IDA_VERBOSE, transpose = 0;
-	char linebuf[1024], pathstr[PATH_STR_LEN], *pdbdir = NULL;
+	size_t ttable_mb = 0;
+	int optchar, catflags = 0, idaflags = IDA_VERBOSE, transpose = 0, warmup = 0, warmflags = 0;
+	char linebuf[1024], pathstr[PATH_STR_LEN], *pdbdir = NULL, *fsmname = NULL;
 
-	while (optchar = getopt(argc, argv, "Fd:ij:m:t"), optchar != -1)
+	while (optchar = getopt(argc, argv, "C:FHI:M:NP:b:c:d:eij:klm:prtw"), optchar != -1)
 		switch (optchar) {
+		case 'C':
+			ida_checkpoint_interval = atoi(optarg);
+			break;
+
 		case 'F':
 			idaflags |= IDA_LAST_FULL;
 			break;
 
+		case 'H':
+			huge_pages = 1;
+			break;
+
+		case 'I':
+			ida_interleave = atoi(optarg);
+			if (ida_interleave < 1 || ida_interleave > IDA_MAX_INTERLEAVE) {
+				fprintf(stderr, "Interleave count must be between 1 and %d\n",
+				    IDA_MAX_INTERLEAVE);
+				return (EXIT_FAILURE);
+			}
+
+			break;
+
+		case 'M':
+			ttable_mb = strtoull(optarg, NULL, 0);
+			break;
+
+		case 'N':
+			numa_aware = 1;
+			break;
+
+		case 'P':
+			ida_perimeter = perimeter_generate(atoi(optarg), stderr);
+			if (ida_perimeter == NULL) {
+				perror("perimeter_generate");
+				return (EXIT_FAILURE);
+			}
+
+			break;
+
+		case 'b':
+			idaflags |= IDA_BIDIRECTIONAL;
+			ida_bidirectional_size = strtoull(optarg, NULL, 0) << 20;
+			break;
+
+		case 'c':
+			ida_checkpoint = optarg;
+			break;
+
 		case 'd':
 			pdbdir = optarg;
 			break;
 
+		case 'e':
+			idaflags |= IDA_EPE;
+			break;
+
 		case 'i':
 			catflags |= CAT_IDENTIFY;
 			break;
@@ -86,45 +141,107 @@ main(int argc, char *argv[])
 
 			break;
 
+		case 'k':
+			idaflags |= IDA_FRONTIER;
+			break;
+
+		case 'l':
+			warmup = 1;
+			warmflags |= WARMUP_LOCK;
+			break;
+
 		case 'm':
-			fprintf(stderr, "Loading finite state machine file %s\n", optarg);
-			fsmfile = fopen(optarg, "rb");
-			if (fsmfile == NULL) {
-				perror(optarg);
-				return (EXIT_FAILURE);
-			}
+			fsmname = optarg;
+			break;
 
-			fsm = fsm_load(fsmfile);
-			if (fsm == NULL) {
-				perror("fsm_load");
-				return (EXIT_FAILURE);
-			}
+		case 'p':
+			idaflags |= IDA_PARALLEL;
+			break;
 
-			fclose(fsmfile);
+		case 'r':
+			idaflags |= IDA_RESUME;
 			break;
 
 		case 't':
 			transpose = 1;
 			break;
 
+		case 'w':
+			warmup = 1;
+			break;
+
 		default:
 			usage(argv[0]);
 		}
 
-	if (argc != optind + 1)
+	if (argc != optind + 1 || idaflags & IDA_RESUME && ida_checkpoint == NULL)
 		usage(argv[0]);
 
+	fprintf(stderr, "Using %s index functions\n", isa_name(isa_current));
+
+	/* deferred until all options are known so -H applies */
+	if (fsmname != NULL) {
+		fprintf(stderr, "Loading finite state machine file %s\n", fsmname);
+		fsmfile = fopen(fsmname, "rb");
+		if (fsmfile == NULL) {
+			perror(fsmname);
+			return (EXIT_FAILURE);
+		}
+
+		fsm = fsm_load(fsmfile);
+		if (fsm == NULL) {
+			perror("fsm_load");
+			return (EXIT_FAILURE);
+		}
+
+		fclose(fsmfile);
+	}
+
+	if (ttable_mb != 0) {
+		ida_ttable = ttable_allocate(ttable_mb << 20);
+		if (ida_ttable == NULL) {
+			perror("ttable_allocate");
+			return (EXIT_FAILURE);
+		}
+	}
+
 	cat = catalogue_load(argv[optind], pdbdir, catflags, stderr);
 	if (cat == NULL) {
 		perror("catalogue_load");
 		return (EXIT_FAILURE);
 	}
 
+	if (huge_pages) {
+		catalogue_huge_report(cat, stderr);
+		if (fsm->arena != NULL)
+			huge_report(stderr, "finite state machine", fsm->arena, fsm->arena_size);
+
+		if (ida_ttable != NULL)
+			huge_report(stderr, "transposition table", ida_ttable->buckets,
+			    (ida_ttable->mask + 1) * sizeof *ida_ttable->buckets);
+	}
+
+	if (warmup && catalogue_warmup(cat, warmflags, stderr) != 0) {
+		perror("catalogue_warmup");
+		fprintf(stderr, "Proceeding anyway...\n");
+	}
+
 	if (transpose && catalogue_add_transpositions(cat) != 0) {
 		perror("catalogue_add_transpositions");
 		fprintf(stderr, "Proceeding anyway...\n");
 	}
 
+	if (idaflags & IDA_EPE && catalogue_add_deltas(cat, stderr) != 0) {
+		perror("catalogue_add_deltas");
+		fprintf(stderr, "Proceeding anyway...\n");
+		idaflags &= ~IDA_EPE;
+	}
+
+	if (numa_aware && catalogue_replicate(cat, stderr) != 0) {
+		perror("catalogue_replicate");
+		fprintf(stderr, "Proceeding anyway...\n");
+	}
+
 	for (;;) {
 		printf("Enter instance to solve:\n");
 		if (fgets(linebuf, sizeof linebuf, stdin) == NULL)
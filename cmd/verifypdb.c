@@ -33,11 +33,12 @@
 #include "tileset.h"
 #include "index.h"
 #include "pdb.h"
+#include "parallel.h"
 
 static void
 usage(const char *argv0)
 {
-	fprintf(stderr, "Usage: %s -f file [-j nproc] [-t tile,tile,...]\n", argv0);
+	fprintf(stderr, "Usage: %s -f file [-s] [-j nproc] [-t tile,tile,...]\n", argv0);
 
 	exit(EXIT_FAILURE);
 }
@@ -47,11 +48,11 @@ main(int argc, char *argv[])
 {
 	struct patterndb *pdb;
 	tileset ts = DEFAULT_TILESET;
-	int optchar;
+	int optchar, stats = 0, result;
 	const char *fname = NULL;
 	FILE *f = NULL;
 
-	while (optchar = getopt(argc, argv, "f:j:t:"), optchar != -1)
+	while (optchar = getopt(argc, argv, "f:j:st:"), optchar != -1)
 		switch (optchar) {
 		case 'f':
 			fname = optarg;
@@ -67,6 +68,10 @@ main(int argc, char *argv[])
 
 			break;
 
+		case 's':
+			stats = 1;
+			break;
+
 		case 't':
 			if (tileset_parse(&ts, optarg) != 0) {
 				fprintf(stderr, "Cannot parse tile set: %s\n", optarg);
@@ -104,5 +109,9 @@ main(int argc, char *argv[])
 
 	fclose(f);
 
-	return (pdb_verify(pdb, stderr));
+	result = pdb_verify(pdb, stderr);
+	if (stats)
+		parallel_report(stderr);
+
+	return (result);
 }
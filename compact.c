@@ -47,18 +47,20 @@ pack_puzzle(struct compact_puzzle *restrict cp, const struct puzzle *restrict p)
 #if HAS_PDEP == 1
 	/* pext is available iff pdep is available */
 	unsigned long long scratch, data;
+	unsigned data32;
 
-	data = *(const unsigned long long*)&p->tiles[1];
+	/* memcpy() instead of pointer casts to not violate strict aliasing */
+	memcpy(&data, &p->tiles[1], sizeof data);
 	scratch = _pext_u64(data, 0x1f1f1f1f1f1f1f1full) << 4;
-	data = *(unsigned*)&p->tiles[9];
-	scratch |= (unsigned long long)_pext_u32(data, 0x1f1f1f1fu) << 4 + 8 * 5;
+	memcpy(&data32, &p->tiles[9], sizeof data32);
+	scratch |= (unsigned long long)_pext_u32(data32, 0x1f1f1f1fu) << 4 + 8 * 5;
 
 	cp->lo = scratch;
 
-	data = *(const unsigned long long*)&p->tiles[13];
+	memcpy(&data, &p->tiles[13], sizeof data);
 	scratch = _pext_u64(data, 0x1f1f1f1f1f1f1f1full);
-	data = *(unsigned*)&p->tiles[21];
-	scratch |= (unsigned long long)_pext_u32(data, 0x1f1f1f1fu) << 8 * 5;
+	memcpy(&data32, &p->tiles[21], sizeof data32);
+	scratch |= (unsigned long long)_pext_u32(data32, 0x1f1f1f1fu) << 8 * 5;
 
 	cp->hi = scratch;
 #else /* HAS_PDEP != 1 */
@@ -105,18 +107,19 @@ unpack_puzzle(struct puzzle *restrict p, const struct compact_puzzle *restrict c
 #if HAS_PDEP == 1
 	size_t i;
 	unsigned long long data;
+	unsigned data32;
 
 	memset(p, 0, sizeof *p);
 
 	data = _pdep_u64(cp->lo >> 4, 0x1f1f1f1f1f1f1f1full);
-	*(unsigned long long *)&p->tiles[1] = data;
-	data = _pdep_u32(cp->lo >> 4 + 8 * 5, 0x1f1f1f1fu);
-	*(unsigned *)&p->tiles[9] = data;
+	memcpy(&p->tiles[1], &data, sizeof data);
+	data32 = _pdep_u32(cp->lo >> 4 + 8 * 5, 0x1f1f1f1fu);
+	memcpy(&p->tiles[9], &data32, sizeof data32);
 
 	data = _pdep_u64(cp->hi, 0x1f1f1f1f1f1f1f1full);
-	*(unsigned long long *)&p->tiles[13] = data;
-	data = _pdep_u32(cp->hi >> 8 * 5, 0x1f1f1f1fu);
-	*(unsigned *)&p->tiles[21] = data;
+	memcpy(&p->tiles[13], &data, sizeof data);
+	data32 = _pdep_u32(cp->hi >> 8 * 5, 0x1f1f1f1fu);
+	memcpy(&p->tiles[21], &data32, sizeof data32);
 
 	for (i = 1; i < TILE_COUNT; i++)
 		p->grid[p->tiles[i]] = i;
@@ -181,17 +181,37 @@ has_moribund(struct fsmfile *header)
 	return (1);
 }
 
+/*
+ * Allocate storage for n bytes of the tables of fsm.  If fsm has an
+ * arena, take the storage from the arena at *offset and advance
+ * *offset.  Otherwise, allocate it with malloc().
+ */
+static void *
+fsm_table_alloc(struct fsm *fsm, size_t *offset, size_t n)
+{
+	void *table;
+
+	if (fsm->arena == NULL)
+		return (malloc(n));
+
+	table = (char *)fsm->arena + *offset;
+	*offset += n;
+
+	return (table);
+}
+
 /*
  * Load a finite state machine from file fsmfile.  On success, return a
  * pointer to the FSM loader.  On error, return NULL and set errno to
- * indicate the problem.
+ * indicate the problem.  If huge_pages is set, the tables are backed
+ * by huge pages.
  */
 extern struct fsm *
 fsm_load(FILE *fsmfile)
 {
 	struct fsmfile_moribund header;
 	struct fsm *fsm = malloc(sizeof *fsm);
-	size_t i, count;
+	size_t i, count, offset = 0;
 	int error, moribund;
 
 	if (fsm == NULL)
@@ -203,6 +223,10 @@ fsm_load(FILE *fsmfile)
 		fsm->moribund[i] = NULL;
 	}
 
+	fsm->arena = NULL;
+	fsm->arena_size = 0;
+	fsm->huge = HUGE_NONE;
+
 	/* load main header */
 	rewind(fsmfile);
 	count = fread(&header.header, sizeof header.header, 1, fsmfile);
@@ -222,10 +246,21 @@ fsm_load(FILE *fsmfile)
 			goto fail_ferror;
 	}
 
+	/* the state tables come first in the arena, keeping them aligned */
+	if (huge_pages) {
+		for (i = 0; i < TILE_COUNT; i++)
+			fsm->arena_size += header.header.lengths[i]
+			    * (sizeof *fsm->tables[i] + sizeof *fsm->moribund[i]);
+
+		fsm->arena = huge_alloc(fsm->arena_size, &fsm->huge);
+		if (fsm->arena == NULL)
+			goto fail;
+	}
+
 	/* load tables */
 	for (i = 0; i < TILE_COUNT; i++) {
 		fsm->sizes[i] = header.header.lengths[i];
-		fsm->tables[i] = malloc(fsm->sizes[i] * sizeof *fsm->tables[i]);
+		fsm->tables[i] = fsm_table_alloc(fsm, &offset, fsm->sizes[i] * sizeof *fsm->tables[i]);
 		if (fsm->tables[i] == NULL)
 			goto fail;
 
@@ -239,7 +274,7 @@ fsm_load(FILE *fsmfile)
 
 	/* load moribund tables or fake them */
 	for (i = 0; i < TILE_COUNT; i++) {
-		fsm->moribund[i] = malloc(fsm->sizes[i] * sizeof *fsm->moribund[i]);
+		fsm->moribund[i] = fsm_table_alloc(fsm, &offset, fsm->sizes[i] * sizeof *fsm->moribund[i]);
 		if (fsm->moribund[i] == NULL)
 			goto fail;
 
@@ -32,6 +32,7 @@
 #include <stdio.h>
 
 #include "builtins.h"
+#include "hugepage.h"
 #include "puzzle.h"
 
 /*
@@ -41,7 +42,9 @@
  * of these tables, lengths stores the number of 32 bit integers in each
  * table.  struct fsm is the in-memory representation of a finite state
  * machine and contains pointers to the tables as well as the actually
- * allocated table sizes.
+ * allocated table sizes.  If arena is not NULL, all tables are carved
+ * out of this single allocation of arena_size bytes, backed by huge
+ * pages as indicated by huge.
  */
 struct fsmfile {
 	/* table offsets in bytes from the beginning of the file */
@@ -69,6 +72,9 @@ struct fsm {
 	unsigned sizes[TILE_COUNT];
 	unsigned (*tables[TILE_COUNT])[4];
 	unsigned char *moribund[TILE_COUNT];
+	void *arena;
+	size_t arena_size;
+	int huge;
 };
 
 /*
@@ -119,10 +125,13 @@ fsm_free(struct fsm *fsm)
 {
 	size_t i;
 
-	for (i = 0; i < TILE_COUNT; i++) {
-		free(fsm->tables[i]);
-		free(fsm->moribund[i]);
-	}
+	if (fsm->arena != NULL)
+		huge_unmap(fsm->arena, fsm->arena_size, fsm->huge);
+	else
+		for (i = 0; i < TILE_COUNT; i++) {
+			free(fsm->tables[i]);
+			free(fsm->moribund[i]);
+		}
 
 	free(fsm);
 }
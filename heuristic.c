@@ -29,12 +29,15 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include "bitpdb.h"
+#include "hugepage.h"
 #include "heuristic.h"
+#include "numa.h"
 #include "transposition.h"
 #include "tileset.h"
 #include "puzzle.h"
@@ -225,7 +228,8 @@ success:
 }
 
 /*
- * hval, hdiff, and free implementations for struct patterndb based heuristics.
+ * hval, hdiff, hlocate, hfetch, and free implementations for struct
+ * patterndb based heuristics.
  */
 static int
 pdb_hval_wrapper(void *provider, const struct puzzle *p)
@@ -243,6 +247,30 @@ pdb_hdiff_wrapper(void *provider, const struct puzzle *p, int old_h)
 	return (pdb_lookup_puzzle((struct patterndb *)provider, p));
 }
 
+static size_t
+pdb_hlocate_wrapper(void *provider, const struct puzzle *p)
+{
+	struct patterndb *pdb = provider;
+	struct index idx;
+	size_t offset;
+
+	compute_index(&pdb->aux, &idx, p);
+	offset = index_offset(&pdb->aux, &idx);
+	prefetch(pdb->data + offset);
+
+	return (offset);
+}
+
+static int
+pdb_hfetch_wrapper(void *provider, size_t offset, int old_h)
+{
+	struct patterndb *pdb = provider;
+
+	(void)old_h;
+
+	return (pdb->data[offset]);
+}
+
 static void
 pdb_free_wrapper(void *provider)
 {
@@ -261,7 +289,7 @@ common_pdb_driver(struct heuristic *heu, const char *heudir,
 {
 	FILE *pdbfile;
 	struct patterndb *pdb;
-	int fd, saved_errno;
+	int fd, saved_errno, readin;
 	char pathbuf[PATH_MAX];
 
 	if (heudir == NULL) {
@@ -300,9 +328,24 @@ common_pdb_driver(struct heuristic *heu, const char *heudir,
 	if (flags & HEU_VERBOSE)
 		fprintf(stderr, "Loading PDB file %s\n", pathbuf);
 
-	pdb = pdb_mmap(ts, fd, PDB_MAP_RDONLY);
-	saved_errno = errno;
-	close(fd);
+	/* a mapping only uses huge pages if the file is on hugetlbfs */
+	readin = huge_pages && !huge_fd_is_hugetlbfs(fd);
+	if (readin) {
+		pdbfile = fdopen(fd, "rb");
+		if (pdbfile == NULL) {
+			saved_errno = errno;
+			close(fd);
+			pdb = NULL;
+		} else {
+			pdb = pdb_load(ts, pdbfile);
+			saved_errno = errno;
+			fclose(pdbfile);
+		}
+	} else {
+		pdb = pdb_mmap(ts, fd, PDB_MAP_RDONLY);
+		saved_errno = errno;
+		close(fd);
+	}
 
 	/*
 	 * if we can open the file but not map the PDB,
@@ -312,7 +355,7 @@ common_pdb_driver(struct heuristic *heu, const char *heudir,
 	if (pdb == NULL) {
 		errno = saved_errno;
 		if (flags & HEU_VERBOSE) {
-			perror("pdb_mmap");
+			perror(readin ? "pdb_load" : "pdb_mmap");
 			errno = saved_errno;
 		}
 
@@ -374,6 +417,12 @@ create_pdb:
 		goto success;
 	}
 
+	/* keep the PDB in huge pages unless the file is backed by them, too */
+	if (huge_pages && !huge_fd_is_hugetlbfs(fileno(pdbfile))) {
+		fclose(pdbfile);
+		goto success;
+	}
+
 	pdb_free(pdb);
 	pdb = pdb_mmap(ts, fileno(pdbfile), PDB_MAP_RDONLY);
 	saved_errno = errno;
@@ -393,11 +442,28 @@ success:
 	heu->provider = pdb;
 	heu->hval = pdb_hval_wrapper;
 	heu->hdiff = pdb_hdiff_wrapper;
+	heu->hlocate = pdb_hlocate_wrapper;
+	heu->hfetch = pdb_hfetch_wrapper;
+	heu->hdata = pdb->data;
 	heu->free = pdb_free_wrapper;
 
 	return (0);
 }
 
+/*
+ * If heu is backed by a struct patterndb, return that struct
+ * patterndb.  Otherwise return NULL.  Configurations must be morphed
+ * with heu->morphism before they are looked up in the PDB.
+ */
+extern struct patterndb *
+heu_pdb(struct heuristic *heu)
+{
+	if (heu->hval != pdb_hval_wrapper)
+		return (NULL);
+
+	return (heu->provider);
+}
+
 /*
  * Driver for PDBs that do not account for the zero tile.
  */
@@ -433,7 +499,8 @@ zpdb_driver(struct heuristic *heu, const char *heudir,
 }
 
 /*
- * hval, hdiff, and free implementations for struct bitpdb based heuristics.
+ * hval, hdiff, hlocate, hfetch, and free implementations for struct
+ * bitpdb based heuristics.
  */
 static int
 bitpdb_hval_wrapper(void *provider, const struct puzzle *p)
@@ -449,6 +516,20 @@ bitpdb_hdiff_wrapper(void *provider, const struct puzzle *p, int old_h)
 	return (bitpdb_diff_lookup((struct bitpdb *)provider, p, old_h));
 }
 
+static size_t
+bitpdb_hlocate_wrapper(void *provider, const struct puzzle *p)
+{
+
+	return (bitpdb_locate((struct bitpdb *)provider, p));
+}
+
+static int
+bitpdb_hfetch_wrapper(void *provider, size_t offset, int old_h)
+{
+
+	return (bitpdb_fetch((struct bitpdb *)provider, offset, old_h));
+}
+
 static void
 bitpdb_free_wrapper(void *provider)
 {
@@ -601,6 +682,9 @@ success:
 	heu->provider = bpdb;
 	heu->hval = bitpdb_hval_wrapper;
 	heu->hdiff = bitpdb_hdiff_wrapper;
+	heu->hlocate = bitpdb_hlocate_wrapper;
+	heu->hfetch = bitpdb_hfetch_wrapper;
+	heu->hdata = NULL;
 	heu->free = bitpdb_free_wrapper;
 
 	return (0);
@@ -661,3 +745,87 @@ bitpdb_zstd_driver(struct heuristic *heu, const char *heudir,
 	return (common_bitpdb_driver(heu, heudir, ts, tsstr, flags,
 	    "bpdb.zst", bitpdb_load_compressed, bitpdb_store_compressed));
 }
+
+/*
+ * Return a pointer to the table backing heu and store its size in
+ * *size.  If heu is not backed by a table, return NULL.
+ */
+extern const void *
+heu_table(struct heuristic *heu, size_t *size)
+{
+	struct patterndb *pdb;
+	struct bitpdb *bpdb;
+
+	if (heu->hval == pdb_hval_wrapper) {
+		pdb = heu->provider;
+		*size = search_space_size(&pdb->aux);
+		return (pdb->data);
+	} else if (heu->hval == bitpdb_hval_wrapper) {
+		bpdb = heu->provider;
+		*size = bitpdb_size(&bpdb->aux);
+		return (bpdb->data);
+	} else
+		return (NULL);
+}
+
+/*
+ * Make dst a copy of heu whose table resides on NUMA node node.  The
+ * copy has its own provider and must be released with heu_free()
+ * separately from heu.  Only heuristics backed by a table can be
+ * copied.  On success, return 0.  On failure, return -1 and set errno
+ * and leave dst unchanged.
+ */
+extern int
+heu_replicate(struct heuristic *dst, struct heuristic *heu, int node)
+{
+	struct patterndb *pdb, *pdbcopy = NULL;
+	struct bitpdb *bpdb, *bpdbcopy = NULL;
+	size_t size;
+	void *data;
+	int error;
+
+	if (heu->hval == pdb_hval_wrapper) {
+		pdb = heu->provider;
+		pdbcopy = pdb_allocate(pdb->aux.ts);
+		if (pdbcopy == NULL)
+			return (-1);
+
+		data = (void *)pdbcopy->data;
+		size = search_space_size(&pdb->aux);
+	} else if (heu->hval == bitpdb_hval_wrapper) {
+		bpdb = heu->provider;
+		bpdbcopy = bitpdb_allocate(bpdb->aux.ts);
+		if (bpdbcopy == NULL)
+			return (-1);
+
+		data = bpdbcopy->data;
+		size = bitpdb_size(&bpdb->aux);
+	} else {
+		errno = EINVAL;
+		return (-1);
+	}
+
+	/* bind before copying so the pages are created on node */
+	if (numa_bind(data, size, node) != 0) {
+		error = errno;
+		if (pdbcopy != NULL)
+			pdb_free(pdbcopy);
+		else
+			bitpdb_free(bpdbcopy);
+
+		errno = error;
+		return (-1);
+	}
+
+	memcpy(data, heu_table(heu, &size), size);
+
+	*dst = *heu;
+	dst->derived = 0;
+	if (pdbcopy != NULL) {
+		dst->provider = pdbcopy;
+		dst->hdata = pdbcopy->data;
+	} else
+		dst->provider = bpdbcopy;
+
+	return (0);
+}
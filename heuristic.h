@@ -26,6 +26,7 @@
 #ifndef HEURISTIC_H
 #define HEURISTIC_H
 
+#include <stdatomic.h>
 #include <stdio.h>
 
 #include "tileset.h"
@@ -41,15 +42,24 @@
  * The underlying heuristic provider is queried using the hval function
  * provider.  A differential query can be made using the hdiff function
  * pointer which, given two adjacent puzzle configurations and the h
- * value for one of them, yields the h value for the other.  A call to
- * the free function pointer should release the storage associated with
- * the underlying heuristic.  If derived is set, the heuristic has been
- * derived from another one and heu_free() is a no-op.
+ * value for one of them, yields the h value for the other.  A
+ * differential query can also be split into two parts: hlocate computes
+ * where the entry for a configuration is found and prefetches it,
+ * hfetch later retrieves the h value from that location.  This allows
+ * the caller to overlap the memory accesses for multiple lookups.  If
+ * the h value is simply the byte at that location in some table, hdata
+ * points to that table and hfetch is not used.  A
+ * call to the free function pointer should release the storage
+ * associated with the underlying heuristic.  If derived is set, the
+ * heuristic has been derived from another one and heu_free() is a no-op.
  */
 struct heuristic {
 	void *provider;
 	int (*hval)(void *, const struct puzzle *);
 	int (*hdiff)(void *, const struct puzzle *, int);
+	size_t (*hlocate)(void *, const struct puzzle *);
+	int (*hfetch)(void *, size_t, int);
+	const atomic_uchar *hdata;
 	void (*free)(void *);
 	tileset ts;
 	unsigned morphism; /* the automorphism to apply */
@@ -77,7 +87,11 @@ enum {
  * zstd compressed pattern database.
  */
 
+struct patterndb;
 extern int	heu_open(struct heuristic *, const char *, tileset, const char *, int);
+extern struct patterndb	*heu_pdb(struct heuristic *);
+extern const void	*heu_table(struct heuristic *, size_t *);
+extern int	heu_replicate(struct heuristic *, struct heuristic *, int);
 
 /*
  * Look up the h value provided by heu for p.
@@ -117,6 +131,37 @@ heu_diff_hval(struct heuristic *heu, const struct puzzle *p, int old_h)
 	return (heu->hdiff(heu->provider, pp, old_h));
 }
 
+/*
+ * Compute the location of the entry for p in heu and prefetch it.
+ * Return the location for use with heu_fetch().
+ */
+static inline size_t
+heu_locate(struct heuristic *heu, const struct puzzle *p)
+{
+	struct puzzle p_morphed;
+	const struct puzzle *pp = p;
+
+	if (heu->morphism != 0) {
+		p_morphed = *p;
+		morph(&p_morphed, heu->morphism);
+		pp = &p_morphed;
+	}
+
+	return (heu->hlocate(heu->provider, pp));
+}
+
+/*
+ * Retrieve the h value at location loc as returned by heu_locate().
+ * old_h has the same meaning as in heu_diff_hval().
+ */
+static inline unsigned
+heu_fetch(struct heuristic *heu, size_t loc, int old_h)
+{
+	if (heu->hdata != NULL)
+		return (heu->hdata[loc]);
+	else
+		return (heu->hfetch(heu->provider, loc, old_h));
+}
 
 /*
  * Release the storage associated with heu.
@@ -139,6 +184,10 @@ heu_morph(struct heuristic *heu, struct heuristic *oldheu, int morphism)
 {
 	heu->provider = oldheu->provider;
 	heu->hval = oldheu->hval;
+	heu->hdiff = oldheu->hdiff;
+	heu->hlocate = oldheu->hlocate;
+	heu->hfetch = oldheu->hfetch;
+	heu->hdata = oldheu->hdata;
 	heu->free = oldheu->free;
 	heu->ts = tileset_morph(oldheu->ts, morphism);
 	heu->morphism = compose_morphisms(oldheu->morphism, inverse_morphism(morphism));
@@ -0,0 +1,257 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* hugepage.c -- back large tables with huge pages */
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+# include <sys/vfs.h>
+#endif
+
+#include "hugepage.h"
+
+#ifndef MAP_ANONYMOUS
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* from <linux/mman.h>, asks for 2 MiB pages instead of the default size */
+#if !defined(MAP_HUGE_2MB) && defined(MAP_HUGE_SHIFT)
+# define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+#ifndef MAP_HUGE_2MB
+# define MAP_HUGE_2MB 0
+#endif
+
+/* from <linux/magic.h> */
+#define HUGETLBFS_MAGIC 0x958458f6
+
+int huge_pages = 0;
+
+/*
+ * Return the length of the mapping backing a table of size bytes
+ * with the given kind of backing.
+ */
+static size_t
+huge_length(size_t size, int kind)
+{
+	if (kind == HUGE_NONE)
+		return (size);
+	else
+		return ((size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1));
+}
+
+/*
+ * Allocate size bytes of anonymous memory backed by huge pages.  Try
+ * the pool of 2 MiB huge pages first, even if the system's default
+ * huge page size differs.  If it is exhausted, allocate memory aligned
+ * to a huge page boundary and ask for transparent huge pages.  Store
+ * the kind of backing in *kind.  Release the memory with huge_unmap().
+ * On failure, return NULL and set errno.
+ */
+extern void *
+huge_alloc(size_t size, int *kind)
+{
+	size_t len = huge_length(size, HUGE_THP), head;
+	char *addr;
+
+#ifdef MAP_HUGETLB
+	addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+	if (addr != MAP_FAILED) {
+		*kind = HUGE_TLB;
+		return (addr);
+	}
+#endif
+
+	/* over-allocate so the table can be aligned */
+	addr = mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED)
+		return (NULL);
+
+	head = -(uintptr_t)addr & (HUGE_PAGE_SIZE - 1);
+	if (head > 0)
+		munmap(addr, head);
+
+	munmap(addr + head + len, HUGE_PAGE_SIZE - head);
+	addr += head;
+
+#ifdef MADV_HUGEPAGE
+	madvise(addr, len, MADV_HUGEPAGE);
+#endif
+
+	*kind = HUGE_THP;
+	return (addr);
+}
+
+/*
+ * Check if fd refers to a file on a hugetlbfs mount with huge pages of
+ * HUGE_PAGE_SIZE bytes.
+ */
+extern int
+huge_fd_is_hugetlbfs(int fd)
+{
+#ifdef __linux__
+	struct statfs st;
+
+	if (fstatfs(fd, &st) != 0)
+		return (0);
+
+	return ((unsigned long)st.f_type == HUGETLBFS_MAGIC && st.f_bsize == HUGE_PAGE_SIZE);
+#else
+	(void)fd;
+	return (0);
+#endif
+}
+
+/*
+ * Map size bytes of file fd like mmap() with the given protection and
+ * flags.  If fd is on hugetlbfs, the mapping is backed by huge pages
+ * and the length is rounded up accordingly.  Store the kind of backing
+ * in *kind.  Release the mapping with huge_unmap().  On failure,
+ * return MAP_FAILED and set errno.
+ */
+extern void *
+huge_map(size_t size, int prot, int flags, int fd, int *kind)
+{
+	*kind = huge_fd_is_hugetlbfs(fd) ? HUGE_TLB : HUGE_NONE;
+
+	return (mmap(NULL, huge_length(size, *kind), prot, flags, fd, 0));
+}
+
+/*
+ * Release the table of size bytes at addr as allocated by huge_alloc()
+ * or huge_map() with backing kind.
+ */
+extern void
+huge_unmap(void *addr, size_t size, int kind)
+{
+	munmap(addr, huge_length(size, kind));
+}
+
+/*
+ * Shrink the table at addr as allocated by huge_alloc() with backing
+ * kind from oldsize to newsize bytes, releasing the huge pages no
+ * longer needed.
+ */
+extern void
+huge_shrink(void *addr, size_t oldsize, size_t newsize, int kind)
+{
+	size_t oldlen = huge_length(oldsize, kind), newlen = huge_length(newsize, kind);
+
+	if (newlen < oldlen)
+		munmap((char *)addr + newlen, oldlen - newlen);
+}
+
+/*
+ * Write size bytes from buf to the empty file fd on a hugetlbfs mount.
+ * Such files cannot be written to with write(), so the file is resized
+ * and mapped instead.  Return 0 on success.  On failure, return -1 and
+ * set errno.
+ */
+extern int
+huge_store(int fd, const void *buf, size_t size)
+{
+	size_t len = huge_length(size, HUGE_TLB);
+	void *addr;
+
+	if (ftruncate(fd, len) != 0)
+		return (-1);
+
+	addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED)
+		return (-1);
+
+	memcpy(addr, buf, size);
+	munmap(addr, len);
+
+	return (0);
+}
+
+/*
+ * Return how many of the len bytes at addr are backed by huge pages
+ * according to /proc/self/smaps.  If this cannot be found out, return
+ * (size_t)-1.
+ */
+extern size_t
+huge_resident(const void *addr, size_t len)
+{
+	FILE *smaps;
+	uintmax_t lo, hi, begin = (uintptr_t)addr, end = begin + len;
+	size_t total = 0, kb;
+	int inside = 0;
+	char line[256], key[64];
+
+	smaps = fopen("/proc/self/smaps", "r");
+	if (smaps == NULL)
+		return ((size_t)-1);
+
+	while (fgets(line, sizeof line, smaps) != NULL) {
+		/* mapping header: lo-hi perms offset dev inode path */
+		if (sscanf(line, "%jx-%jx ", &lo, &hi) == 2) {
+			inside = lo < end && begin < hi;
+			continue;
+		}
+
+		if (!inside || sscanf(line, "%63[^:]: %zu kB", key, &kb) != 2)
+			continue;
+
+		if (strcmp(key, "AnonHugePages") == 0
+		    || strcmp(key, "ShmemPmdMapped") == 0
+		    || strcmp(key, "FilePmdMapped") == 0
+		    || strcmp(key, "Shared_Hugetlb") == 0
+		    || strcmp(key, "Private_Hugetlb") == 0)
+			total += kb * 1024;
+	}
+
+	fclose(smaps);
+
+	return (total < len ? total : len);
+}
+
+/*
+ * Print a line to f telling how much of the table name of len bytes
+ * at addr is backed by huge pages.
+ */
+extern void
+huge_report(FILE *f, const char *name, const void *addr, size_t len)
+{
+	size_t resident = huge_resident(addr, len);
+
+	if (resident == (size_t)-1)
+		fprintf(f, "%s: %.1f MiB, huge page usage unknown\n",
+		    name, len / 1048576.0);
+	else
+		fprintf(f, "%s: %.1f of %.1f MiB in huge pages\n",
+		    name, resident / 1048576.0, len / 1048576.0);
+}
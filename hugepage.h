@@ -0,0 +1,67 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* hugepage.h -- back large tables with huge pages */
+
+#ifndef HUGEPAGE_H
+#define HUGEPAGE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * PDB lookups are random accesses into tables of hundreds of megabytes,
+ * so with 4 KiB pages nearly every lookup misses the TLB.  If
+ * huge_pages is set, PDBs, bitpdbs, FSM tables, and transposition
+ * tables are allocated from the huge page pool (MAP_HUGETLB) where
+ * possible and with transparent huge pages (madvise(MADV_HUGEPAGE))
+ * otherwise.  PDB files are read into such memory instead of being
+ * mapped, unless they reside on a hugetlbfs mount in which case the
+ * mapping itself is backed by huge pages.  Only huge pages of
+ * HUGE_PAGE_SIZE bytes are supported.  Like pdb_jobs, huge_pages is
+ * intended to be set once during program initialisation.  The HUGE_*
+ * constants describe how a table is backed.  Whether transparent huge
+ * pages were actually used can only be found out with huge_resident().
+ */
+extern int huge_pages;
+
+enum {
+	HUGE_PAGE_SIZE = 2 * 1024 * 1024,
+
+	HUGE_NONE = 0,	/* normal pages */
+	HUGE_THP,	/* aligned to huge pages, transparent huge pages requested */
+	HUGE_TLB,	/* backed by the huge page pool */
+};
+
+extern void	*huge_alloc(size_t, int *);
+extern void	*huge_map(size_t, int, int, int, int *);
+extern void	huge_unmap(void *, size_t, int);
+extern void	huge_shrink(void *, size_t, size_t, int);
+extern int	huge_fd_is_hugetlbfs(int);
+extern int	huge_store(int, const void *, size_t);
+extern size_t	huge_resident(const void *, size_t);
+extern void	huge_report(FILE *, const char *, const void *, size_t);
+
+#endif /* HUGEPAGE_H */
@@ -28,50 +28,241 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <errno.h>
-#include <setjmp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "catalogue.h"
+#include "compact.h"
 #include "fsm.h"
+#include "numa.h"
 #include "pdb.h"
+#include "perimeter.h"
 #include "puzzle.h"
 #include "search.h"
 #include "tileset.h"
 #include "transposition.h"
+#include "ttable.h"
+
+/*
+ * Parameters for the parallel search and the frontier.  For a
+ * parallel search, the search tree is split into subtrees at the
+ * shallowest depth that yields at least FRONTIER_PER_JOB subtrees per
+ * thread.  With IDA_FRONTIER, the frontier is kept across iterations
+ * at the shallowest depth that yields FRONTIER_MEMO_LEN nodes.  In
+ * both cases, no frontier deeper than FRONTIER_MAX_DEPTH is used.
+ */
+enum {
+	FRONTIER_MAX_DEPTH = 32,
+	FRONTIER_PER_JOB = 64,
+	FRONTIER_MEMO_LEN = 1 << 14,
+};
+
+/*
+ * Only consult the transposition table for nodes at least this many
+ * moves away from the bound.  For nodes closer to the bound, the
+ * subtrees saved are not worth the extra cache misses.
+ */
+enum { TTABLE_MIN_DEPTH = 4 };
+
+/*
+ * When checkpointing, check the time every CHECKPOINT_STEPS nodes
+ * expanded to see if a checkpoint is due.
+ */
+enum { CHECKPOINT_STEPS = 1 << 16 };
+
+struct ttable *ida_ttable = NULL;
+struct perimeter *ida_perimeter = NULL;
+size_t ida_bidirectional_size = (size_t)1 << 30;
+int ida_interleave = 1;
+const char *ida_checkpoint = NULL;
+int ida_checkpoint_interval = 600;
+
+/*
+ * A node of the search tree at which the search tree is split into
+ * independent subtrees.  moves holds the path leading to the node,
+ * fmax is the highest f value of any node on that path.
+ */
+struct frontier_node {
+	struct puzzle p;
+	struct partial_hvals ph;
+	struct fsm_state st;
+	unsigned short fmax;
+	unsigned char moves[FRONTIER_MAX_DEPTH];
+};
+
+/*
+ * All nodes of the search tree at a given depth, in the order the
+ * search visits them.
+ */
+struct frontier {
+	struct frontier_node *nodes;
+	size_t n_nodes, n_alloc, depth;
+};
+
+struct parallel_search;
 
 struct search_state {
-	jmp_buf finish;
 	struct pdb_catalogue *cat;
 	const struct fsm *fsm;
 	struct path *path;
 	size_t bound;
-	unsigned long long expanded, pruned;
+	unsigned long long expanded, pruned, ttcut;
 	int n_solutions, flags;
 	void (*on_solved)(const struct path *, void *);
 	void *on_solved_payload;
+
+	/* perimeter searched towards or NULL */
+	struct perimeter *perimeter;
+
+	/* frontier kept across iterations with IDA_FRONTIER */
+	const struct frontier *memo;
+
+	/* parallel search only: shared state and splitting depth */
+	struct parallel_search *par;
+	size_t frontier_depth;
 };
 
 /*
- * Expand the search tree for configuration p recursively.  Assume the
- * search path up to here has had length g already.  Use the search
- * state in sst.
+ * State shared by the threads of a parallel search.  The subtrees
+ * below the frontier nodes form a pool from which each worker grabs
+ * the next subtree when it is done with the previous one, so workers
+ * that finish early keep taking work from those still busy.
+ */
+struct parallel_search {
+	struct search_state proto;	/* template for the workers' state */
+	pthread_mutex_t lock;		/* serializes solution reporting */
+	const struct frontier *frontier;
+	struct frontier split;		/* frontier made by split_search() */
+	_Atomic size_t next_node;
+	_Atomic unsigned long long expanded, pruned, ttcut;
+	atomic_int n_solutions, stop, next_worker;
+};
+
+/*
+ * Allocate a new node at the end of fr and return a pointer to it.
+ * If storage is insufficient, abort the program.
+ */
+static struct frontier_node *
+frontier_push(struct frontier *fr)
+{
+	struct frontier_node *nodes;
+	size_t n_alloc;
+
+	if (fr->n_nodes >= fr->n_alloc) {
+		n_alloc = fr->n_alloc < 64 ? 64 : fr->n_alloc * 2;
+		nodes = realloc(fr->nodes, n_alloc * sizeof *nodes);
+		if (nodes == NULL) {
+			perror("realloc");
+			abort();
+		}
+
+		fr->nodes = nodes;
+		fr->n_alloc = n_alloc;
+	}
+
+	return (fr->nodes + fr->n_nodes++);
+}
+
+/*
+ * Compute the frontier of the search tree for p at the shallowest
+ * depth with at least FRONTIER_MEMO_LEN nodes, but no deeper than
+ * limit, and store it in fr.  Unlike the frontier computed by
+ * split_search(), this frontier is not pruned by any bound, so it
+ * can be reused for all iterations.  A node in the frontier is reached
+ * by an iteration exactly when its fmax does not exceed the bound.
  */
 static void
-expand_node(struct search_state *sst, size_t g, struct puzzle *p,
-    struct fsm_state st, struct partial_hvals *ph)
+frontier_build(struct frontier *fr, struct pdb_catalogue *cat,
+    const struct fsm *fsm, const struct puzzle *p, size_t limit)
 {
-	struct partial_hvals pph;
-	struct fsm_state ast;
-	size_t i, h, n_moves, zloc, dest, tile;
+	struct frontier next = { NULL, 0, 0, 0 }, tmp;
+	struct frontier_node *fn, *child;
+	size_t i, j, n_moves, zloc, dest, tile, h;
 	const signed char *moves;
 
-	h = catalogue_ph_hval(sst->cat, ph);
-	if (h == 0 && memcmp(p->tiles, solved_puzzle.tiles, TILE_COUNT) == 0) {
+	if (limit > FRONTIER_MAX_DEPTH)
+		limit = FRONTIER_MAX_DEPTH;
+
+	fr->n_nodes = 0;
+	fr->depth = 0;
+	fn = frontier_push(fr);
+	fn->p = *p;
+	fn->st = fsm_start_state(zero_location(p));
+	catalogue_partial_hvals(&fn->ph, cat, p);
+	fn->fmax = catalogue_ph_hval(cat, &fn->ph);
+
+	while (fr->depth < limit && fr->n_nodes > 0 && fr->n_nodes < FRONTIER_MEMO_LEN) {
+		next.n_nodes = 0;
+		for (i = 0; i < fr->n_nodes; i++) {
+			fn = fr->nodes + i;
+			zloc = zero_location(&fn->p);
+			moves = get_moves(zloc);
+			n_moves = move_count(zloc);
+
+			for (j = 0; j < n_moves; j++) {
+				dest = moves[j];
+				if (fsm_is_match(fsm_advance_idx(fsm, fn->st, j)))
+					continue;
+
+				child = frontier_push(&next);
+				*child = *fn;
+				child->st = fsm_advance_idx(fsm, fn->st, j);
+				child->moves[fr->depth] = dest;
+				tile = child->p.grid[dest];
+				move(&child->p, dest);
+				catalogue_diff_hvals(&child->ph, cat, &child->p, tile);
+				h = fr->depth + 1 + catalogue_ph_hval(cat, &child->ph);
+				if (h > child->fmax)
+					child->fmax = h;
+			}
+		}
+
+		tmp = *fr;
+		*fr = next;
+		fr->depth = tmp.depth + 1;
+		next = tmp;
+	}
+
+	free(next.nodes);
+}
+
+/*
+ * Return the perimeter to search towards with catalogue cat: the larger
+ * of ida_perimeter and the endgame table of cat, NULL if there is none.
+ */
+static struct perimeter *
+default_perimeter(const struct pdb_catalogue *cat)
+{
+	if (ida_perimeter == NULL || cat->endgame != NULL
+	    && cat->endgame->radius > ida_perimeter->radius)
+		return (cat->endgame);
+	else
+		return (ida_perimeter);
+}
+
+/*
+ * Record that a solution of length g has been found in sst->path.
+ * Report it to the caller.  Return 1 if the search is to be terminated
+ * (i.e. unless IDA_LAST_FULL is set), 0 otherwise.  In a parallel
+ * search, only the first solution found when IDA_LAST_FULL is not set
+ * is reported.
+ */
+static int
+found_solution(struct search_state *sst, size_t g)
+{
+	struct parallel_search *par = sst->par;
+	int error;
+
+	sst->path->pathlen = g;
+
+	if (par == NULL) {
 		sst->n_solutions++;
-		sst->path->pathlen = g;
 
 		if (sst->flags & IDA_VERBOSE)
 			fprintf(stderr, "Solution found at depth %zu\n", g);
@@ -79,89 +270,1028 @@ expand_node(struct search_state *sst, size_t g, struct puzzle *p,
 		if (sst->on_solved != NULL)
 			sst->on_solved(sst->path, sst->on_solved_payload);
 
-		if (~sst->flags & IDA_LAST_FULL)
-			longjmp(sst->finish, 1);
+		return (~sst->flags & IDA_LAST_FULL ? 1 : 0);
+	}
 
-		return;
+	error = pthread_mutex_lock(&par->lock);
+	if (error != 0) {
+		errno = error;
+		perror("pthread_mutex_lock");
+		abort();
 	}
 
-	if (g + h > sst->bound)
-		return;
+	/* did another thread beat us to it? */
+	if (atomic_load(&par->stop)) {
+		pthread_mutex_unlock(&par->lock);
+		return (1);
+	}
+
+	sst->n_solutions++;
+	*par->proto.path = *sst->path;
+
+	if (sst->flags & IDA_VERBOSE)
+		fprintf(stderr, "Solution found at depth %zu\n", g);
+
+	if (sst->on_solved != NULL)
+		sst->on_solved(sst->path, sst->on_solved_payload);
+
+	if (~sst->flags & IDA_LAST_FULL)
+		atomic_store(&par->stop, 1);
+
+	pthread_mutex_unlock(&par->lock);
+
+	return (~sst->flags & IDA_LAST_FULL ? 1 : 0);
+}
+
+/*
+ * The search itself is a depth-first search with an explicit stack
+ * through the tree below a single node.  Nodes at depth
+ * sst.frontier_depth are not expanded but added to the frontier of
+ * sst.par instead.  As the search state is kept in a struct dfs instead
+ * of on the call stack, a search can be suspended after each node
+ * expanded, so multiple searches can be interleaved on the same thread:
+ * whenever a node is expanded, the PDB entries of its children are
+ * located and prefetched.  The search is then suspended and only
+ * resumed once the other searches have had their turn, by which time
+ * these entries are likely in the cache.
+ */
+enum {
+	DFS_RUNNING,	/* more nodes to expand */
+	DFS_DONE,	/* subtree searched completely */
+	DFS_STOPPED,	/* search terminated early */
+};
+
+/*
+ * A node on the stack of a struct dfs.  Besides the node's own partial
+ * h values and FSM state, it holds the FSM states and PDB entry
+ * locations of its children, the index of the next child to visit, and
+ * the least f value found below the node so far.  With IDA_EPE, loc
+ * holds the locations of the node's own PDB entries instead and cut
+ * marks the children exceeding the bound.
+ */
+struct dfs_frame {
+	struct partial_hvals ph;
+	struct fsm_state st, ast[4];
+	struct compact_puzzle cp;
+	size_t fmin;
+	unsigned char zloc, n_moves, next, use_ttable, cut;
+	union {
+		struct hval_locations hl[4];
+		struct hval_locations loc;
+	};
+};
 
-	fsm_prefetch(sst->fsm, st);
+/*
+ * The state of an explicit-stack search.  stack[depth] is the node
+ * currently being expanded, p is its configuration.  The search started
+ * at stack[root_depth].  path holds the search path if sst.path does
+ * not point elsewhere.
+ */
+struct dfs {
+	struct search_state sst;
+	struct puzzle p;
+	struct path path;
+	size_t depth, root_depth;
+	int stopped, running;
+	struct dfs_frame stack[SEARCH_PATH_LEN + 2];
+};
+
+/*
+ * Evaluate the node on top of the stack of d, assuming its partial h
+ * values and FSM state have been filled in and h is the h value they
+ * give (a lower bound if some are stale).  If the node is to be
+ * expanded, prepare its frame, locate the PDB entries of its children,
+ * and return 1.  Otherwise store its f value in *f and return 0.
+ */
+static inline int
+dfs_enter(struct dfs *d, size_t h, size_t *f)
+{
+	struct search_state *sst = &d->sst;
+	struct dfs_frame *fr = d->stack + d->depth;
+	struct frontier_node *fn;
+	size_t i, g = d->depth, dest, tile;
+	int dist;
+	const signed char *moves;
+
+	if (h == 0 && memcmp(d->p.tiles, solved_puzzle.tiles, TILE_COUNT) == 0) {
+		if (found_solution(sst, g))
+			d->stopped = 1;
+
+		*f = g;
+		return (0);
+	}
+
+	if (g + h > sst->bound) {
+		*f = g + h;
+		return (0);
+	}
+
+	/* entries skipped by catalogue_bounded_fetch() are needed after all */
+	if (fr->ph.stale != 0) {
+		catalogue_ph_refresh(&fr->ph, sst->cat, &d->p);
+		h = catalogue_ph_hval(sst->cat, &fr->ph);
+		if (g + h > sst->bound) {
+			*f = g + h;
+			return (0);
+		}
+	}
+
+	/* only nodes with h within the radius can be on the perimeter */
+	if (sst->perimeter != NULL && h <= (size_t)sst->perimeter->radius) {
+		dist = perimeter_distance(sst->perimeter, &d->p);
+		if (dist != PERIMETER_MISS) {
+			*f = g + dist;
+			if (g + dist <= sst->bound) {
+				perimeter_path(sst->path->moves + g, sst->perimeter, &d->p);
+				if (found_solution(sst, g + dist))
+					d->stopped = 1;
+			}
+
+			return (0);
+		}
+
+		h = perimeter_hval(sst->perimeter, zero_location(&d->p));
+		if (g + h > sst->bound) {
+			*f = g + h;
+			return (0);
+		}
+	}
+
+	if (g == sst->frontier_depth) {
+		fn = frontier_push(&sst->par->split);
+		fn->p = d->p;
+		fn->ph = fr->ph;
+		fn->st = fr->st;
+		fn->fmax = 0;
+		memcpy(fn->moves, sst->path->moves, g);
+		*f = g + h;
+		return (0);
+	}
+
+	fr->use_ttable = ida_ttable != NULL && g + TTABLE_MIN_DEPTH <= sst->bound
+	    && ~sst->flags & IDA_BIDIRECTIONAL;
+	if (fr->use_ttable) {
+		pack_puzzle(&fr->cp, &d->p);
+		h = ttable_lookup(ida_ttable, &fr->cp, fr->st.state);
+		if (g + h > sst->bound) {
+			sst->ttcut++;
+			*f = g + h;
+			return (0);
+		}
+	}
+
+	fsm_prefetch(sst->fsm, fr->st);
 	sst->expanded++;
-	zloc = zero_location(p);
-	moves = get_moves(zloc);
-	n_moves = move_count(zloc);
+	fr->zloc = zero_location(&d->p);
+	fr->n_moves = move_count(fr->zloc);
+	fr->next = 0;
+	fr->cut = 0;
+	fr->fmin = SIZE_MAX;
+	moves = get_moves(fr->zloc);
+
+	/* with IDA_EPE, the children are evaluated by dfs_cut() instead */
+	for (i = 0; i < fr->n_moves; i++) {
+		fr->ast[i] = fsm_advance_idx(sst->fsm, fr->st, i);
+		if (fsm_is_match(fr->ast[i]) || sst->flags & IDA_EPE)
+			continue;
+
+		dest = moves[i];
+		tile = d->p.grid[dest];
+		move(&d->p, dest);
+		catalogue_diff_locate(fr->hl + i, sst->cat, &fr->ph, &d->p, tile);
+		move(&d->p, fr->zloc);
+	}
+
+	return (1);
+}
+
+/*
+ * Check if the search d has been terminated, either because d found a
+ * solution or because another thread of a parallel search did.
+ */
+static inline int
+dfs_stopped(const struct dfs *d)
+{
+	return (d->stopped || (d->sst.par != NULL
+	    && atomic_load_explicit(&d->sst.par->stop, memory_order_relaxed)));
+}
+
+/*
+ * EPEIDA*: compute the f values of the children of the node on top of
+ * the stack of d from the delta tables and mark those exceeding the
+ * bound in fr->cut so they are never generated.  Their f values are
+ * accounted for in fr->fmin as if they had been generated.
+ */
+static inline void
+dfs_cut(struct dfs *d, struct dfs_frame *fr)
+{
+	struct partial_hvals ph;
+	size_t i, f, dest;
+	const signed char *moves = get_moves(fr->zloc);
+
+	for (i = 0; i < fr->n_moves; i++) {
+		if (fsm_is_match(fr->ast[i]))
+			continue;
 
-	for (i = 0; i < n_moves; i++) {
 		dest = moves[i];
-		ast = fsm_advance_idx(sst->fsm, st, i);
-		if (fsm_is_match(ast)) {
+		catalogue_ph_copy(&ph, d->sst.cat, &fr->ph);
+		catalogue_delta_hvals(&ph, d->sst.cat, &fr->loc, d->p.grid[dest],
+		    move_direction(dest, fr->zloc));
+		f = d->depth + 1 + catalogue_ph_hval(d->sst.cat, &ph);
+		if (f > d->sst.bound) {
+			fr->cut |= 1 << i;
+			if (f < fr->fmin)
+				fr->fmin = f;
+		}
+	}
+}
+
+/*
+ * Descend from the node on top of the stack of d into its child i,
+ * filling in the child's partial h values and FSM state and recording
+ * the move on the search path.  Then evaluate the child with
+ * dfs_enter() and return what it returns.
+ */
+static inline int
+dfs_push(struct dfs *d, size_t i, size_t *f)
+{
+	struct dfs_frame *fr = d->stack + d->depth, *child = fr + 1;
+	struct pdb_catalogue *cat = d->sst.cat;
+	size_t dest, tile, h;
+
+	dest = get_moves(fr->zloc)[i];
+	d->sst.path->moves[d->depth] = dest;
+	tile = d->p.grid[dest];
+	move(&d->p, dest);
+	catalogue_ph_copy(&child->ph, cat, &fr->ph);
+	if (d->sst.flags & IDA_EPE) {
+		catalogue_delta_hvals(&child->ph, cat, &fr->loc, tile,
+		    move_direction(dest, fr->zloc));
+		memcpy(child->loc.locs, fr->loc.locs, cat->n_heus * sizeof *fr->loc.locs);
+		catalogue_delta_locate(&child->loc, cat, &d->p, tile);
+		h = catalogue_ph_hval(cat, &child->ph);
+	} else
+		h = catalogue_bounded_fetch(&child->ph, cat, fr->hl + i, tile,
+		    d->sst.bound - d->depth - 1);
+
+	child->st = fr->ast[i];
+
+	d->depth++;
+	return (dfs_enter(d, h, f));
+}
+
+/*
+ * Advance the search d.  If yield is set, return after the next node
+ * has been expanded, otherwise search the whole subtree.  Return
+ * DFS_RUNNING if there are more nodes to expand, DFS_DONE if the
+ * subtree has been searched completely and DFS_STOPPED if the search
+ * has been terminated because a solution was found.
+ */
+static inline int
+dfs_step(struct dfs *d, int yield)
+{
+	struct search_state *sst = &d->sst;
+	struct dfs_frame *fr;
+	size_t f, i;
+
+	if (dfs_stopped(d))
+		return (DFS_STOPPED);
+
+	for (;;) {
+		fr = d->stack + d->depth;
+		if (fr->next == 0 && sst->flags & IDA_EPE)
+			dfs_cut(d, fr);
+
+		if (fr->next >= fr->n_moves) {
+			/* learn from subtrees searched without finding a solution */
+			if (fr->use_ttable && fr->fmin > sst->bound)
+				ttable_store(ida_ttable, &fr->cp, fr->st.state, fr->fmin - d->depth);
+
+			if (d->depth == d->root_depth)
+				return (DFS_DONE);
+
+			f = fr->fmin;
+			fr--;
+			d->depth--;
+			move(&d->p, fr->zloc);
+			if (f < fr->fmin)
+				fr->fmin = f;
+
+			continue;
+		}
+
+		i = fr->next++;
+		if (fsm_is_match(fr->ast[i])) {
 			sst->pruned++;
 			continue;
 		}
 
-		sst->path->moves[g] = dest;
+		if (fr->cut & 1 << i)
+			continue;
+
+		if (dfs_push(d, i, &f)) {
+			if (yield)
+				return (DFS_RUNNING);
+
+			if (dfs_stopped(d))
+				return (DFS_STOPPED);
+
+			continue;
+		}
+
+		d->depth--;
+		move(&d->p, fr->zloc);
+		if (f < fr->fmin)
+			fr->fmin = f;
+
+		if (d->stopped)
+			return (DFS_STOPPED);
+	}
+}
+
+/*
+ * Start a search in d from configuration p with partial h values ph
+ * and FSM state st at depth g.  The first g moves of d->sst.path must
+ * have been filled in by the caller.  Return the search status like
+ * dfs_step() does.
+ */
+static int
+dfs_start(struct dfs *d, const struct puzzle *p,
+    const struct partial_hvals *ph, struct fsm_state st, size_t g)
+{
+	size_t f;
+
+	d->p = *p;
+	d->depth = g;
+	d->root_depth = g;
+	d->stopped = 0;
+	d->stack[g].ph = *ph;
+	d->stack[g].st = st;
+	if (d->sst.flags & IDA_EPE)
+		catalogue_delta_locations(&d->stack[g].loc, d->sst.cat, p);
+
+	if (dfs_enter(d, catalogue_ph_hval(d->sst.cat, ph), &f))
+		return (DFS_RUNNING);
+	else
+		return (d->stopped ? DFS_STOPPED : DFS_DONE);
+}
+
+/*
+ * Allocate an array of n struct dfs, each initialized with a copy of
+ * proto and its own path.  Abort on failure.
+ */
+static struct dfs *
+dfs_allocate(const struct search_state *proto, size_t n)
+{
+	struct dfs *d;
+	size_t i;
+
+	d = malloc(n * sizeof *d);
+	if (d == NULL) {
+		perror("malloc");
+		abort();
+	}
+
+	for (i = 0; i < n; i++) {
+		d[i].sst = *proto;
+		d[i].sst.path = &d[i].path;
+		d[i].stopped = 0;
+		d[i].running = 0;
+	}
+
+	return (d);
+}
+
+/*
+ * Search the whole tree below configuration p with partial h values ph
+ * and FSM state st at depth g using d.  Return DFS_DONE if the search
+ * ran to completion and DFS_STOPPED if it was terminated.
+ */
+static int
+dfs_run(struct dfs *d, const struct puzzle *p,
+    const struct partial_hvals *ph, struct fsm_state st, size_t g)
+{
+	int status;
+
+	status = dfs_start(d, p, ph, st, g);
+	if (status == DFS_RUNNING)
+		status = dfs_step(d, 0);
+
+	return (status);
+}
+
+/*
+ * A checkpoint records the position of a search within an iteration
+ * so it can be continued later on.  The search was started from
+ * subtree node of the frontier (or from the root if no frontier is
+ * used) at depth root and has descended to depth.  For each frame
+ * from root to depth - 1, moves holds the move taken, next the index
+ * of the next child to visit and fmin the least f value found below
+ * the frame so far.  The node at depth has just been expanded.
+ * expanded counts the nodes expanded in previous iterations,
+ * round_expanded, pruned and ttcut those in the current iteration.
+ */
+struct checkpoint {
+	struct puzzle p;
+	size_t bound, root, node, depth;
+	unsigned long long expanded, round_expanded, pruned, ttcut;
+	unsigned char moves[SEARCH_PATH_LEN], next[SEARCH_PATH_LEN];
+	size_t fmin[SEARCH_PATH_LEN];
+};
 
-		tile = p->grid[dest];
-		move(p, dest);
-		pph = *ph;
-		catalogue_diff_hvals(&pph, sst->cat, p, tile);
-		expand_node(sst, g + 1, p, ast, &pph);
-		move(p, zloc);
+/*
+ * Record the position of the search d in ck.  The search is within
+ * frontier node node.  ck->p and ck->expanded are left alone.
+ */
+static void
+checkpoint_save(struct checkpoint *ck, const struct dfs *d, size_t node)
+{
+	size_t k;
+
+	ck->bound = d->sst.bound;
+	ck->root = d->root_depth;
+	ck->node = node;
+	ck->depth = d->depth;
+	ck->round_expanded = d->sst.expanded;
+	ck->pruned = d->sst.pruned;
+	ck->ttcut = d->sst.ttcut;
+
+	for (k = d->root_depth; k < d->depth; k++) {
+		ck->moves[k] = d->sst.path->moves[k];
+		ck->next[k] = d->stack[k].next;
+		ck->fmin[k] = d->stack[k].fmin;
 	}
 }
 
 /*
- * Use PDB catalogue cat and finite state machine fsm to search for a
- * solution for p with length bound.  Return the number of solutions found.
- * Update bound with the least bound needed to expand extra nodes.
- * Write the number of expanded nodes to expanded.  For each solution found,
- * if on_solved is not NULL call on_solved on the solution with
- * payload as the second argument
+ * Write ck to a file named filename.  To not lose the previous
+ * checkpoint if we are interrupted while doing so, first write to a
+ * temporary file and then rename it to filename.  Return 0 on success,
+ * -1 on error with errno set.
+ */
+static int
+checkpoint_write(const char *filename, const struct checkpoint *ck)
+{
+	FILE *f;
+	size_t k;
+	int error;
+	char *tmpname, puzzlestr[PUZZLE_STR_LEN];
+
+	tmpname = malloc(strlen(filename) + sizeof ".tmp");
+	if (tmpname == NULL)
+		return (-1);
+
+	strcpy(tmpname, filename);
+	strcat(tmpname, ".tmp");
+
+	f = fopen(tmpname, "w");
+	if (f == NULL) {
+		free(tmpname);
+		return (-1);
+	}
+
+	puzzle_string(puzzlestr, &ck->p);
+	fprintf(f, "checkpoint 1\npuzzle %s\nbound %zu\nroot %zu %zu\n",
+	    puzzlestr, ck->bound, ck->root, ck->node);
+	fprintf(f, "expanded %llu %llu\npruned %llu\nttcut %llu\n",
+	    ck->expanded, ck->round_expanded, ck->pruned, ck->ttcut);
+	for (k = ck->root; k < ck->depth; k++)
+		fprintf(f, "frame %d %d %zu\n", ck->moves[k], ck->next[k], ck->fmin[k]);
+
+	if (fflush(f) != 0 || ferror(f) || fsync(fileno(f)) != 0) {
+		error = errno;
+		fclose(f);
+		remove(tmpname);
+		free(tmpname);
+		errno = error;
+		return (-1);
+	}
+
+	if (fclose(f) != 0 || rename(tmpname, filename) != 0) {
+		error = errno;
+		remove(tmpname);
+		free(tmpname);
+		errno = error;
+		return (-1);
+	}
+
+	free(tmpname);
+
+	return (0);
+}
+
+/*
+ * Read a checkpoint from the file named filename into ck.  Return 0 on
+ * success, -1 on error with errno set.  If the file is not a valid
+ * checkpoint, set errno to EINVAL.
+ */
+static int
+checkpoint_read(struct checkpoint *ck, const char *filename)
+{
+	FILE *f;
+	size_t fmin;
+	unsigned move, next;
+	int n;
+	char puzzlestr[PUZZLE_STR_LEN];
+
+	f = fopen(filename, "r");
+	if (f == NULL)
+		return (-1);
+
+	n = fscanf(f, " checkpoint 1 puzzle %75s bound %zu root %zu %zu"
+	    " expanded %llu %llu pruned %llu ttcut %llu", puzzlestr,
+	    &ck->bound, &ck->root, &ck->node, &ck->expanded,
+	    &ck->round_expanded, &ck->pruned, &ck->ttcut);
+	if (n != 8 || puzzle_parse(&ck->p, puzzlestr) != 0
+	    || ck->root > ck->bound || ck->bound >= SEARCH_PATH_LEN)
+		goto invalid;
+
+	for (ck->depth = ck->root; ck->depth <= ck->bound; ck->depth++) {
+		n = fscanf(f, " frame %u %u %zu", &move, &next, &fmin);
+		if (n != 3)
+			break;
+
+		if (move >= TILE_COUNT || next > 4)
+			goto invalid;
+
+		ck->moves[ck->depth] = move;
+		ck->next[ck->depth] = next;
+		ck->fmin[ck->depth] = fmin;
+	}
+
+	if (ferror(f) || fscanf(f, " %*c") != EOF)
+		goto invalid;
+
+	fclose(f);
+
+	return (0);
+
+invalid:
+	fclose(f);
+	errno = EINVAL;
+
+	return (-1);
+}
+
+/*
+ * Check if ck is a checkpoint for a search of p with the given root
+ * depth, number of frontier nodes n_nodes, initial bound and limit.
+ * Print a message to stderr and return -1 if it is not, otherwise
+ * return 0.
  */
 static int
-search_to_bound(struct path *path, struct pdb_catalogue *cat,
-    const struct fsm *fsm, const struct puzzle *p, size_t bound,
-    unsigned long long *expanded, void (*on_solved)(const struct path *,
-    void *), void *payload, int flags) {
+checkpoint_check(const struct checkpoint *ck, const struct puzzle *p,
+    size_t root, size_t n_nodes, size_t bound, size_t limit)
+{
+	if (memcmp(ck->p.tiles, p->tiles, TILE_COUNT) != 0) {
+		fprintf(stderr, "Checkpoint is for a different puzzle.\n");
+		return (-1);
+	}
+
+	if (ck->root != root || ck->node >= n_nodes) {
+		fprintf(stderr, "Checkpoint does not match the search parameters.\n");
+		return (-1);
+	}
+
+	if (ck->bound < bound || (ck->bound - bound) % 2 != 0 || ck->bound > limit) {
+		fprintf(stderr, "Checkpoint has invalid bound %zu.\n", ck->bound);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * Start the search d from configuration p with partial h values ph and
+ * FSM state st at depth g like dfs_start() does, then descend along
+ * the path saved in ck to continue where the search was when ck was
+ * saved.  Restore the counters saved in ck.  If the path in ck does
+ * not fit the search tree, print a message to stderr and start the
+ * search from scratch.  Return the search status like dfs_start().
+ */
+static int
+dfs_restore(struct dfs *d, const struct checkpoint *ck, const struct puzzle *p,
+    const struct partial_hvals *ph, struct fsm_state st, size_t g)
+{
+	struct dfs_frame *fr;
+	size_t f, i, k;
+	int status;
+
+	status = dfs_start(d, p, ph, st, g);
+	for (k = g; status == DFS_RUNNING && k < ck->depth; k++) {
+		fr = d->stack + k;
+		i = (size_t)ck->next[k] - 1;
+		if (i >= fr->n_moves || fsm_is_match(fr->ast[i])
+		    || get_moves(fr->zloc)[i] != ck->moves[k]) {
+			fprintf(stderr, "Checkpoint does not match search tree, restarting subtree.\n");
+			status = dfs_start(d, p, ph, st, g);
+			break;
+		}
+
+		/* the children cut off by dfs_cut() count towards fmin, too */
+		if (d->sst.flags & IDA_EPE)
+			dfs_cut(d, fr);
+
+		fr->next = i + 1;
+		if (ck->fmin[k] < fr->fmin)
+			fr->fmin = ck->fmin[k];
+
+		if (dfs_push(d, i, &f))
+			continue;
+
+		/* the transposition table may cut off the saved path */
+		d->depth--;
+		move(&d->p, fr->zloc);
+		if (f < fr->fmin)
+			fr->fmin = f;
+
+		status = d->stopped ? DFS_STOPPED : DFS_RUNNING;
+		break;
+	}
+
+	d->sst.expanded = ck->round_expanded;
+	d->sst.pruned = ck->pruned;
+	d->sst.ttcut = ck->ttcut;
+
+	return (status);
+}
+
+/*
+ * The state of periodic checkpointing by search_ida_bounded().  ck
+ * holds the checkpoint, last the time it was last written.  If resume
+ * is set, the next search is restored from ck instead of started.
+ */
+struct checkpointer {
+	struct checkpoint ck;
+	struct timespec last;
+	int resume, flags;
+};
+
+/*
+ * Write a checkpoint for the search d in frontier node node to
+ * ida_checkpoint if ida_checkpoint_interval seconds have passed since
+ * the last one.  As solutions are not saved, no checkpoint is written
+ * once a solution has been found.
+ */
+static void
+checkpoint_maybe(struct checkpointer *cp, const struct dfs *d, size_t node)
+{
+	struct timespec now;
+
+	if (d->sst.n_solutions > 0 || clock_gettime(CLOCK_MONOTONIC, &now) != 0
+	    || now.tv_sec - cp->last.tv_sec < ida_checkpoint_interval)
+		return;
+
+	cp->last = now;
+	checkpoint_save(&cp->ck, d, node);
+	if (checkpoint_write(ida_checkpoint, &cp->ck) != 0)
+		perror(ida_checkpoint);
+	else if (cp->flags & IDA_VERBOSE)
+		fprintf(stderr, "Saved checkpoint at depth %zu.\n", d->depth);
+}
+
+/*
+ * Like dfs_run(), but if cp is not NULL, write checkpoints while
+ * searching and resume from cp->ck if cp->resume is set.  node is the
+ * index of the frontier node searched.
+ */
+static int
+dfs_run_checkpointed(struct dfs *d, const struct puzzle *p,
+    const struct partial_hvals *ph, struct fsm_state st, size_t g,
+    size_t node, struct checkpointer *cp)
+{
+	unsigned long steps;
+	int status;
+
+	if (cp == NULL)
+		return (dfs_run(d, p, ph, st, g));
+
+	if (cp->resume) {
+		cp->resume = 0;
+		status = dfs_restore(d, &cp->ck, p, ph, st, g);
+	} else
+		status = dfs_start(d, p, ph, st, g);
+
+	for (steps = 1; status == DFS_RUNNING; steps++) {
+		if (steps % CHECKPOINT_STEPS == 0)
+			checkpoint_maybe(cp, d, node);
+
+		status = dfs_step(d, 1);
+	}
+
+	return (status);
+}
+
+/*
+ * Use the search parameters in proto to search for a solution for p
+ * with length bound.  Return the number of solutions found.  Write
+ * the number of expanded nodes to expanded.  For each solution found,
+ * if proto->on_solved is not NULL call it on the solution with
+ * proto->on_solved_payload as the second argument.  If proto->memo is
+ * not NULL, start the search from the nodes in proto->memo.  If cp
+ * is not NULL, write checkpoints while searching and if cp->resume is
+ * set, continue from the checkpoint in cp->ck.
+ */
+static int
+search_to_bound(const struct search_state *proto, const struct puzzle *p,
+    size_t bound, unsigned long long *expanded, struct checkpointer *cp)
+{
 	struct partial_hvals ph;
-	struct puzzle pp;
-	struct search_state sst;
+	struct dfs *d;
+	const struct frontier_node *fn;
+	size_t i = 0;
+	int n_solutions;
+
+	d = dfs_allocate(proto, 1);
+	d->sst.path = proto->path;
+	d->sst.n_solutions = 0;
+	d->sst.expanded = 0;
+	d->sst.pruned = 0;
+	d->sst.ttcut = 0;
+	d->sst.bound = bound;
+
+	if (cp != NULL && cp->resume)
+		i = cp->ck.node;
+
+	if (d->sst.memo != NULL) {
+		for (; i < d->sst.memo->n_nodes; i++) {
+			fn = d->sst.memo->nodes + i;
+			if (fn->fmax > bound)
+				continue;
+
+			memcpy(d->sst.path->moves, fn->moves, d->sst.memo->depth);
+			if (dfs_run_checkpointed(d, &fn->p, &fn->ph, fn->st,
+			    d->sst.memo->depth, i, cp) == DFS_STOPPED)
+				break;
+		}
+	} else {
+		catalogue_partial_hvals(&ph, d->sst.cat, p);
+		dfs_run_checkpointed(d, p, &ph, fsm_start_state(zero_location(p)), 0, 0, cp);
+	}
+
+	*expanded = d->sst.expanded;
+
+	if (d->sst.flags & IDA_VERBOSE) {
+		fprintf(stderr, "Finite state machine pruned %llu nodes in previous round.\n", d->sst.pruned);
+		if (ida_ttable != NULL)
+			fprintf(stderr, "Transposition table cut off %llu nodes in previous round.\n", d->sst.ttcut);
+	}
+
+	n_solutions = d->sst.n_solutions;
+	if (n_solutions == 0)
+		proto->path->pathlen = SEARCH_NO_PATH;
+
+	free(d);
+
+	return (n_solutions);
+}
+
+/*
+ * Start the search d on the next subtree from the frontier of par that
+ * is reached with the current bound.  Return 1 if a search has been
+ * started, 0 if no subtrees are left or the search has been terminated.
+ */
+static int
+next_subtree(struct parallel_search *par, struct dfs *d)
+{
+	const struct frontier *fr = par->frontier;
+	const struct frontier_node *fn;
+	size_t i;
+
+	for (;;) {
+		i = atomic_fetch_add(&par->next_node, 1);
+		if (i >= fr->n_nodes)
+			return (0);
+
+		fn = fr->nodes + i;
+		if (fn->fmax > d->sst.bound)
+			continue;
+
+		memcpy(d->sst.path->moves, fn->moves, fr->depth);
+		switch (dfs_start(d, &fn->p, &fn->ph, fn->st, fr->depth)) {
+		case DFS_RUNNING:
+			return (1);
+
+		case DFS_STOPPED:
+			return (0);
+		}
+	}
+}
+
+/*
+ * The main function of each thread of a parallel search.  Grab
+ * subtrees from the frontier and search them until no subtrees are
+ * left or the search is terminated.  Search ida_interleave subtrees at
+ * a time, switching between them after each node expanded to hide the
+ * latency of PDB lookups.  If numa_aware is set, the thread is pinned
+ * to its node and uses the node's replica of the PDB catalogue.
+ */
+static void *
+parallel_ida_worker(void *parg)
+{
+	struct parallel_search *par = parg;
+	struct dfs *d;
+	size_t i, n = ida_interleave, n_active = 0;
+	int status, node;
+
+	d = dfs_allocate(&par->proto, n);
+	if (numa_aware) {
+		node = numa_worker_node(atomic_fetch_add(&par->next_worker, 1));
+		numa_pin(node);
+		for (i = 0; i < n; i++)
+			d[i].sst.cat = catalogue_local(d[i].sst.cat, node);
+	}
+
+	for (i = 0; i < n; i++) {
+		d[i].running = next_subtree(par, d + i);
+		n_active += d[i].running;
+	}
+
+	while (n_active > 0)
+		for (i = 0; i < n; i++) {
+			if (!d[i].running)
+				continue;
+
+			status = dfs_step(d + i, n > 1);
+			if (status == DFS_RUNNING)
+				continue;
+
+			d[i].running = status == DFS_DONE && next_subtree(par, d + i);
+			if (!d[i].running)
+				n_active--;
+		}
+
+	for (i = 0; i < n; i++) {
+		atomic_fetch_add(&par->expanded, d[i].sst.expanded);
+		atomic_fetch_add(&par->pruned, d[i].sst.pruned);
+		atomic_fetch_add(&par->ttcut, d[i].sst.ttcut);
+		atomic_fetch_add(&par->n_solutions, d[i].sst.n_solutions);
+	}
+
+	free(d);
+
+	return (NULL);
+}
+
+/*
+ * Split the search tree for p and bound into subtrees and place their
+ * roots into par->split.  Pick the splitting depth such that there
+ * are enough subtrees to keep all threads busy.  Solutions found
+ * above the splitting depth are reported as usual.  Return the number
+ * of nodes expanded above the splitting depth.
+ */
+static unsigned long long
+split_search(struct parallel_search *par, const struct puzzle *p)
+{
+	struct partial_hvals ph;
+	struct dfs *d;
 	struct fsm_state st;
+	unsigned long long expanded;
+	size_t depth;
+	int status;
+
+	d = dfs_allocate(&par->proto, 1);
+	st = fsm_start_state(zero_location(p));
+	catalogue_partial_hvals(&ph, par->proto.cat, p);
+
+	for (depth = 1; ; depth++) {
+		d->sst = par->proto;
+		d->sst.path = &d->path;
+		d->sst.frontier_depth = depth;
+		par->split.n_nodes = 0;
+		par->split.depth = depth;
+
+		status = dfs_run(d, p, &ph, st, 0);
+
+		/*
+		 * Solutions are only ever found at depth bound, so there
+		 * is no point in splitting any deeper than that.
+		 */
+		if (status == DFS_STOPPED || d->sst.n_solutions > 0
+		    || par->split.n_nodes == 0
+		    || par->split.n_nodes >= (size_t)FRONTIER_PER_JOB * pdb_jobs
+		    || depth + 1 >= par->proto.bound || depth >= FRONTIER_MAX_DEPTH)
+			break;
+	}
+
+	atomic_fetch_add(&par->pruned, d->sst.pruned);
+	atomic_fetch_add(&par->ttcut, d->sst.ttcut);
+	atomic_fetch_add(&par->n_solutions, d->sst.n_solutions);
+	expanded = d->sst.expanded;
+	free(d);
 
-	sst.cat = cat;
-	sst.fsm = fsm;
-	sst.path = path;
-	sst.flags = flags;
+	return (expanded);
+}
 
-	sst.n_solutions = 0;
-	sst.expanded = 0;
-	sst.pruned = 0;
-	sst.bound = bound;
-	sst.on_solved = on_solved;
-	sst.on_solved_payload = payload;
+/*
+ * Like search_to_bound(), but search with pdb_jobs threads.  Use the
+ * nodes in proto->memo as subtrees if available, otherwise split the
+ * search tree with split_search().
+ */
+static int
+search_to_bound_parallel(const struct search_state *proto,
+    const struct puzzle *p, size_t bound, unsigned long long *expanded)
+{
+	struct parallel_search par;
+	pthread_t pool[PDB_MAX_JOBS];
+	int i, jobs = pdb_jobs, error;
 
-	if (setjmp(sst.finish))
+	par.proto = *proto;
+	par.proto.n_solutions = 0;
+	par.proto.expanded = 0;
+	par.proto.pruned = 0;
+	par.proto.ttcut = 0;
+	par.proto.bound = bound;
+	par.proto.par = &par;
+
+	par.split.nodes = NULL;
+	par.split.n_nodes = 0;
+	par.split.n_alloc = 0;
+	par.split.depth = 0;
+	par.next_node = 0;
+	par.expanded = 0;
+	par.pruned = 0;
+	par.ttcut = 0;
+	par.n_solutions = 0;
+	par.stop = 0;
+	par.next_worker = 0;
+
+	error = pthread_mutex_init(&par.lock, NULL);
+	if (error != 0) {
+		errno = error;
+		perror("pthread_mutex_init");
+		abort();
+	}
+
+	proto->path->pathlen = SEARCH_NO_PATH;
+
+	if (proto->memo != NULL)
+		par.frontier = proto->memo;
+	else {
+		par.expanded = split_search(&par, p);
+		par.frontier = &par.split;
+
+		if (proto->flags & IDA_VERBOSE)
+			fprintf(stderr, "Split search tree into %zu subtrees at depth %zu.\n",
+			    par.split.n_nodes, par.split.depth);
+	}
+
+	if (atomic_load(&par.stop))
+		goto finish;
+
+	/* for easier debugging, don't multithread when jobs == 1 */
+	if (jobs == 1) {
+		parallel_ida_worker(&par);
 		goto finish;
+	}
+
+	/* spawn threads */
+	for (i = 0; i < jobs; i++) {
+		error = pthread_create(pool + i, NULL, parallel_ida_worker, &par);
+		if (error == 0)
+			continue;
+
+		errno = error;
+		perror("pthread_create");
 
-	pp = *p; /* allow us to modify p */
-	st = fsm_start_state(zero_location(&pp));
-	catalogue_partial_hvals(&ph, sst.cat, &pp);
+		/* proceed with fewer threads if we can */
+		if (i > 0)
+			break;
 
-	expand_node((struct search_state *)&sst, 0, &pp, st, &ph);
+		fprintf(stderr, "Couldn't create any threads, aborting...\n");
+		abort();
+	}
+
+	/* reduce count in case we couldn't create as many threads as we wanted */
+	jobs = i;
+
+	/* collect threads */
+	for (i = 0; i < jobs; i++) {
+		error = pthread_join(pool[i], NULL);
+		if (error == 0)
+			continue;
+
+		errno = error;
+		perror("pthread_join");
+		abort();
+	}
 
 finish:
-	*expanded = sst.expanded;
+	pthread_mutex_destroy(&par.lock);
+	free(par.split.nodes);
 
-	if (flags & IDA_VERBOSE)
-		fprintf(stderr, "Finite state machine pruned %llu nodes in previous round.\n", sst.pruned);
+	*expanded = par.expanded;
 
-	if (sst.n_solutions == 0)
-		path->pathlen = SEARCH_NO_PATH;
+	if (proto->flags & IDA_VERBOSE) {
+		fprintf(stderr, "Finite state machine pruned %llu nodes in previous round.\n", par.pruned);
+		if (ida_ttable != NULL)
+			fprintf(stderr, "Transposition table cut off %llu nodes in previous round.\n", par.ttcut);
+	}
+
+	if (par.n_solutions == 0)
+		proto->path->pathlen = SEARCH_NO_PATH;
 
-	return (sst.n_solutions);
+	return (par.n_solutions);
 }
 
 /*
@@ -211,6 +1341,16 @@ verify(const struct puzzle *p, const struct path *path)
  * return the number of nodes expanded.  If f is not NULL, print
  * diagnostic messages to f.  If on_solved is not NULL, call on_solved
  * for each solution found with the solution and payload for arguments.
+ * If flags contains IDA_PARALLEL, search with pdb_jobs threads.  In
+ * this case, on_solved may be called from any of these threads, but
+ * never concurrently.  If flags contains IDA_FRONTIER, store the
+ * nodes near the root once and start each iteration from them instead
+ * of from p.  If ida_checkpoint is set, save the state of the search
+ * to it periodically and, if flags contains IDA_RESUME, continue the
+ * search from there.  The checkpoint is removed once the search is
+ * done.  If flags contains IDA_BIDIRECTIONAL, search backwards from
+ * the solved configuration before each iteration and search forwards
+ * towards the nodes found.
  */
 extern unsigned long long
 search_ida_bounded(struct pdb_catalogue *cat, const struct fsm *fsm,
@@ -218,27 +1358,123 @@ search_ida_bounded(struct pdb_catalogue *cat, const struct fsm *fsm,
     void (*on_solved)(const struct path *, void *), void *payload, int flags)
 {
 	struct timespec begin, round_begin, round_end, duration;
+	struct search_state proto;
+	struct frontier memo = { NULL, 0, 0, 0 };
+	struct checkpointer cp, *cpp = NULL;
+	struct perimeter *backward = NULL;
 	unsigned long long expanded, total_expanded = 0;
 	double dur;
 	size_t bound;
+	clockid_t clock;
 	int n_solution = 0, no_clocks = 0;
 
+	/* the CPU time of this thread is meaningless in a parallel search */
+	clock = flags & IDA_PARALLEL ? CLOCK_MONOTONIC : CLOCK_THREAD_CPUTIME_ID;
+
 	if (~flags & IDA_VERBOSE)
 		no_clocks = 1;
-	else if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin) != 0) {
+	else if (clock_gettime(clock, &begin) != 0) {
 		perror("clock_gettime");
 		no_clocks = 1;
 	} else
 		round_end = begin;
 
+	proto.cat = cat;
+	proto.fsm = fsm;
+	proto.path = path;
+	proto.flags = flags;
+	proto.on_solved = on_solved;
+	proto.on_solved_payload = payload;
+	proto.perimeter = default_perimeter(cat);
+	proto.memo = NULL;
+	proto.par = NULL;
+	proto.frontier_depth = SIZE_MAX;
+
+	bound = catalogue_hval(cat, p);
+
+	/*
+	 * No node above depth bound can be a solution, so the frontier
+	 * may be placed at depth bound without missing any solutions.
+	 */
+	if (flags & IDA_FRONTIER) {
+		frontier_build(&memo, cat, fsm, p, bound);
+		proto.memo = &memo;
+
+		if (flags & IDA_VERBOSE)
+			fprintf(stderr, "Stored %zu frontier nodes at depth %zu.\n",
+			    memo.n_nodes, memo.depth);
+	}
+
+	if (ida_checkpoint != NULL) {
+		cpp = &cp;
+		cp.resume = 0;
+		cp.flags = flags;
+		if (clock_gettime(CLOCK_MONOTONIC, &cp.last) != 0) {
+			perror("clock_gettime");
+			cpp = NULL;
+		}
+	}
+
+	if (cpp != NULL && flags & IDA_RESUME) {
+		if (checkpoint_read(&cp.ck, ida_checkpoint) != 0)
+			perror(ida_checkpoint);
+		else if (checkpoint_check(&cp.ck, p, memo.depth,
+		    memo.nodes != NULL ? memo.n_nodes : 1, bound, limit) == 0) {
+			bound = cp.ck.bound;
+			total_expanded = cp.ck.expanded;
+
+			/* a parallel search restarts the iteration */
+			cp.resume = !(flags & IDA_PARALLEL);
+			if (flags & IDA_VERBOSE)
+				fprintf(stderr, "Resuming search from checkpoint %s.\n", ida_checkpoint);
+		}
+	}
+
 	path->pathlen = SEARCH_NO_PATH;
-	for (bound = catalogue_hval(cat, p); n_solution == 0 && bound <= limit; bound += 2) {
+	for (; n_solution == 0 && bound <= limit; bound += 2) {
 		if (flags & IDA_VERBOSE)
 			fprintf(stderr, "Searching for solution with bound %zu\n", bound);
 
-		n_solution = search_to_bound(path, cat, fsm, p, bound, &expanded, on_solved, payload, flags);
+		if (flags & IDA_BIDIRECTIONAL) {
+			if (backward != NULL)
+				perimeter_free(backward);
+
+			backward = perimeter_towards(cat, p, bound,
+			    ida_bidirectional_size, flags & IDA_VERBOSE ? stderr : NULL);
+			if (backward == NULL)
+				perror("perimeter_towards");
+
+			proto.perimeter = backward != NULL ? backward : default_perimeter(cat);
+		}
+
+		if (flags & IDA_PARALLEL)
+			n_solution = search_to_bound_parallel(&proto, p, bound, &expanded);
+		else {
+			if (cpp != NULL) {
+				cp.ck.p = *p;
+				cp.ck.expanded = total_expanded;
+			}
+
+			n_solution = search_to_bound(&proto, p, bound, &expanded, cpp);
+		}
+
 		total_expanded += expanded;
 
+		/* save the beginning of the next iteration */
+		if (cpp != NULL && n_solution == 0 && bound + 2 <= limit) {
+			cp.ck.p = *p;
+			cp.ck.bound = bound + 2;
+			cp.ck.root = memo.depth;
+			cp.ck.node = 0;
+			cp.ck.depth = memo.depth;
+			cp.ck.expanded = total_expanded;
+			cp.ck.round_expanded = 0;
+			cp.ck.pruned = 0;
+			cp.ck.ttcut = 0;
+			if (checkpoint_write(ida_checkpoint, &cp.ck) != 0)
+				perror(ida_checkpoint);
+		}
+
 		if (flags & IDA_VERBOSE)
 			fprintf(stderr, "Expanded %llu nodes during previous round.\n", expanded);
 
@@ -250,7 +1486,7 @@ search_ida_bounded(struct pdb_catalogue *cat, const struct fsm *fsm,
 		if (no_clocks)
 			continue;
 
-		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &round_end) != 0) {
+		if (clock_gettime(clock, &round_end) != 0) {
 			perror("clock_gettime");
 			no_clocks = 1;
 			continue;
@@ -277,6 +1513,13 @@ search_ida_bounded(struct pdb_catalogue *cat, const struct fsm *fsm,
 		    dur, total_expanded / dur);
 	}
 
+	free(memo.nodes);
+	if (backward != NULL)
+		perimeter_free(backward);
+
+	if (cpp != NULL && remove(ida_checkpoint) != 0 && errno != ENOENT)
+		perror(ida_checkpoint);
+
 	if (flags & IDA_VERIFY && !verify(p, path)) {
 		if (flags & IDA_VERBOSE)
 			fprintf(stderr, "Path incorrect!\n");
@@ -297,3 +1540,182 @@ search_ida(struct pdb_catalogue *cat, const struct fsm *fsm,
 {
 	return (search_ida_bounded(cat, fsm, p, SEARCH_PATH_LEN, path, on_solved, payload, flags));
 }
+
+/*
+ * The state of an IDA* search carried out one step at a time with
+ * search_ida_step().  The search tree is searched with dfs from the
+ * root configuration root with partial h values root_ph.
+ */
+struct ida_search {
+	struct dfs dfs;
+	struct puzzle root;
+	struct partial_hvals root_ph;
+	size_t limit;
+};
+
+/*
+ * Continue the search s after a call to dfs_start() or dfs_step() has
+ * returned status.  If the current iteration is done without having
+ * found a solution, start the next one with an increased bound.
+ * Return 1 if the search is still running, 0 if it is done.
+ */
+static int
+ida_search_advance(struct ida_search *s, int status)
+{
+	struct dfs *d = &s->dfs;
+
+	while (status != DFS_RUNNING) {
+		if (status == DFS_STOPPED || d->sst.n_solutions > 0
+		    || d->sst.bound + 2 > s->limit)
+			return (d->running = 0);
+
+		d->sst.bound += 2;
+		status = dfs_start(d, &s->root, &s->root_ph,
+		    fsm_start_state(zero_location(&s->root)), 0);
+	}
+
+	return (d->running = 1);
+}
+
+/*
+ * Prepare an IDA* search for a solution of p like search_ida_bounded()
+ * but do not carry it out.  Instead, the search is advanced node by
+ * node with search_ida_step() and finalized with search_ida_finish().
+ * This allows the caller to interleave multiple searches on the same
+ * thread such that the latency of each search's PDB lookups is hidden
+ * behind the others.  IDA_PARALLEL, IDA_FRONTIER, and IDA_BIDIRECTIONAL
+ * are ignored.  On success, return a pointer to the search state.  On
+ * failure, return NULL and set errno.
+ */
+extern struct ida_search *
+search_ida_start(struct pdb_catalogue *cat, const struct fsm *fsm,
+    const struct puzzle *p, size_t limit, struct path *path,
+    void (*on_solved)(const struct path *, void *), void *payload, int flags)
+{
+	struct ida_search *s;
+	struct search_state *sst;
+
+	s = malloc(sizeof *s);
+	if (s == NULL)
+		return (NULL);
+
+	sst = &s->dfs.sst;
+	sst->cat = cat;
+	sst->fsm = fsm;
+	sst->path = path;
+	sst->expanded = 0;
+	sst->pruned = 0;
+	sst->ttcut = 0;
+	sst->n_solutions = 0;
+	sst->flags = flags & ~(IDA_PARALLEL | IDA_FRONTIER | IDA_BIDIRECTIONAL);
+	sst->on_solved = on_solved;
+	sst->on_solved_payload = payload;
+	sst->perimeter = default_perimeter(cat);
+	sst->memo = NULL;
+	sst->par = NULL;
+	sst->frontier_depth = SIZE_MAX;
+
+	s->root = *p;
+	s->limit = limit;
+	catalogue_partial_hvals(&s->root_ph, cat, p);
+	sst->bound = catalogue_ph_hval(cat, &s->root_ph);
+
+	path->pathlen = SEARCH_NO_PATH;
+	if (sst->bound > limit)
+		s->dfs.running = 0;
+	else
+		ida_search_advance(s, dfs_start(&s->dfs, &s->root, &s->root_ph,
+		    fsm_start_state(zero_location(&s->root)), 0));
+
+	return (s);
+}
+
+/*
+ * Advance the search s by one node.  Return 1 if the search is still
+ * running, 0 once it is done.
+ */
+extern int
+search_ida_step(struct ida_search *s)
+{
+	if (!s->dfs.running)
+		return (0);
+
+	return (ida_search_advance(s, dfs_step(&s->dfs, 1)));
+}
+
+/*
+ * Release the search s and return the number of nodes it expanded.
+ * The path found is in the path given to search_ida_start().
+ */
+extern unsigned long long
+search_ida_finish(struct ida_search *s)
+{
+	unsigned long long expanded = s->dfs.sst.expanded;
+
+	if (s->dfs.sst.flags & IDA_VERIFY && !verify(&s->root, s->dfs.sst.path)) {
+		if (s->dfs.sst.flags & IDA_VERBOSE)
+			fprintf(stderr, "Path incorrect!\n");
+
+		abort();
+	}
+
+	free(s);
+
+	return (expanded);
+}
+
+/*
+ * Save the state of the search s to the file named filename so it can
+ * be continued with search_ida_load() later on.  The file is replaced
+ * atomically.  As solutions are not saved, s cannot be saved once it
+ * has found a solution.  Return 0 on success, -1 on error with errno
+ * set.
+ */
+extern int
+search_ida_save(const struct ida_search *s, const char *filename)
+{
+	struct checkpoint ck;
+
+	if (!s->dfs.running || s->dfs.sst.n_solutions > 0) {
+		errno = EINVAL;
+		return (-1);
+	}
+
+	ck.p = s->root;
+	ck.expanded = 0;
+	checkpoint_save(&ck, &s->dfs, 0);
+
+	return (checkpoint_write(filename, &ck));
+}
+
+/*
+ * Continue the search s, which has just been started with
+ * search_ida_start(), from the state saved to the file named filename
+ * with search_ida_save().  Return 0 on success, -1 on error with errno
+ * set.  On error, s is left unchanged.
+ */
+extern int
+search_ida_load(struct ida_search *s, const char *filename)
+{
+	struct checkpoint ck;
+	struct dfs *d = &s->dfs;
+	size_t bound;
+
+	if (checkpoint_read(&ck, filename) != 0)
+		return (-1);
+
+	bound = catalogue_ph_hval(d->sst.cat, &s->root_ph);
+	if (checkpoint_check(&ck, &s->root, 0, 1, bound, s->limit) != 0) {
+		errno = EINVAL;
+		return (-1);
+	}
+
+	d->sst.bound = ck.bound;
+	d->sst.n_solutions = 0;
+	d->sst.path->pathlen = SEARCH_NO_PATH;
+	ida_search_advance(s, dfs_restore(d, &ck, &s->root, &s->root_ph,
+	    fsm_start_state(zero_location(&s->root)), 0));
+	d->sst.expanded += ck.expanded;
+
+	return (0);
+}
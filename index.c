@@ -42,6 +42,7 @@
 #include "builtins.h"
 #include "tileset.h"
 #include "index.h"
+#include "isa.h"
 #include "puzzle.h"
 
 /*
@@ -105,16 +106,43 @@ index_permutation(tileset ts, tileset map, const struct puzzle *p)
 	return (pidx);
 }
 
+#if HAS_DISPATCH == 1
+/*
+ * A variant of index_permutation() for CPUs with BMI2.  The masks of
+ * the squares below each tile are computed with bzhi instead of a
+ * shift and a subtraction and the inversion counts are weighted with
+ * aux->pfactors so the multiplications do not depend on each other.
+ * The only dependency chain left is the removal of squares from map.
+ */
+static inline TARGET_AVX2 permindex
+index_permutation_bmi2(const struct index_aux *aux, tileset ts, tileset map,
+    const struct puzzle *p)
+{
+	permindex pidx = 0;
+	size_t i;
+	unsigned least;
+
+	for (i = 0; !tileset_empty(ts); i++, ts = tileset_remove_least(ts)) {
+		least = p->tiles[tileset_get_least(ts)];
+		pidx += aux->pfactors[i] * popcount(_bzhi_u32(map, least));
+		map = _andn_u32(1u << least, map);
+	}
+
+	return (pidx);
+}
+#endif /* HAS_DISPATCH == 1 */
+
 /*
  * Compute the structured index for the equivalence class of p by the
  * tiles selected by aux->ts and store it in idx.  Use aux to lookup
- * other bits and pieces if needed.  See index.h for details on the
- * algorithm.
+ * other bits and pieces if needed.  map is the tile map of p as
+ * computed by tile_map().  See index.h for details on the algorithm.
  */
-extern void
-compute_index(const struct index_aux *aux, struct index *idx, const struct puzzle *p)
+static inline void
+compute_index_map(const struct index_aux *aux, struct index *idx,
+    const struct puzzle *p, tileset map)
 {
-	tileset tsnz = tileset_remove(aux->ts, ZERO_TILE), map = tile_map(aux, p);
+	tileset tsnz = tileset_remove(aux->ts, ZERO_TILE);
 
 	idx->maprank = tileset_rank(map);
 	prefetch(aux->idxt + idx->maprank);
@@ -124,7 +152,109 @@ compute_index(const struct index_aux *aux, struct index *idx, const struct puzzl
 		idx->eqidx = aux->idxt[idx->maprank].eqclasses[zero_location(p)];
 	else
 		idx->eqidx = -1; /* mark as invalid */
+
+	idx->map = map;
+}
+
+/*
+ * The variants of compute_index() for the instruction set extension
+ * levels.  compute_index_map() is inlined into each of them so the
+ * popcounts in index_permutation() use the best instruction available.
+ */
+static void
+compute_index_generic(const struct index_aux *aux, struct index *idx, const struct puzzle *p)
+{
+	compute_index_map(aux, idx, p, tile_map_generic(aux, p));
+}
+
+#if HAS_DISPATCH == 1
+static TARGET_SSE42 void
+compute_index_sse42(const struct index_aux *aux, struct index *idx, const struct puzzle *p)
+{
+	compute_index_map(aux, idx, p, tile_map_sse42(aux, p));
+}
+
+/*
+ * Like compute_index_map(), but rank the permutation with
+ * index_permutation_bmi2().
+ */
+static TARGET_AVX2 void
+compute_index_avx2(const struct index_aux *aux, struct index *idx, const struct puzzle *p)
+{
+	tileset map = tile_map_avx2(aux, p);
+
+	idx->maprank = tileset_rank(map);
+	prefetch(aux->idxt + idx->maprank);
+	idx->pidx = index_permutation_bmi2(aux, tileset_remove(aux->ts, ZERO_TILE), map, p);
+
+	if (tileset_has(aux->ts, ZERO_TILE))
+		idx->eqidx = aux->idxt[idx->maprank].eqclasses[zero_location(p)];
+	else
+		idx->eqidx = -1; /* mark as invalid */
+
+	idx->map = map;
+}
+#endif /* HAS_DISPATCH == 1 */
+
+/*
+ * Update idx, the index of a configuration adjacent to p by moving
+ * tile, to be the index of p.  idx->map must have been set by
+ * compute_index() or compute_index_diff().  Moving tile changes the
+ * inversion counts only for the pairs of tile and the tiles between
+ * its old and its new location, of which there are none for a
+ * horizontal move and at most four for a vertical one.  So instead of
+ * computing the permutation index from scratch, these pairs are
+ * accounted for.  If tile is not in aux->ts, the index does not change.
+ */
+static inline void
+compute_index_diff_body(const struct index_aux *aux, struct index *idx,
+    const struct puzzle *p, unsigned tile)
+{
+	tileset tsnz = tileset_remove(aux->ts, ZERO_TILE), between;
+	unsigned from = zero_location(p), to = p->tiles[tile], k, m;
+
+	if (!tileset_has(tsnz, tile))
+		return;
+
+	k = tileset_count(tileset_intersect(tsnz, tileset_least(tile)));
+	if (from < to)
+		between = tileset_difference(tileset_least(to), tileset_least(from + 1));
+	else
+		between = tileset_difference(tileset_least(from), tileset_least(to + 1));
+
+	/* tiles jumped over from left to right or right to left */
+	for (between = tileset_intersect(between, idx->map); !tileset_empty(between);
+	    between = tileset_remove_least(between)) {
+		m = tileset_count(tileset_intersect(tsnz,
+		    tileset_least(p->grid[tileset_get_least(between)])));
+		if ((m > k) == (from < to))
+			idx->pidx += aux->pfactors[m > k ? k : m];
+		else
+			idx->pidx -= aux->pfactors[m > k ? k : m];
+	}
+
+	idx->map = tileset_add(tileset_remove(idx->map, from), to);
+	idx->maprank = tileset_rank(idx->map);
+
+	if (tileset_has(aux->ts, ZERO_TILE))
+		idx->eqidx = aux->idxt[idx->maprank].eqclasses[from];
+}
+
+static void
+compute_index_diff_generic(const struct index_aux *aux, struct index *idx,
+    const struct puzzle *p, unsigned tile)
+{
+	compute_index_diff_body(aux, idx, p, tile);
+}
+
+#if HAS_DISPATCH == 1
+static TARGET_SSE42 void
+compute_index_diff_sse42(const struct index_aux *aux, struct index *idx,
+    const struct puzzle *p, unsigned tile)
+{
+	compute_index_diff_body(aux, idx, p, tile);
 }
+#endif /* HAS_DISPATCH == 1 */
 
 /*
  * Given a tileset ts and a map m, fill in all tiles not in ts into the
@@ -169,6 +299,50 @@ unindex_permutation(struct puzzle *p, tileset ts, tileset map, permindex pidx)
 	}
 }
 
+#if HAS_DISPATCH == 1
+/*
+ * For each divisor d, ceil(2^64 / d), used to divide by d with a
+ * multiplication in unindex_permutation_bmi2().  See Lemire, Kaser,
+ * Kurz: Faster Remainder by Direct Computation (2019).  The entry for
+ * d = 1 wraps around to 0, giving the correct remainder 0 but a wrong
+ * quotient, which is never used as 1 is the last divisor.
+ */
+#define RECIPROCAL(d) (0xffffffffffffffffull / (d) + 1)
+static const unsigned long long reciprocals[INDEX_MAX_TILES + 1] = {
+	0,
+	RECIPROCAL(1), RECIPROCAL(2), RECIPROCAL(3), RECIPROCAL(4),
+	RECIPROCAL(5), RECIPROCAL(6), RECIPROCAL(7), RECIPROCAL(8),
+	RECIPROCAL(9), RECIPROCAL(10), RECIPROCAL(11), RECIPROCAL(12),
+};
+#undef RECIPROCAL
+
+/*
+ * A variant of unindex_permutation() for CPUs with BMI2.  The digits
+ * of pidx are extracted with multiplications by reciprocals instead of
+ * divisions and the squares are selected with pdep.
+ */
+static inline TARGET_AVX2 void
+unindex_permutation_bmi2(struct puzzle *p, tileset ts, tileset map, permindex pidx)
+{
+	unsigned long long frac;
+	size_t i;
+	permindex cmp, n_tiles;
+	tileset tile;
+
+	for (n_tiles = tileset_count(ts); n_tiles > 0; n_tiles--) {
+		frac = reciprocals[n_tiles] * pidx;
+		cmp = (unsigned __int128)frac * n_tiles >> 64;
+		pidx = (unsigned __int128)reciprocals[n_tiles] * pidx >> 64;
+		i = tileset_get_least(ts);
+		ts = tileset_remove_least(ts);
+		tile = _pdep_u32(1u << cmp, map);
+		p->tiles[i] = tileset_get_least(tile);
+		map = tileset_difference(map, tile);
+		p->grid[p->tiles[i]] = i;
+	}
+}
+#endif /* HAS_DISPATCH == 1 */
+
 /*
  * Half of the work of inverting an index depends on the map only.  This
  * function does this first part only to speed up index inversion for
@@ -191,8 +365,8 @@ invert_index_map(const struct index_aux *aux, struct puzzle *p, const struct ind
  * an index within the same cohort as idx, but it is okay to arbitrarily
  * permute tiles not in aux->ts including the zero tile.
  */
-extern void
-invert_index_rest(const struct index_aux *aux, struct puzzle *p, const struct index *idx)
+static void
+invert_index_rest_generic(const struct index_aux *aux, struct puzzle *p, const struct index *idx)
 {
 	tileset tsnz = tileset_remove(aux->ts, ZERO_TILE);
 	tileset map = tileset_unrank(tileset_count(tsnz), idx->maprank);
@@ -204,6 +378,21 @@ invert_index_rest(const struct index_aux *aux, struct puzzle *p, const struct in
 		move(p, canonical_zero_location(aux, idx));
 }
 
+#if HAS_DISPATCH == 1
+static TARGET_AVX2 void
+invert_index_rest_bmi2(const struct index_aux *aux, struct puzzle *p, const struct index *idx)
+{
+	tileset tsnz = tileset_remove(aux->ts, ZERO_TILE);
+	tileset map = tileset_unrank(tileset_count(tsnz), idx->maprank);
+
+	prefetch(aux->idxt + idx->maprank);
+	unindex_permutation_bmi2(p, tsnz, map, idx->pidx);
+
+	if (tileset_has(aux->ts, ZERO_TILE))
+		move(p, canonical_zero_location(aux, idx));
+}
+#endif /* HAS_DISPATCH == 1 */
+
 /*
  * Given a structured index idx for some partial puzzle configuration
  * with tiles selected by ts, compute a representant of the
@@ -273,11 +462,16 @@ make_index_aux(struct index_aux *aux, tileset ts)
 	aux->n_perm = factorials[aux->n_tile];
 	aux->solved_parity = tileset_parity(tsnz);
 
+	/* see index_permutation() */
+	aux->pfactors[0] = 1;
+	for (i = 1; i < aux->n_tile; i++)
+		aux->pfactors[i] = aux->pfactors[i - 1] * (aux->n_tile - i + 1);
+
 	tileset_unrank_init(aux->n_tile);
 
 	/* see puzzle_partially_equal() for details */
 	for (i = 0; i < sizeof aux->tsmask; i++)
-		aux->tsmask[i] = tsnz & (1 << i) ? -1 : 0;
+		aux->tsmask[i] = tileset_has(tsnz, i) ? -1 : 0;
 
 	/* see tileset_map() for details */
 	memset(aux->tiles, 0, sizeof aux->tiles);
@@ -287,27 +481,56 @@ make_index_aux(struct index_aux *aux, tileset ts)
 	aux->idxt = make_index_table(aux->ts);
 }
 
+/*
+ * Check if puzzle configurations a and b agree in the location of the
+ * zero tile region if aux->ts accounts for the zero tile.  This is the
+ * second half of puzzle_partially_equal().
+ */
+static inline int
+zero_regions_equal(const struct puzzle *a, const struct puzzle *b,
+    const struct index_aux *aux, tileset map)
+{
+	const signed char *eqclasses;
+
+	if (!tileset_has(aux->ts, ZERO_TILE))
+		return (1);
+
+	/*
+	 * if we care about the zero tile, make sure both puzzles
+	 * have the same zero tile region.
+	 */
+	eqclasses = aux->idxt[tileset_rank(map)].eqclasses;
+
+	return (eqclasses[zero_location(a)] == eqclasses[zero_location(b)]);
+}
+
 /*
  * Check if puzzle configurations a and b are equal with respect to the
  * tiles specified in aux->ts.  Return nonzero if they are, zero
  * otherwise.
  */
-extern int
-puzzle_partially_equal(const struct puzzle *a, const struct puzzle *b,
+static int
+puzzle_partially_equal_generic(const struct puzzle *a, const struct puzzle *b,
     const struct index_aux *aux)
 {
-	const signed char *eqclasses;
+	size_t i;
+	tileset tsnz = tileset_remove(aux->ts, ZERO_TILE);
 
-#ifdef __AVX2__
-	__m256i atiles = _mm256_loadu_si256((const __m256i*)a->tiles);
-	__m256i btiles = _mm256_loadu_si256((const __m256i*)b->tiles);
-	__m256i tsmask = _mm256_loadu_si256((const __m256i*)aux->tsmask);
+	for (; !tileset_empty(tsnz); tsnz = tileset_remove_least(tsnz)) {
+		i = tileset_get_least(tsnz);
+		if (a->tiles[i] != b->tiles[i])
+			return (0);
+	}
 
-	if (!_mm256_testc_si256(_mm256_cmpeq_epi8(atiles, btiles), tsmask))
-		return (0);
-#elif defined(__SSE4_1__)
-	/* same algorithm as the AVX2 version, but with 128 bit registers */
+	return (zero_regions_equal(a, b, aux, tile_map_generic(aux, a)));
+}
 
+#if HAS_DISPATCH == 1
+/* same algorithm as the AVX2 version, but with 128 bit registers */
+static TARGET_SSE42 int
+puzzle_partially_equal_sse42(const struct puzzle *a, const struct puzzle *b,
+    const struct index_aux *aux)
+{
 	__m128i atileslo = _mm_loadu_si128((const __m128i*)a->tiles + 0);
 	__m128i atileshi = _mm_loadu_si128((const __m128i*)a->tiles + 1);
 	__m128i btileslo = _mm_loadu_si128((const __m128i*)b->tiles + 0);
@@ -321,28 +544,82 @@ puzzle_partially_equal(const struct puzzle *a, const struct puzzle *b,
 
 	if (!_mm_testz_si128(uneq, uneq))
 		return (0);
-#else
-	size_t i;
-	tileset tsnz = tileset_remove(aux->ts, ZERO_TILE);
 
-	for (; !tileset_empty(tsnz); tsnz = tileset_remove_least(tsnz)) {
-		i = tileset_get_least(tsnz);
-		if (a->tiles[i] != b->tiles[i])
-			return (0);
-	}
-#endif
-	if (!tileset_has(aux->ts, ZERO_TILE))
-		return (1);
+	return (zero_regions_equal(a, b, aux, tile_map_sse42(aux, a)));
+}
 
-	/*
-	 * if we care about the zero tile, make sure both puzzles
-	 * have the same zero tile region.
-	 */
-	eqclasses = aux->idxt[tileset_rank(tile_map(aux, a))].eqclasses;
+static TARGET_AVX2 int
+puzzle_partially_equal_avx2(const struct puzzle *a, const struct puzzle *b,
+    const struct index_aux *aux)
+{
+	__m256i atiles = _mm256_loadu_si256((const __m256i*)a->tiles);
+	__m256i btiles = _mm256_loadu_si256((const __m256i*)b->tiles);
+	__m256i tsmask = _mm256_loadu_si256((const __m256i*)aux->tsmask);
 
-	return (eqclasses[zero_location(a)] == eqclasses[zero_location(b)]);
+	if (!_mm256_testc_si256(_mm256_cmpeq_epi8(atiles, btiles), tsmask))
+		return (0);
+
+	return (zero_regions_equal(a, b, aux, tile_map_avx2(aux, a)));
 }
+#endif /* HAS_DISPATCH == 1 */
+
+void (*compute_index)(const struct index_aux *, struct index *, const struct puzzle *)
+    = compute_index_generic;
+void (*compute_index_diff)(const struct index_aux *, struct index *, const struct puzzle *, unsigned)
+    = compute_index_diff_generic;
+int (*puzzle_partially_equal)(const struct puzzle *, const struct puzzle *, const struct index_aux *)
+    = puzzle_partially_equal_generic;
+tileset (*tile_map)(const struct index_aux *, const struct puzzle *) = tile_map_generic;
+void (*invert_index_rest)(const struct index_aux *, struct puzzle *, const struct index *)
+    = invert_index_rest_generic;
 
+/*
+ * Switch compute_index(), compute_index_diff(), puzzle_partially_equal(),
+ * tile_map(), and invert_index_rest() to the variants for instruction
+ * set extension level isa.  This is called by isa_select().
+ */
+extern void
+index_dispatch(int isa)
+{
+	switch (isa) {
+#if HAS_DISPATCH == 1
+	case ISA_AVX512:
+	case ISA_AVX2:
+		compute_index = compute_index_avx2;
+		compute_index_diff = compute_index_diff_sse42;
+		puzzle_partially_equal = puzzle_partially_equal_avx2;
+		tile_map = tile_map_avx2;
+		invert_index_rest = invert_index_rest_bmi2;
+		break;
+
+	case ISA_SSE42:
+		compute_index = compute_index_sse42;
+		compute_index_diff = compute_index_diff_sse42;
+		puzzle_partially_equal = puzzle_partially_equal_sse42;
+		tile_map = tile_map_sse42;
+		invert_index_rest = invert_index_rest_generic;
+		break;
+#endif /* HAS_DISPATCH == 1 */
+
+	default:
+		compute_index = compute_index_generic;
+		compute_index_diff = compute_index_diff_generic;
+		puzzle_partially_equal = puzzle_partially_equal_generic;
+		tile_map = tile_map_generic;
+		invert_index_rest = invert_index_rest_generic;
+		break;
+	}
+}
+
+/*
+ * Select the index functions on startup.  This lives here rather than
+ * in isa.c so it is linked into every program computing indices.
+ */
+static void __attribute__((constructor))
+index_init(void)
+{
+	isa_init();
+}
 
 /*
  * Describe idx as a string and write the result to str.  Only the tiles
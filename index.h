@@ -33,6 +33,7 @@
 #include <stdalign.h>
 #include <stdatomic.h>
 
+#include "isa.h"
 #include "puzzle.h"
 #include "tileset.h"
 
@@ -66,6 +67,7 @@ struct index {
 	permindex pidx;
 	tsrank maprank;
 	int eqidx;
+	tileset map; /* only set by compute_index() and compute_index_diff() */
 };
 
 /*
@@ -88,6 +90,14 @@ struct index_table {
 	unsigned offset;
 };
 
+enum {
+	/* maximal number of nonzero tiles in partial index */
+	INDEX_MAX_TILES = 12,
+
+	/* buffer length for index_string() */
+	INDEX_STR_LEN = 27, /* (########## ########## ##)\0 */
+};
+
 /*
  * For the indexing and unindexing operations we use this auxillary
  * structure.  It contains everything we need to quickly compute and
@@ -102,37 +112,41 @@ struct index_aux {
 	unsigned n_maprank; /* number of different maprank values */
 	unsigned n_perm; /* number of permutations */
 	unsigned solved_parity; /* parity of the solved configuration */
+	permindex pfactors[INDEX_MAX_TILES]; /* weight of each tile's inversion count in pidx */
 
 	tileset ts;
 	struct index_table *idxt;
 };
 
-enum {
-	/* maximal number of nonzero tiles in partial index */
-	INDEX_MAX_TILES = 12,
-
-	/* buffer length for index_string() */
-	INDEX_STR_LEN = 27, /* (########## ########## ##)\0 */
-};
-
-extern void	compute_index(const struct index_aux*, struct index*, const struct puzzle*);
 extern void	invert_index(const struct index_aux*, struct puzzle*, const struct index*);
 extern void	invert_index_map(const struct index_aux*, struct puzzle*, const struct index*);
-extern void	invert_index_rest(const struct index_aux*, struct puzzle*, const struct index*);
 extern void	index_string(tileset, char[INDEX_STR_LEN], const struct index*);
 extern void	make_index_aux(struct index_aux*, tileset);
-extern int	puzzle_partially_equal(const struct puzzle *, const struct puzzle *, const struct index_aux *);
 
-/* vectorised functions from index_avx512.c */
-enum { VECTORWIDTH = 16 };
-extern void	compute_index_16a6(permindex[restrict 16], tsrank[restrict 16],
+/*
+ * The following functions are selected at runtime according to the
+ * instruction set extensions the CPU supports, see isa.h.
+ */
+extern void	(*compute_index)(const struct index_aux*, struct index*, const struct puzzle*);
+extern void	(*compute_index_diff)(const struct index_aux*, struct index*, const struct puzzle*, unsigned);
+extern int	(*puzzle_partially_equal)(const struct puzzle *, const struct puzzle *, const struct index_aux *);
+extern tileset	(*tile_map)(const struct index_aux *, const struct puzzle *);
+extern void	(*invert_index_rest)(const struct index_aux*, struct puzzle*, const struct index*);
+extern void	index_dispatch(int);
+
+/* vectorised functions from indexvec.c for PDBs of six nonzero tiles */
+enum { VECTORWIDTH = 16, A6_PERMUTATIONS = 720 };
+extern void	(*compute_index_16a6)(permindex[restrict 16], tsrank[restrict 16],
     const struct puzzle *, const tileset[restrict 16]);
-extern void	pdb_lookup_16a6(int[restrict 16], const permindex[restrict 16],
+extern void	(*pdb_lookup_16a6)(int[restrict 16], const permindex[restrict 16],
     const tsrank[restrict 16], const atomic_uchar *restrict[restrict 16]);
-extern void	compute_index_8a6(permindex[restrict 8], tsrank[restrict 8],
+extern void	(*compute_index_8a6)(permindex[restrict 8], tsrank[restrict 8],
     const struct puzzle *, const tileset[restrict 8]);
-extern void	pdb_lookup_8a6(int[restrict 8], const permindex[restrict 8],
+extern void	(*pdb_lookup_8a6)(int[restrict 8], const permindex[restrict 8],
     const tsrank[restrict 8], const atomic_uchar *restrict[restrict 8]);
+extern void	(*eqclass_offsets_16a6)(tsrank[restrict 16], const struct index_table *, unsigned);
+extern void	(*eqclass_offsets_8a6)(tsrank[restrict 8], const struct index_table *, unsigned);
+extern void	indexvec_dispatch(int);
 
 extern const unsigned factorials[INDEX_MAX_TILES + 1];
 
@@ -237,59 +251,68 @@ eqclass_from_index(const struct index_aux *aux, const struct index *idx)
 
 /*
  * Return a tileset specifying which grid locations in p are occupied by
- * nonzero tiles in aux->ts.
+ * nonzero tiles in aux->ts.  This is the generic variant of tile_map(),
+ * code that knows the instruction set extension level can call the
+ * variants for that level directly.
  */
 static inline tileset
-tile_map(const struct index_aux *aux, const struct puzzle *p)
+tile_map_generic(const struct index_aux *aux, const struct puzzle *p)
+{
+	tileset tsnz = tileset_remove(aux->ts, ZERO_TILE), map = EMPTY_TILESET;
+
+	for (; !tileset_empty(tsnz); tsnz = tileset_remove_least(tsnz))
+		map |= 1 << p->tiles[tileset_get_least(tsnz)];
+
+	return (map);
+}
+
+#if HAS_DISPATCH == 1
+/*
+ * This code is very similar to the AVX2 code except for the more
+ * complex masking in the beginning due to the lack of 256 bit
+ * registers.
+ */
+static inline TARGET_SSE42 tileset
+tile_map_sse42(const struct index_aux *aux, const struct puzzle *p)
 {
-#ifdef __AVX2__
 	/* load complemented tiles */
 	__m128i tiles = _mm_loadu_si128((const __m128i*)aux->tiles);
 
 	/* load grid and complement to circumvent pcmpistri's string termination check */
-	__m256i grid = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i*)p->grid),
-	    _mm256_set_epi64x(0xffull, -1ull, -1ull, -1ull));
+	__m128i gridmask = _mm_set1_epi8(0xff);
+	__m128i gridlo = _mm_andnot_si128(_mm_loadu_si128((const __m128i*)p->grid + 0), gridmask);
 
 	/* compute the bitmasks */
 #define OPERATION (_SIDD_UBYTE_OPS|_SIDD_CMP_EQUAL_ANY|_SIDD_BIT_MASK)
-	__m128i maplo = _mm_cmpistrm(tiles, _mm256_castsi256_si128(grid), OPERATION);
-	__m128i maphi = _mm_cmpistrm(tiles, _mm256_extracti128_si256(grid, 1), OPERATION);
+	__m128i maplo = _mm_cmpistrm(tiles, gridlo, OPERATION);
+	__m128i gridhi = _mm_andnot_si128(_mm_loadu_si128((const __m128i*)p->grid + 1), _mm_bsrli_si128(gridmask, 7));
+	__m128i maphi = _mm_cmpistrm(tiles, gridhi, OPERATION);
 	maplo = _mm_unpacklo_epi16(maplo, maphi);
 #undef OPERATION
 
 	return (_mm_cvtsi128_si32(maplo));
-#elif defined(__SSE4_2__)
-	/*
-	 * this code is very similar to the AVX code except for the more
-	 * complex masking in the beginning due to the lack of 256 bit
-	 * registers.
-	 */
+}
 
+static inline TARGET_AVX2 tileset
+tile_map_avx2(const struct index_aux *aux, const struct puzzle *p)
+{
 	/* load complemented tiles */
 	__m128i tiles = _mm_loadu_si128((const __m128i*)aux->tiles);
 
 	/* load grid and complement to circumvent pcmpistri's string termination check */
-	__m128i gridmask = _mm_set1_epi8(0xff);
-	__m128i gridlo = _mm_andnot_si128(_mm_loadu_si128((const __m128i*)p->grid + 0), gridmask);
+	__m256i grid = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i*)p->grid),
+	    _mm256_set_epi64x(0xffull, -1ull, -1ull, -1ull));
 
 	/* compute the bitmasks */
 #define OPERATION (_SIDD_UBYTE_OPS|_SIDD_CMP_EQUAL_ANY|_SIDD_BIT_MASK)
-	__m128i maplo = _mm_cmpistrm(tiles, gridlo, OPERATION);
-	__m128i gridhi = _mm_andnot_si128(_mm_loadu_si128((const __m128i*)p->grid + 1), _mm_bsrli_si128(gridmask, 7));
-	__m128i maphi = _mm_cmpistrm(tiles, gridhi, OPERATION);
+	__m128i maplo = _mm_cmpistrm(tiles, _mm256_castsi256_si128(grid), OPERATION);
+	__m128i maphi = _mm_cmpistrm(tiles, _mm256_extracti128_si256(grid, 1), OPERATION);
 	maplo = _mm_unpacklo_epi16(maplo, maphi);
 #undef OPERATION
 
 	return (_mm_cvtsi128_si32(maplo));
-#else
-	tileset tsnz = tileset_remove(aux->ts, ZERO_TILE), map = EMPTY_TILESET;
-
-	for (; !tileset_empty(tsnz); tsnz = tileset_remove_least(tsnz))
-		map |= 1 << p->tiles[tileset_get_least(tsnz)];
-
-	return (map);
-#endif
 }
+#endif /* HAS_DISPATCH == 1 */
 
 /*
  * Return the grid location in which we want to place the zero tile
@@ -0,0 +1,478 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* indexvec.c -- compute the indices of many PDBs at once */
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#ifdef __SSE__
+# include <immintrin.h>
+#endif
+
+#include "builtins.h"
+#include "index.h"
+#include "isa.h"
+#include "puzzle.h"
+#include "tileset.h"
+
+/*
+ * The functions in this file compute the indices of and look up the
+ * entries for a puzzle configuration in up to 16 (or 8) PDBs at once,
+ * one PDB per SIMD lane.  Each PDB must have exactly six tiles and must
+ * not account for the zero tile (hence the a6 in the names).  For such
+ * a PDB, the index is fully described by the map rank and the
+ * permutation index; the offset of an entry is maprank * 720 + pidx.
+ *
+ * Given the tiles t[0] < ... < t[5] of a tile set and their locations
+ * q[k] = p->tiles[t[k]], let r[k] be the number of tiles whose
+ * location is lower than q[k] and c[k] the number of tiles t[m] with
+ * m > k whose location is lower than q[k].  Then the map rank is the
+ * sum of (q[k] choose r[k] + 1), see tileset_rank(), and the
+ * permutation index is the sum of c[k] * 6! / (6 - k)!, see
+ * index_permutation() in index.c.  Both are computed from pairwise
+ * comparisons of the locations which vectorises nicely.
+ *
+ * PDBs that do account for the zero tile can be looked up, too, by
+ * turning the map ranks into map offsets with eqclass_offsets_16a6()
+ * or eqclass_offsets_8a6() first.  All PDBs of six nonzero tiles share
+ * the same index table, see make_index_aux().
+ *
+ * Each function comes in a generic, an AVX2, and possibly an AVX-512
+ * variant.  indexvec_dispatch() selects the variants to use.
+ */
+
+enum { A6_TILES = 6 };
+
+/*
+ * binomials[n][k] is (n choose k).
+ */
+static alignas(64) const unsigned binomials[TILE_COUNT][8] = {
+	{      1,      0,      0,      0,      0,      0,      0,      0 },
+	{      1,      1,      0,      0,      0,      0,      0,      0 },
+	{      1,      2,      1,      0,      0,      0,      0,      0 },
+	{      1,      3,      3,      1,      0,      0,      0,      0 },
+	{      1,      4,      6,      4,      1,      0,      0,      0 },
+	{      1,      5,     10,     10,      5,      1,      0,      0 },
+	{      1,      6,     15,     20,     15,      6,      1,      0 },
+	{      1,      7,     21,     35,     35,     21,      7,      1 },
+	{      1,      8,     28,     56,     70,     56,     28,      8 },
+	{      1,      9,     36,     84,    126,    126,     84,     36 },
+	{      1,     10,     45,    120,    210,    252,    210,    120 },
+	{      1,     11,     55,    165,    330,    462,    462,    330 },
+	{      1,     12,     66,    220,    495,    792,    924,    792 },
+	{      1,     13,     78,    286,    715,   1287,   1716,   1716 },
+	{      1,     14,     91,    364,   1001,   2002,   3003,   3432 },
+	{      1,     15,    105,    455,   1365,   3003,   5005,   6435 },
+	{      1,     16,    120,    560,   1820,   4368,   8008,  11440 },
+	{      1,     17,    136,    680,   2380,   6188,  12376,  19448 },
+	{      1,     18,    153,    816,   3060,   8568,  18564,  31824 },
+	{      1,     19,    171,    969,   3876,  11628,  27132,  50388 },
+	{      1,     20,    190,   1140,   4845,  15504,  38760,  77520 },
+	{      1,     21,    210,   1330,   5985,  20349,  54264, 116280 },
+	{      1,     22,    231,   1540,   7315,  26334,  74613, 170544 },
+	{      1,     23,    253,   1771,   8855,  33649, 100947, 245157 },
+	{      1,     24,    276,   2024,  10626,  42504, 134596, 346104 },
+};
+
+/* the factors by which c[k] is multiplied in the permutation index */
+static const unsigned a6_factors[A6_TILES] = { 1, 6, 30, 120, 360, 720 };
+
+/*
+ * Compute the index of p with respect to the six tile set ts without
+ * the zero tile, one tile set at a time.
+ */
+static void
+compute_index_a6(permindex *pidx, tsrank *maprank, const struct puzzle *p, tileset ts)
+{
+	size_t k, m, n;
+	unsigned q[A6_TILES], c, r;
+
+	for (n = 0; !tileset_empty(ts); ts = tileset_remove_least(ts))
+		q[n++] = p->tiles[tileset_get_least(ts)];
+
+	*pidx = 0;
+	*maprank = 0;
+	for (k = 0; k < A6_TILES; k++) {
+		c = 0;
+		r = 0;
+		for (m = 0; m < A6_TILES; m++)
+			if (q[m] < q[k]) {
+				r++;
+				c += m > k;
+			}
+
+		*pidx += c * a6_factors[k];
+		*maprank += binomials[q[k]][r + 1];
+	}
+}
+
+static void
+compute_index_8a6_generic(permindex pidx[restrict 8], tsrank maprank[restrict 8],
+    const struct puzzle *p, const tileset ts[restrict 8])
+{
+	size_t i;
+
+	for (i = 0; i < 8; i++)
+		compute_index_a6(pidx + i, maprank + i, p, ts[i]);
+}
+
+static void
+pdb_lookup_8a6_generic(int h[restrict 8], const permindex pidx[restrict 8],
+    const tsrank maprank[restrict 8], const atomic_uchar *restrict tables[restrict 8])
+{
+	size_t i;
+
+	for (i = 0; i < 8; i++)
+		h[i] = tables[i][(size_t)maprank[i] * A6_PERMUTATIONS + pidx[i]];
+}
+
+static void
+eqclass_offsets_8a6_generic(tsrank maprank[restrict 8], const struct index_table *idxt,
+    unsigned zloc)
+{
+	size_t i;
+
+	for (i = 0; i < 8; i++)
+		maprank[i] = idxt[maprank[i]].offset + idxt[maprank[i]].eqclasses[zloc];
+}
+
+#if HAS_DISPATCH == 1
+/*
+ * Given the tiles of eight tile sets in ts, remove the least tile from
+ * each and return its number.  The number is found as the exponent of
+ * the float the isolated least bit converts to.
+ */
+static inline TARGET_AVX2 __m256i
+least_tile_8(__m256i *ts)
+{
+	__m256i low = _mm256_and_si256(*ts, _mm256_sub_epi32(_mm256_setzero_si256(), *ts));
+
+	*ts = _mm256_xor_si256(*ts, low);
+
+	return (_mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(low)), 23),
+	    _mm256_set1_epi32(127)));
+}
+
+/*
+ * Compute the index (permutation index and map rank) of p with respect
+ * to the eight tile sets in ts.  Each tile set must contain exactly
+ * six tiles and must not contain the zero tile.
+ */
+static TARGET_AVX2 void
+compute_index_8a6_avx2(permindex pidx[restrict 8], tsrank maprank[restrict 8],
+    const struct puzzle *p, const tileset ts[restrict 8])
+{
+	__m256i tsv = _mm256_loadu_si256((const __m256i *)ts), lt;
+	__m256i q[A6_TILES], c[A6_TILES], r[A6_TILES], pi, mr;
+	size_t k, m;
+
+	/* the gathers overshoot p->tiles into p->grid, which is fine */
+	for (k = 0; k < A6_TILES; k++) {
+		q[k] = _mm256_i32gather_epi32((const int *)p->tiles, least_tile_8(&tsv), 1);
+		q[k] = _mm256_and_si256(q[k], _mm256_set1_epi32(0xff));
+		c[k] = _mm256_setzero_si256();
+		r[k] = _mm256_setzero_si256();
+	}
+
+	/* lt is -1 where q[m] < q[k] */
+	for (k = 0; k < A6_TILES; k++)
+		for (m = k + 1; m < A6_TILES; m++) {
+			lt = _mm256_cmpgt_epi32(q[k], q[m]);
+			c[k] = _mm256_sub_epi32(c[k], lt);
+			r[k] = _mm256_sub_epi32(r[k], lt);
+			r[m] = _mm256_sub_epi32(r[m], _mm256_xor_si256(lt, _mm256_set1_epi32(-1)));
+		}
+
+	pi = c[0];
+	mr = _mm256_setzero_si256();
+	for (k = 0; k < A6_TILES; k++) {
+		if (k > 0)
+			pi = _mm256_add_epi32(pi, _mm256_mullo_epi32(c[k], _mm256_set1_epi32(a6_factors[k])));
+
+		mr = _mm256_add_epi32(mr, _mm256_i32gather_epi32((const int *)binomials[0],
+		    _mm256_add_epi32(_mm256_slli_epi32(q[k], 3), _mm256_add_epi32(r[k], _mm256_set1_epi32(1))), 4));
+	}
+
+	_mm256_storeu_si256((__m256i *)pidx, pi);
+	_mm256_storeu_si256((__m256i *)maprank, mr);
+}
+
+/*
+ * Look up the entries for the indices in pidx and maprank in the eight
+ * PDBs whose tables are given in tables and store them in h.  To not
+ * read past the end of the tables, the aligned dword holding each
+ * entry is gathered and the entry shifted out of it.
+ */
+static TARGET_AVX2 void
+pdb_lookup_8a6_avx2(int h[restrict 8], const permindex pidx[restrict 8],
+    const tsrank maprank[restrict 8], const atomic_uchar *restrict tables[restrict 8])
+{
+	__m256i offsets, addr, shift;
+	__m128i entries;
+	size_t i;
+
+	offsets = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)pidx),
+	    _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)maprank),
+	    _mm256_set1_epi32(A6_PERMUTATIONS)));
+
+	for (i = 0; i < 2; i++) {
+		addr = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(tables + 4 * i)),
+		    _mm256_cvtepu32_epi64(i == 0 ? _mm256_castsi256_si128(offsets) : _mm256_extracti128_si256(offsets, 1)));
+		shift = _mm256_slli_epi64(_mm256_and_si256(addr, _mm256_set1_epi64x(3)), 3);
+		addr = _mm256_andnot_si256(_mm256_set1_epi64x(3), addr);
+		entries = _mm256_i64gather_epi32(NULL, addr, 1);
+
+		/* pick the low dword of each 64 bit shift count */
+		shift = _mm256_permutevar8x32_epi32(shift, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+		entries = _mm_srlv_epi32(entries, _mm256_castsi256_si128(shift));
+		entries = _mm_and_si128(entries, _mm_set1_epi32(0xff));
+		_mm_storeu_si128((__m128i *)(h + 4 * i), entries);
+	}
+}
+
+/*
+ * Replace the eight map ranks in maprank by the offsets of the
+ * equivalence class of the zero tile at zloc, as index_offset() would
+ * compute them for PDBs accounting for the zero tile.  idxt is the
+ * index table of these PDBs.
+ */
+static TARGET_AVX2 void
+eqclass_offsets_8a6_avx2(tsrank maprank[restrict 8], const struct index_table *idxt,
+    unsigned zloc)
+{
+	__m256i entries, offsets, eqidx;
+
+	entries = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)maprank),
+	    _mm256_set1_epi32(sizeof *idxt));
+	offsets = _mm256_i32gather_epi32((const int *)((const char *)idxt + offsetof(struct index_table, offset)),
+	    entries, 1);
+
+	/* overshoots eqclasses, but not the struct index_table */
+	eqidx = _mm256_i32gather_epi32((const int *)(idxt->eqclasses + zloc), entries, 1);
+	eqidx = _mm256_and_si256(eqidx, _mm256_set1_epi32(0xff));
+
+	_mm256_storeu_si256((__m256i *)maprank, _mm256_add_epi32(offsets, eqidx));
+}
+#endif /* HAS_DISPATCH == 1 */
+
+#if HAS_DISPATCH == 1
+/*
+ * Like compute_index_8a6_avx2(), but for 16 tile sets.
+ */
+static TARGET_AVX512 void
+compute_index_16a6_avx512(permindex pidx[restrict 16], tsrank maprank[restrict 16],
+    const struct puzzle *p, const tileset ts[restrict 16])
+{
+	__m512i tsv = _mm512_loadu_si512(ts), low, tile, one = _mm512_set1_epi32(1);
+	__m512i q[A6_TILES], c[A6_TILES], r[A6_TILES], pi, mr;
+	__mmask16 lt;
+	size_t k, m;
+
+	/* see least_tile_8() */
+	for (k = 0; k < A6_TILES; k++) {
+		low = _mm512_and_si512(tsv, _mm512_sub_epi32(_mm512_setzero_si512(), tsv));
+		tsv = _mm512_xor_si512(tsv, low);
+		tile = _mm512_sub_epi32(_mm512_srli_epi32(_mm512_castps_si512(_mm512_cvtepi32_ps(low)), 23),
+		    _mm512_set1_epi32(127));
+		q[k] = _mm512_i32gather_epi32(tile, p->tiles, 1);
+		q[k] = _mm512_and_si512(q[k], _mm512_set1_epi32(0xff));
+		c[k] = _mm512_setzero_si512();
+		r[k] = _mm512_setzero_si512();
+	}
+
+	for (k = 0; k < A6_TILES; k++)
+		for (m = k + 1; m < A6_TILES; m++) {
+			lt = _mm512_cmplt_epi32_mask(q[m], q[k]);
+			c[k] = _mm512_mask_add_epi32(c[k], lt, c[k], one);
+			r[k] = _mm512_mask_add_epi32(r[k], lt, r[k], one);
+			r[m] = _mm512_mask_add_epi32(r[m], _mm512_knot(lt), r[m], one);
+		}
+
+	pi = c[0];
+	mr = _mm512_setzero_si512();
+	for (k = 0; k < A6_TILES; k++) {
+		if (k > 0)
+			pi = _mm512_add_epi32(pi, _mm512_mullo_epi32(c[k], _mm512_set1_epi32(a6_factors[k])));
+
+		mr = _mm512_add_epi32(mr, _mm512_i32gather_epi32(_mm512_add_epi32(_mm512_slli_epi32(q[k], 3),
+		    _mm512_add_epi32(r[k], one)), binomials[0], 4));
+	}
+
+	_mm512_storeu_si512(pidx, pi);
+	_mm512_storeu_si512(maprank, mr);
+}
+
+/*
+ * Like pdb_lookup_8a6_avx2(), but for 16 PDBs.
+ */
+static TARGET_AVX512 void
+pdb_lookup_16a6_avx512(int h[restrict 16], const permindex pidx[restrict 16],
+    const tsrank maprank[restrict 16], const atomic_uchar *restrict tables[restrict 16])
+{
+	__m512i offsets, addr, shift;
+	__m256i entries;
+	size_t i;
+
+	offsets = _mm512_add_epi32(_mm512_loadu_si512(pidx),
+	    _mm512_mullo_epi32(_mm512_loadu_si512(maprank), _mm512_set1_epi32(A6_PERMUTATIONS)));
+
+	for (i = 0; i < 2; i++) {
+		addr = _mm512_add_epi64(_mm512_loadu_si512((const void *)(tables + 8 * i)),
+		    _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(offsets, i)));
+		shift = _mm512_slli_epi64(_mm512_and_si512(addr, _mm512_set1_epi64(3)), 3);
+		addr = _mm512_andnot_si512(_mm512_set1_epi64(3), addr);
+		entries = _mm512_i64gather_epi32(addr, NULL, 1);
+		entries = _mm256_srlv_epi32(entries, _mm512_cvtepi64_epi32(shift));
+		entries = _mm256_and_si256(entries, _mm256_set1_epi32(0xff));
+		_mm256_storeu_si256((__m256i *)(h + 8 * i), entries);
+	}
+}
+
+/*
+ * Like eqclass_offsets_8a6_avx2(), but for 16 map ranks.
+ */
+static TARGET_AVX512 void
+eqclass_offsets_16a6_avx512(tsrank maprank[restrict 16], const struct index_table *idxt,
+    unsigned zloc)
+{
+	__m512i entries, offsets, eqidx;
+
+	entries = _mm512_mullo_epi32(_mm512_loadu_si512(maprank), _mm512_set1_epi32(sizeof *idxt));
+	offsets = _mm512_i32gather_epi32(entries, (const char *)idxt + offsetof(struct index_table, offset), 1);
+	eqidx = _mm512_i32gather_epi32(entries, idxt->eqclasses + zloc, 1);
+	eqidx = _mm512_and_si512(eqidx, _mm512_set1_epi32(0xff));
+
+	_mm512_storeu_si512(maprank, _mm512_add_epi32(offsets, eqidx));
+}
+#endif /* HAS_DISPATCH == 1 */
+
+/*
+ * The 16 lane variants for the lower levels just call the eight lane
+ * variants twice.
+ */
+static void
+compute_index_16a6_generic(permindex pidx[restrict 16], tsrank maprank[restrict 16],
+    const struct puzzle *p, const tileset ts[restrict 16])
+{
+	compute_index_8a6_generic(pidx + 0, maprank + 0, p, ts + 0);
+	compute_index_8a6_generic(pidx + 8, maprank + 8, p, ts + 8);
+}
+
+static void
+pdb_lookup_16a6_generic(int h[restrict 16], const permindex pidx[restrict 16],
+    const tsrank maprank[restrict 16], const atomic_uchar *restrict tables[restrict 16])
+{
+	pdb_lookup_8a6_generic(h + 0, pidx + 0, maprank + 0, tables + 0);
+	pdb_lookup_8a6_generic(h + 8, pidx + 8, maprank + 8, tables + 8);
+}
+
+static void
+eqclass_offsets_16a6_generic(tsrank maprank[restrict 16], const struct index_table *idxt,
+    unsigned zloc)
+{
+	eqclass_offsets_8a6_generic(maprank + 0, idxt, zloc);
+	eqclass_offsets_8a6_generic(maprank + 8, idxt, zloc);
+}
+
+#if HAS_DISPATCH == 1
+static TARGET_AVX2 void
+compute_index_16a6_avx2(permindex pidx[restrict 16], tsrank maprank[restrict 16],
+    const struct puzzle *p, const tileset ts[restrict 16])
+{
+	compute_index_8a6_avx2(pidx + 0, maprank + 0, p, ts + 0);
+	compute_index_8a6_avx2(pidx + 8, maprank + 8, p, ts + 8);
+}
+
+static TARGET_AVX2 void
+pdb_lookup_16a6_avx2(int h[restrict 16], const permindex pidx[restrict 16],
+    const tsrank maprank[restrict 16], const atomic_uchar *restrict tables[restrict 16])
+{
+	pdb_lookup_8a6_avx2(h + 0, pidx + 0, maprank + 0, tables + 0);
+	pdb_lookup_8a6_avx2(h + 8, pidx + 8, maprank + 8, tables + 8);
+}
+
+static TARGET_AVX2 void
+eqclass_offsets_16a6_avx2(tsrank maprank[restrict 16], const struct index_table *idxt,
+    unsigned zloc)
+{
+	eqclass_offsets_8a6_avx2(maprank + 0, idxt, zloc);
+	eqclass_offsets_8a6_avx2(maprank + 8, idxt, zloc);
+}
+#endif /* HAS_DISPATCH == 1 */
+
+void (*compute_index_16a6)(permindex[restrict 16], tsrank[restrict 16],
+    const struct puzzle *, const tileset[restrict 16]) = compute_index_16a6_generic;
+void (*pdb_lookup_16a6)(int[restrict 16], const permindex[restrict 16],
+    const tsrank[restrict 16], const atomic_uchar *restrict[restrict 16]) = pdb_lookup_16a6_generic;
+void (*compute_index_8a6)(permindex[restrict 8], tsrank[restrict 8],
+    const struct puzzle *, const tileset[restrict 8]) = compute_index_8a6_generic;
+void (*pdb_lookup_8a6)(int[restrict 8], const permindex[restrict 8],
+    const tsrank[restrict 8], const atomic_uchar *restrict[restrict 8]) = pdb_lookup_8a6_generic;
+void (*eqclass_offsets_16a6)(tsrank[restrict 16], const struct index_table *, unsigned)
+    = eqclass_offsets_16a6_generic;
+void (*eqclass_offsets_8a6)(tsrank[restrict 8], const struct index_table *, unsigned)
+    = eqclass_offsets_8a6_generic;
+
+/*
+ * Switch the functions in this file to the variants for instruction
+ * set extension level isa.  This is called by isa_select().  There
+ * are no SSE 4.2 variants, the generic ones are used instead.
+ */
+extern void
+indexvec_dispatch(int isa)
+{
+	switch (isa) {
+#if HAS_DISPATCH == 1
+	case ISA_AVX512:
+		compute_index_16a6 = compute_index_16a6_avx512;
+		pdb_lookup_16a6 = pdb_lookup_16a6_avx512;
+		eqclass_offsets_16a6 = eqclass_offsets_16a6_avx512;
+		compute_index_8a6 = compute_index_8a6_avx2;
+		pdb_lookup_8a6 = pdb_lookup_8a6_avx2;
+		eqclass_offsets_8a6 = eqclass_offsets_8a6_avx2;
+		break;
+
+	case ISA_AVX2:
+		compute_index_16a6 = compute_index_16a6_avx2;
+		pdb_lookup_16a6 = pdb_lookup_16a6_avx2;
+		eqclass_offsets_16a6 = eqclass_offsets_16a6_avx2;
+		compute_index_8a6 = compute_index_8a6_avx2;
+		pdb_lookup_8a6 = pdb_lookup_8a6_avx2;
+		eqclass_offsets_8a6 = eqclass_offsets_8a6_avx2;
+		break;
+#endif /* HAS_DISPATCH == 1 */
+
+	default:
+		compute_index_16a6 = compute_index_16a6_generic;
+		pdb_lookup_16a6 = pdb_lookup_16a6_generic;
+		eqclass_offsets_16a6 = eqclass_offsets_16a6_generic;
+		compute_index_8a6 = compute_index_8a6_generic;
+		pdb_lookup_8a6 = pdb_lookup_8a6_generic;
+		eqclass_offsets_8a6 = eqclass_offsets_8a6_generic;
+		break;
+	}
+}
@@ -0,0 +1,143 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* isa.c -- select index functions for the CPU at runtime */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "index.h"
+#include "isa.h"
+
+/* the currently selected instruction set extension level */
+int isa_current = ISA_GENERIC;
+
+static const char *const isa_names[ISA_COUNT] = {
+	[ISA_GENERIC] = "generic",
+	[ISA_SSE42] = "sse42",
+	[ISA_AVX2] = "avx2",
+	[ISA_AVX512] = "avx512",
+};
+
+/*
+ * Return the best instruction set extension level supported by both
+ * the CPU and the compiler.
+ */
+extern int
+isa_detect(void)
+{
+#if HAS_DISPATCH == 1
+	__builtin_cpu_init();
+
+	if (!__builtin_cpu_supports("popcnt") || !__builtin_cpu_supports("sse4.2"))
+		return (ISA_GENERIC);
+
+	if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("bmi")
+	    || !__builtin_cpu_supports("bmi2"))
+		return (ISA_SSE42);
+
+	if (!__builtin_cpu_supports("avx512f"))
+		return (ISA_AVX2);
+
+	return (ISA_AVX512);
+#else
+	return (ISA_GENERIC);
+#endif
+}
+
+/*
+ * Switch the index functions to the variants for isa.  Return 0 on
+ * success.  If isa is not supported, return -1 and set errno to
+ * ENOTSUP without changing anything.  This function must not be called
+ * while other threads use the index functions.
+ */
+extern int
+isa_select(int isa)
+{
+	if (isa < 0 || isa > isa_detect()) {
+		errno = ENOTSUP;
+		return (-1);
+	}
+
+	index_dispatch(isa);
+	indexvec_dispatch(isa);
+	isa_current = isa;
+
+	return (0);
+}
+
+/*
+ * Parse the name of an instruction set extension level as printed by
+ * isa_name() and return the level.  If str does not name a level,
+ * return -1.
+ */
+extern int
+isa_parse(const char *str)
+{
+	int isa;
+
+	for (isa = 0; isa < ISA_COUNT; isa++)
+		if (strcmp(str, isa_names[isa]) == 0)
+			return (isa);
+
+	return (-1);
+}
+
+/*
+ * Return the name of instruction set extension level isa.
+ */
+extern const char *
+isa_name(int isa)
+{
+	if (isa < 0 || isa >= ISA_COUNT)
+		return ("unknown");
+
+	return (isa_names[isa]);
+}
+
+/*
+ * Select the best supported instruction set extension level or the
+ * level requested in the environment variable PUZZLE_ISA.  This is
+ * called on startup.
+ */
+extern void
+isa_init(void)
+{
+	const char *env;
+	int isa;
+
+	env = getenv("PUZZLE_ISA");
+	if (env != NULL) {
+		isa = isa_parse(env);
+		if (isa_select(isa) == 0)
+			return;
+
+		fprintf(stderr, "PUZZLE_ISA=%s not supported, ignoring\n", env);
+	}
+
+	isa_select(isa_detect());
+}
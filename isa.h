@@ -0,0 +1,81 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef ISA_H
+#define ISA_H
+
+/*
+ * The index and PDB lookup functions come in variants for different
+ * instruction set extensions.  All variants the compiler can generate
+ * are built regardless of CFLAGS, and the best one the CPU supports is
+ * selected at runtime.  This way, a binary built without -march=native
+ * still runs at full speed on current CPUs but does not crash on older
+ * ones.  The choice can be overridden with the environment variable
+ * PUZZLE_ISA for benchmarking.
+ *
+ * The levels are ordered such that each level includes all lower
+ * ones:
+ *
+ * ISA_GENERIC  portable C code
+ * ISA_SSE42    SSE 4.2 and POPCNT
+ * ISA_AVX2     AVX2, BMI1, and BMI2
+ * ISA_AVX512   AVX-512F
+ */
+enum {
+	ISA_GENERIC,
+	ISA_SSE42,
+	ISA_AVX2,
+	ISA_AVX512,
+	ISA_COUNT,
+};
+
+/*
+ * If HAS_DISPATCH is 1, the compiler can build functions for specific
+ * instruction set extensions with the target attribute and all
+ * variants are built.  Otherwise, only the generic variants are.
+ */
+#ifndef HAS_DISPATCH
+# if defined(__x86_64__) && defined(__GNUC__)
+#  define HAS_DISPATCH 1
+# else
+#  define HAS_DISPATCH 0
+# endif
+#endif
+
+#if HAS_DISPATCH == 1
+# define TARGET_SSE42	__attribute__((target("sse4.2,popcnt")))
+# define TARGET_AVX2	__attribute__((target("avx2,popcnt,bmi,bmi2")))
+# define TARGET_AVX512	__attribute__((target("avx512f,avx2,popcnt,bmi,bmi2")))
+#endif
+
+extern int	isa_current;
+
+extern void	isa_init(void);
+extern int	isa_detect(void);
+extern int	isa_select(int);
+extern int	isa_parse(const char *);
+extern const char	*isa_name(int);
+
+#endif /* ISA_H */
@@ -0,0 +1,235 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* numa.c -- place threads and tables on NUMA nodes */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#ifdef __linux__
+# include <sched.h>
+# include <sys/syscall.h>
+#endif
+
+#include "numa.h"
+
+int numa_aware = 0;
+
+#ifdef __linux__
+/* from <linux/mempolicy.h> */
+enum {
+	MPOL_BIND = 2,
+	MPOL_F_NODE = 1 << 0,
+	MPOL_F_ADDR = 1 << 1,
+	MPOL_MF_MOVE = 1 << 1,
+};
+
+#define LONG_BITS (CHAR_BIT * sizeof(unsigned long))
+
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+static int n_nodes = 1, node_ids[NUMA_MAX_NODES];
+static cpu_set_t node_cpus[NUMA_MAX_NODES];
+
+/*
+ * Parse a list of CPUs like "0-3,8-11" as found in sysfs into set.
+ * Return the number of CPUs in the list.
+ */
+static int
+parse_cpulist(cpu_set_t *set, const char *list)
+{
+	unsigned long lo, hi;
+	char *end;
+	int count = 0;
+
+	CPU_ZERO(set);
+
+	while (*list >= '0' && *list <= '9') {
+		lo = hi = strtoul(list, &end, 10);
+		if (*end == '-')
+			hi = strtoul(end + 1, &end, 10);
+
+		for (; lo <= hi && lo < CPU_SETSIZE; lo++) {
+			CPU_SET(lo, set);
+			count++;
+		}
+
+		list = *end == ',' ? end + 1 : end;
+	}
+
+	return (count);
+}
+
+/*
+ * Find the NUMA nodes with CPUs and the CPUs of each.  If no nodes are
+ * found, pretend there is a single node with the CPUs we may run on.
+ */
+static void
+discover_topology(void)
+{
+	FILE *f;
+	int node;
+	char path[64], list[4096];
+
+	n_nodes = 0;
+	for (node = 0; node < NUMA_MAX_NODES; node++) {
+		snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+		f = fopen(path, "r");
+		if (f == NULL)
+			continue;
+
+		if (fgets(list, sizeof list, f) != NULL
+		    && parse_cpulist(node_cpus + n_nodes, list) > 0)
+			node_ids[n_nodes++] = node;
+
+		fclose(f);
+	}
+
+	if (n_nodes == 0) {
+		n_nodes = 1;
+		node_ids[0] = 0;
+		if (sched_getaffinity(0, sizeof node_cpus[0], node_cpus + 0) != 0)
+			CPU_ZERO(node_cpus + 0);
+	}
+}
+#endif /* __linux__ */
+
+/*
+ * Return the number of NUMA nodes with CPUs.
+ */
+extern int
+numa_nodes(void)
+{
+#ifdef __linux__
+	pthread_once(&topology_once, discover_topology);
+
+	return (n_nodes);
+#else
+	return (1);
+#endif
+}
+
+/*
+ * Return the node worker thread number worker is placed on.  Workers
+ * are distributed over the nodes in turn.
+ */
+extern int
+numa_worker_node(int worker)
+{
+	return (worker % numa_nodes());
+}
+
+/*
+ * Restrict the calling thread to the CPUs of node.  Return 0 on
+ * success.  On failure, return -1 and set errno.
+ */
+extern int
+numa_pin(int node)
+{
+#ifdef __linux__
+	if (node < 0 || node >= numa_nodes()) {
+		errno = EINVAL;
+		return (-1);
+	}
+
+	return (sched_setaffinity(0, sizeof node_cpus[node], node_cpus + node));
+#else
+	(void)node;
+
+	errno = ENOSYS;
+	return (-1);
+#endif
+}
+
+/*
+ * Place the len bytes of memory at addr on node, moving pages already
+ * present.  As memory is placed in whole pages, this affects the pages
+ * partially covered by the range, too.  Return 0 on success.  On
+ * failure, return -1 and set errno.
+ */
+extern int
+numa_bind(void *addr, size_t len, int node)
+{
+#ifdef __linux__
+	unsigned long mask[(NUMA_MAX_NODES + LONG_BITS - 1) / LONG_BITS] = { 0 };
+	uintptr_t pagesize = sysconf(_SC_PAGESIZE), head;
+	int id;
+
+	if (node < 0 || node >= numa_nodes()) {
+		errno = EINVAL;
+		return (-1);
+	}
+
+	id = node_ids[node];
+	mask[id / LONG_BITS] = 1ul << id % LONG_BITS;
+
+	head = (uintptr_t)addr & (pagesize - 1);
+	len = (len + head + pagesize - 1) & ~(pagesize - 1);
+
+	return (syscall(SYS_mbind, (uintptr_t)addr - head, len, MPOL_BIND,
+	    mask, NUMA_MAX_NODES + 1, MPOL_MF_MOVE) == 0 ? 0 : -1);
+#else
+	(void)addr;
+	(void)len;
+	(void)node;
+
+	errno = ENOSYS;
+	return (-1);
+#endif
+}
+
+/*
+ * Return the node the page containing addr resides on.  The page must
+ * be present.  If the node cannot be determined or has no CPUs, return
+ * -1 and set errno.
+ */
+extern int
+numa_node_of(const void *addr)
+{
+#ifdef __linux__
+	int id, node;
+
+	if (syscall(SYS_get_mempolicy, &id, NULL, 0, addr, MPOL_F_NODE | MPOL_F_ADDR) != 0)
+		return (-1);
+
+	for (node = 0; node < numa_nodes(); node++)
+		if (node_ids[node] == id)
+			return (node);
+
+	errno = ENOENT;
+	return (-1);
+#else
+	(void)addr;
+
+	errno = ENOSYS;
+	return (-1);
+#endif
+}
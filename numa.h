@@ -0,0 +1,58 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* numa.h -- place threads and tables on NUMA nodes */
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stddef.h>
+
+/*
+ * On machines with multiple NUMA nodes, PDB lookups are slower if the
+ * PDB resides on a different node than the thread looking it up.  If
+ * numa_aware is set, worker threads are pinned to the nodes in turn
+ * and use a replica of the PDB catalogue on their node (see
+ * catalogue_replicate()).  Like pdb_jobs, numa_aware is intended to
+ * be set once during program initialisation.  Nodes are numbered
+ * densely from 0 to numa_nodes() - 1 in the order of their node
+ * numbers; nodes without CPUs are ignored.  Only the system calls are
+ * used, libnuma is not needed.  On systems without NUMA support, there
+ * is a single node comprising all CPUs.
+ */
+extern int numa_aware;
+
+enum {
+	/* maximum number of NUMA nodes supported */
+	NUMA_MAX_NODES = 64,
+};
+
+extern int	numa_nodes(void);
+extern int	numa_worker_node(int);
+extern int	numa_pin(int);
+extern int	numa_bind(void *, size_t, int);
+extern int	numa_node_of(const void *);
+
+#endif /* NUMA_H */
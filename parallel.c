@@ -25,112 +25,419 @@
 
 /* parallel.c -- multi-threaded operation on pattern databases */
 
+#define _POSIX_C_SOURCE 200809L
 #include <errno.h>
+#include <stdalign.h>
 #include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <pthread.h>
 
 #include "tileset.h"
 #include "index.h"
+#include "numa.h"
 #include "parallel.h"
 #include "pdb.h"
 
 int pdb_jobs = 1;
 
+enum {
+	/* approximate number of PDB entries in one unit of work */
+	CHUNK_ENTRIES = 1 << 14,
+
+	/* workers take a CHUNK_GUIDE * jobs'th of the units left at once */
+	CHUNK_GUIDE = 4,
+};
+
 /*
- * This function is the main function of each worker thread.  It grabs
- * chunks off the pile and calls worker() for them until no work is
- * left.
+ * A job for the thread pool.  Each worker taking part calls
+ * run(arg, worker) with its worker number.
+ */
+struct pool_job {
+	void (*run)(void *, int);
+	void *arg;
+	int jobs;
+};
+
+/*
+ * Statistics for one worker.  Each worker only writes its own entry,
+ * the alignment keeps the entries on separate cache lines.
+ */
+struct worker_stats {
+	alignas(64) double busy;
+	size_t chunks;
+};
+
+/*
+ * The thread pool.  Workers 1 to n_thread are threads waiting for the
+ * generation counter to change, worker 0 is the thread submitting the
+ * job.  running is the number of threads that have not finished the
+ * current job yet.  jobs serialises callers of pool_run().
+ */
+static struct {
+	pthread_mutex_t lock, jobs;
+	pthread_cond_t wakeup, done;
+	const struct pool_job *job;
+	unsigned long generation;
+	int n_thread, running;
+	size_t n_job;
+	double wall;
+	unsigned long born[PDB_MAX_JOBS];
+	struct worker_stats stats[PDB_MAX_JOBS];
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.jobs = PTHREAD_MUTEX_INITIALIZER,
+	.wakeup = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Return the current time in seconds.
+ */
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+/*
+ * Run job as worker and account for the time taken.
+ */
+static void
+run_timed(const struct pool_job *job, int worker)
+{
+	double begin = now();
+
+	job->run(job->arg, worker);
+	pool.stats[worker].busy += now() - begin;
+}
+
+/*
+ * The main function of each pool thread.  Wait for a job, run it if
+ * this thread takes part in it, and report back.  If numa_aware is set,
+ * the thread is first pinned to its node.
  */
 static void *
-parallel_worker(void *cfgarg)
+pool_thread(void *arg)
 {
-	struct parallel_config *cfg = cfgarg;
-	struct index idx;
+	const struct pool_job *job;
+	int worker = (int)(intptr_t)arg;
+	unsigned long generation;
+
+	if (numa_aware)
+		numa_pin(numa_worker_node(worker));
 
+	pthread_mutex_lock(&pool.lock);
+	generation = pool.born[worker];
 	for (;;) {
-		/* pick up chunk */
-		idx.maprank = atomic_fetch_add(&cfg->nextrank, 1);
+		while (pool.generation == generation)
+			pthread_cond_wait(&pool.wakeup, &pool.lock);
+
+		generation = pool.generation;
+		job = pool.job;
+		pthread_mutex_unlock(&pool.lock);
+
+		if (worker < job->jobs)
+			run_timed(job, worker);
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.running == 0)
+			pthread_cond_signal(&pool.done);
+	}
+
+	/* NOTREACHED */
+	return (NULL);
+}
+
+/*
+ * Make sure there are at least n_thread pool threads if possible.  If
+ * threads cannot be created, the jobs are done with fewer workers.
+ * pool.lock must be held.
+ */
+static void
+pool_grow(int n_thread)
+{
+	pthread_t thread;
+	int error;
 
-		/* any work left to do? */
-		if (idx.maprank >= cfg->pdb->aux.n_maprank)
+	while (pool.n_thread < n_thread) {
+		pool.born[pool.n_thread + 1] = pool.generation;
+		error = pthread_create(&thread, NULL, pool_thread,
+		    (void *)(intptr_t)(pool.n_thread + 1));
+		if (error != 0) {
+			errno = error;
+			perror("pthread_create");
 			break;
+		}
+
+		pthread_detach(thread);
+		pool.n_thread++;
+	}
+}
+
+/*
+ * Call run(arg, worker) on pdb_jobs workers, including the calling
+ * thread as worker 0, and wait for all of them to finish.
+ */
+static void
+pool_run(void (*run)(void *, int), void *arg)
+{
+	struct pool_job job;
+	double begin;
+
+	pthread_mutex_lock(&pool.jobs);
+
+	job.run = run;
+	job.arg = arg;
+	begin = now();
+
+	pthread_mutex_lock(&pool.lock);
+	pool_grow(pdb_jobs - 1);
+	job.jobs = pool.n_thread + 1 < pdb_jobs ? pool.n_thread + 1 : pdb_jobs;
+	pool.job = &job;
+	pool.running = pool.n_thread;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.wakeup);
+	pthread_mutex_unlock(&pool.lock);
+
+	run_timed(&job, 0);
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.running > 0)
+		pthread_cond_wait(&pool.done, &pool.lock);
+
+	pool.wall += now() - begin;
+	pool.n_job++;
+	pthread_mutex_unlock(&pool.lock);
+
+	pthread_mutex_unlock(&pool.jobs);
+}
+
+/*
+ * Claim the next units of work from *next, of which there are n in
+ * total, shared among jobs workers.  Large chunks are taken while much
+ * work is left and single units towards the end, so the workers finish
+ * at about the same time.  Store the end of the units claimed in *end
+ * and return their beginning.  If no work is left, return n.
+ */
+static size_t
+claim_units(_Atomic size_t *next, size_t n, int jobs, size_t *end)
+{
+	size_t begin = atomic_load_explicit(next, memory_order_relaxed), count;
+
+	*end = n;
+	if (begin >= n)
+		return (n);
+
+	count = (n - begin) / (CHUNK_GUIDE * jobs);
+	if (count == 0)
+		count = 1;
 
+	begin = atomic_fetch_add_explicit(next, count, memory_order_relaxed);
+	if (begin >= n)
+		return (n);
+
+	*end = begin + count < n ? begin + count : n;
+
+	return (begin);
+}
+
+/*
+ * The state of pdb_iterate_parallel().  The PDB is divided into n_unit
+ * units of about CHUNK_ENTRIES entries.  If parts is not 0, each
+ * maprank is split into parts units of consecutive permutation
+ * indices.  Otherwise, each unit comprises batch whole mapranks.
+ */
+struct iterate_job {
+	struct parallel_config *cfg;
+	size_t n_unit, parts, batch;
+	int jobs;
+	_Atomic size_t next;
+};
+
+/*
+ * Call the worker function for unit.
+ */
+static void
+iterate_unit(struct iterate_job *job, size_t unit)
+{
+	struct index idx;
+	size_t n_maprank = job->cfg->pdb->aux.n_maprank, n_perm = job->cfg->pdb->aux.n_perm, last;
+
+	idx.eqidx = 0;
+
+	if (job->parts != 0) {
+		idx.maprank = unit / job->parts;
+		idx.pidx = n_perm * (unit % job->parts) / job->parts;
+		job->cfg->worker(job->cfg, &idx, n_perm * (unit % job->parts + 1) / job->parts);
+
+		return;
+	}
+
+	last = (unit + 1) * job->batch < n_maprank ? (unit + 1) * job->batch : n_maprank;
+	for (idx.maprank = unit * job->batch; idx.maprank < last; idx.maprank++) {
 		idx.pidx = 0;
 		idx.eqidx = 0;
-		cfg->worker(cfgarg, &idx);
+		job->cfg->worker(job->cfg, &idx, n_perm);
 	}
+}
 
-	return (NULL);
+/*
+ * The part of pdb_iterate_parallel() done by each worker.  Grab units
+ * off the pile and call the worker function for them until no work is
+ * left.
+ */
+static void
+iterate_worker(void *jobarg, int worker)
+{
+	struct iterate_job *job = jobarg;
+	size_t begin, end;
+
+	while (begin = claim_units(&job->next, job->n_unit, job->jobs, &end), begin < job->n_unit) {
+		pool.stats[worker].chunks++;
+		for (; begin < end; begin++)
+			iterate_unit(job, begin);
+	}
 }
 
 /*
- * Iterate through the PDB in parallel.  Only the members pdb, ts, and
- * worker of cfg must be filled in, the other members are filled in by
- * the function.  If you want to pass extra data to cfg->worker, make
- * *cfg the first member of a larger structure as cfg is passed to every
- * call of worker.
+ * Iterate through the PDB in parallel.  Only the members pdb, split,
+ * and worker of cfg must be filled in.  If you want to pass extra data
+ * to cfg->worker, make *cfg the first member of a larger structure as
+ * cfg is passed to every call of worker.  Mapranks with more than about
+ * CHUNK_ENTRIES entries are split into parts if cfg->split is set,
+ * smaller ones are handed out in batches.
  */
 extern void
 pdb_iterate_parallel(struct parallel_config *cfg)
 {
-	pthread_t pool[PDB_MAX_JOBS];
+	struct iterate_job job;
+	const struct index_aux *aux = &cfg->pdb->aux;
+	size_t per_maprank = search_space_size(aux) / aux->n_maprank;
 
-	size_t j;
-	int i, jobs = pdb_jobs, error;
+	job.cfg = cfg;
+	job.jobs = pdb_jobs;
+	job.next = 0;
 
-	cfg->nextrank = 0;
+	if (cfg->split && per_maprank > CHUNK_ENTRIES) {
+		job.parts = (per_maprank + CHUNK_ENTRIES - 1) / CHUNK_ENTRIES;
+		if (job.parts > aux->n_perm)
+			job.parts = aux->n_perm;
 
-	/* for easier debugging, don't multithread when jobs == 1 */
-	if (jobs == 1) {
-		struct index idx;
+		job.batch = 0;
+		job.n_unit = (size_t)aux->n_maprank * job.parts;
+	} else {
+		job.parts = 0;
+		job.batch = CHUNK_ENTRIES / per_maprank;
+		if (job.batch == 0)
+			job.batch = 1;
 
-		for (j = 0; j < cfg->pdb->aux.n_maprank; j++) {
-			idx.pidx = 0;
-			idx.maprank = j;
-			idx.eqidx = 0;
-			cfg->worker(cfg, &idx);
-		}
+		job.n_unit = (aux->n_maprank + job.batch - 1) / job.batch;
+	}
 
-		return;
+	pool_run(iterate_worker, &job);
+}
+
+/*
+ * The state of parallel_for().  next is the next item to be done.
+ */
+struct parallel_for_job {
+	void (*fn)(void *, size_t);
+	void *arg;
+	size_t n;
+	int jobs;
+	_Atomic size_t next;
+};
+
+/*
+ * The part of parallel_for() done by each worker.  Call fn for the
+ * items picked up until none are left.
+ */
+static void
+parallel_for_worker(void *jobarg, int worker)
+{
+	struct parallel_for_job *job = jobarg;
+	size_t begin, end;
+
+	while (begin = claim_units(&job->next, job->n, job->jobs, &end), begin < job->n) {
+		pool.stats[worker].chunks++;
+		for (; begin < end; begin++)
+			job->fn(job->arg, begin);
 	}
+}
 
-	/* spawn threads */
-	for (i = 0; i < jobs; i++) {
-		error = pthread_create(pool + i, NULL, parallel_worker, cfg);
-		if (error == 0)
-			continue;
-
-		errno = error;
-		perror("pthread_create");
-
-		/*
-		 * if we cannot spawn as many threads as we like
-		 * but we can at least spawn some threads, just keep
-		 * going with the tablebase generation.  Otherwise,
-		 * there is no point in going on, so this is a good spot
-		 * to throw our hands up in the air and give up.
-		 */
-		if (i++ > 0)
-			break;
+/*
+ * Call fn(arg, i) for each i from 0 to n - 1, using pdb_jobs threads.
+ * The calls are made in no particular order.
+ */
+extern void
+parallel_for(void (*fn)(void *, size_t), void *arg, size_t n)
+{
+	struct parallel_for_job job;
+
+	job.fn = fn;
+	job.arg = arg;
+	job.n = n;
+	job.jobs = pdb_jobs;
+	job.next = 0;
+
+	pool_run(parallel_for_worker, &job);
+}
+
+/*
+ * Print the time each worker spent working and the number of chunks
+ * it did to f.  The busy time is given relative to the total time the
+ * jobs took.  The ratio of the maximum to the mean busy time shows how
+ * unevenly the work was distributed.
+ */
+extern void
+parallel_report(FILE *f)
+{
+	double max = 0.0, sum = 0.0, wall;
+	int i, n_worker;
+
+	pthread_mutex_lock(&pool.jobs);
+
+	n_worker = pool.n_thread + 1;
+	wall = pool.wall > 0.0 ? pool.wall : 1.0;
+	fprintf(f, "%zu parallel jobs with %d worker%s, %.3f s\n",
+	    pool.n_job, n_worker, n_worker == 1 ? "" : "s", pool.wall);
 
-		fprintf(stderr, "Couldn't create any threads, aborting...\n");
-		abort();
+	for (i = 0; i < n_worker; i++) {
+		fprintf(f, "worker %3d: %10.3f s busy (%5.1f%%) %12zu chunks\n",
+		    i, pool.stats[i].busy, 100.0 * pool.stats[i].busy / wall, pool.stats[i].chunks);
+		sum += pool.stats[i].busy;
+		if (pool.stats[i].busy > max)
+			max = pool.stats[i].busy;
 	}
 
-	/* reduce count in case we couldn't create as many threads as we wanted */
-	jobs = i;
+	if (sum > 0.0)
+		fprintf(f, "load imbalance (max/mean busy time): %.3f\n", max * n_worker / sum);
 
-	/* collect threads */
-	for (i = 0; i < jobs; i++) {
-		error = pthread_join(pool[i], NULL);
-		if (error == 0)
-			continue;
+	pthread_mutex_unlock(&pool.jobs);
+}
+
+extern void
+parallel_reset_stats(void)
+{
+	int i;
 
-		errno = error;
-		perror("pthread_join");
-		abort();
+	pthread_mutex_lock(&pool.jobs);
+
+	for (i = 0; i < PDB_MAX_JOBS; i++) {
+		pool.stats[i].busy = 0.0;
+		pool.stats[i].chunks = 0;
 	}
+
+	pool.n_job = 0;
+	pool.wall = 0.0;
+
+	pthread_mutex_unlock(&pool.jobs);
 }
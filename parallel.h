@@ -26,15 +26,21 @@
 #ifndef PARALLEL_H
 #define PARALLEL_H
 
+#include <stdio.h>
+
 #include "pdb.h"
 
 /*
  * This file contains some helper functions for parallel iteration
  * through endgame tablebases.  The function pdb_iterate_parallel()
  * uses pdb_jobs threads to iterate through the PDB, calling the worker
- * function for each maprank.  The worker function can submit results
- * by embedding struct parallel_config at the beginning of a custom
- * structure like this:
+ * function for chunks of the PDB.  A chunk comprises the entries of
+ * maprank idx->maprank with permutation indices from idx->pidx up to
+ * (but excluding) end in all equivalence classes.  Unless split is set,
+ * chunks always comprise whole mapranks, i.e. idx->pidx is 0 and end
+ * is the number of permutations.  The worker function can submit
+ * results by embedding struct parallel_config at the beginning of a
+ * custom structure like this:
  *
  *     struct my_config {
  *         struct parallel_config pcfg;
@@ -44,12 +50,31 @@
  */
 struct parallel_config {
 	struct patterndb *pdb;
-	_Atomic tsrank nextrank;	/* start of next chunk to be done */
+	int split;	/* if worker can be called for parts of mapranks */
 
 	/* worker function */
-	void (*worker)(void *, struct index *);
+	void (*worker)(void *, struct index *, permindex);
 };
 
 extern void pdb_iterate_parallel(struct parallel_config *);
 
+/*
+ * parallel_for() is a simpler interface for other work that divides
+ * into independent items, such as the buckets of pdb_generate()'s
+ * scatter buffers.
+ */
+extern void parallel_for(void (*)(void *, size_t), void *, size_t);
+
+/*
+ * Both functions run on a pool of threads created on first use and
+ * kept for the rest of the program.  The calling thread takes part in
+ * the work as worker 0, so with pdb_jobs == 1, no threads are created.
+ * The functions must not be called from within a worker function.
+ * For each worker, the time spent working and the number of chunks
+ * done are recorded.  parallel_report() prints these statistics to
+ * show load imbalance, parallel_reset_stats() clears them.
+ */
+extern void parallel_report(FILE *);
+extern void parallel_reset_stats(void);
+
 #endif /* PARALLEL_H */
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <sys/mman.h>
 
+#include "hugepage.h"
 #include "tileset.h"
 #include "index.h"
 #include "puzzle.h"
@@ -77,12 +78,13 @@ pdb_dummy(tileset ts)
 {
 	struct patterndb *pdb;
 
-	pdb = malloc(sizeof *pdb);
+	pdb = aligned_alloc(alignof(struct patterndb), sizeof *pdb);
 	if (pdb == NULL)
 		return (NULL);
 
 	make_index_aux(&pdb->aux, ts);
 	pdb->mapped = 0;
+	pdb->huge = HUGE_NONE;
 	pdb->data = NULL;
 
 	return (pdb);
@@ -92,7 +94,8 @@ pdb_dummy(tileset ts)
  * Allocate storage for a pattern database representing ts.  If storage
  * is insufficient, return NULL and set errno.  The entries in PDB are
  * undefined initially.  Use pdb_clear() to set the patterndb to a
- * well-defined state.
+ * well-defined state.  If huge_pages is set, the storage is backed by
+ * huge pages.
  */
 extern struct patterndb *
 pdb_allocate(tileset ts)
@@ -103,7 +106,11 @@ pdb_allocate(tileset ts)
 	if (pdb == NULL)
 		return (NULL);
 
-	pdb->data = malloc(search_space_size(&pdb->aux));
+	if (huge_pages)
+		pdb->data = huge_alloc(search_space_size(&pdb->aux), &pdb->huge);
+	else
+		pdb->data = malloc(search_space_size(&pdb->aux));
+
 	if (pdb->data == NULL) {
 		error = errno;
 		free(pdb);
@@ -121,8 +128,8 @@ extern void
 pdb_free(struct patterndb *pdb)
 {
 
-	if (pdb->mapped)
-		munmap(pdb->data, search_space_size(&pdb->aux));
+	if (pdb->mapped || pdb->huge != HUGE_NONE)
+		huge_unmap(pdb->data, search_space_size(&pdb->aux), pdb->huge);
 	else
 		free(pdb->data);
 
@@ -187,6 +194,10 @@ pdb_store(FILE *pdbfile, struct patterndb *pdb)
 	size_t count, size = search_space_size(&pdb->aux);
 	int error;
 
+	/* files on hugetlbfs can only be written through a mapping */
+	if (huge_fd_is_hugetlbfs(fileno(pdbfile)))
+		return (huge_store(fileno(pdbfile), (void *)pdb->data, size));
+
 	count = fwrite((void *)pdb->data, 1, size, pdbfile);
 	if (count != size) {
 		error = errno;
@@ -209,7 +220,8 @@ pdb_store(FILE *pdbfile, struct patterndb *pdb)
  * Load a PDB from file descriptor fd by mapping it into RAM.  This
  * might perform better than pdb_load().  Use flags to decide what
  * protection the mapping has and whether changes are written back to
- * the input file.
+ * the input file.  If the file is on hugetlbfs, the mapping is backed
+ * by huge pages.
  */
 extern struct patterndb *
 pdb_mmap(tileset ts, int pdbfd, int mapflags)
@@ -242,7 +254,7 @@ pdb_mmap(tileset ts, int pdbfd, int mapflags)
 		return (NULL);
 
 	pdb->mapped = 1;
-	pdb->data = mmap(NULL, search_space_size(&pdb->aux), prot, flags, pdbfd, 0);
+	pdb->data = huge_map(search_space_size(&pdb->aux), prot, flags, pdbfd, &pdb->huge);
 	if (pdb->data == MAP_FAILED) {
 		error = errno;
 		free(pdb);
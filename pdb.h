@@ -26,6 +26,7 @@
 #ifndef PDB_H
 #define PDB_H
 
+#include <assert.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <limits.h>
@@ -44,6 +45,7 @@
 struct patterndb {
 	struct index_aux aux;
 	int mapped; /* true if PDB has been allocated using mmap() */
+	int huge; /* how data is backed by huge pages, see hugepage.h */
 	atomic_uchar *data;
 };
 
@@ -81,6 +83,13 @@ enum {
  */
 extern int pdb_jobs;
 
+/*
+ * The number of bytes pdb_generate() may use for scatter buffers, or 0
+ * to write the entries reached directly (the default).  Like pdb_jobs,
+ * this is intended to be set once during program initialization.
+ */
+extern size_t pdb_scatter;
+
 extern const unsigned pdbcount[TILE_COUNT];
 
 /* pdb.c */
@@ -101,6 +110,9 @@ extern void	pdb_identify(struct patterndb *);
 extern double	pdb_eta(struct patterndb *);
 extern double	pdb_h_average(struct patterndb *);
 
+/* pdbdelta.c */
+extern unsigned char	*pdb_deltas(struct patterndb *);
+
 /*
  * Return a pointer to the PDB entry for idx.
  */
@@ -178,4 +190,58 @@ pdb_lookup_puzzle(struct patterndb *pdb, const struct puzzle *p)
 	return (pdb_lookup(pdb, &idx));
 }
 
+/*
+ * Delta tables as computed by pdb_deltas() record for each PDB entry
+ * how it changes when a tile is moved in one of four directions.  This
+ * is used by EPEIDA* to find the h values of a node's children without
+ * looking them up.  Each change is encoded in two bits as DELTA_SAME
+ * plus the change.
+ */
+enum {
+	DELTA_UNKNOWN = 0,
+	DELTA_LESS = 1,
+	DELTA_SAME = 2,
+	DELTA_MORE = 3,
+};
+
+/*
+ * Return the direction (0 to 3) of a move of a tile from square from
+ * to the adjacent square to.
+ */
+static inline unsigned
+move_direction(size_t from, size_t to)
+{
+	if (to < from)
+		return (from - to == 1 ? 1 : 0);
+	else
+		return (to - from == 1 ? 2 : 3);
+}
+
+/*
+ * Return the index of the delta table entry for tile among those for
+ * tile set ts (not including the zero tile).
+ */
+static inline unsigned
+delta_tile_index(tileset ts, unsigned tile)
+{
+	return (tileset_count(tileset_intersect(ts, (1u << tile) - 1)));
+}
+
+/*
+ * Return how the PDB entry at offset changes when tile is moved in
+ * direction dir according to the delta table deltas for tile set ts
+ * (not including the zero tile).
+ */
+static inline int
+pdb_delta(const unsigned char *deltas, tileset ts, size_t offset,
+    unsigned tile, unsigned dir)
+{
+	unsigned code;
+
+	code = deltas[offset * tileset_count(ts) + delta_tile_index(ts, tile)] >> 2 * dir & 3;
+	assert(code != DELTA_UNKNOWN);
+
+	return ((int)code - DELTA_SAME);
+}
+
 #endif /* PDB_H */
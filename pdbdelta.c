@@ -0,0 +1,133 @@
+/*-
+ * Copyright (c) 2017 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* pdbdelta.c -- operator delta tables for EPEIDA* */
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "puzzle.h"
+#include "tileset.h"
+#include "index.h"
+#include "pdb.h"
+#include "parallel.h"
+
+/*
+ * Configuration for pdb_deltas().  invalid is set if an entry changes
+ * by more than one in a single move.
+ */
+struct delta_config {
+	struct parallel_config pcfg;
+	unsigned char *deltas;
+	atomic_int invalid;
+};
+
+/*
+ * Fill in the delta table entries for the permutation indices from
+ * idx->pidx to end of the cohort given by idx.
+ */
+static void
+delta_cohort(void *cfgarg, struct index *idx, permindex end)
+{
+	struct move moves[MAX_MOVES];
+	struct delta_config *cfg = cfgarg;
+	struct patterndb *pdb = cfg->pcfg.pdb;
+	struct puzzle p;
+	struct index didx;
+	size_t n_eqclass = eqclass_count(&pdb->aux, idx->maprank), n_move, i, offset;
+	unsigned tile, n_tile = pdb->aux.n_tile;
+	unsigned char *entry;
+	int h, dh;
+	permindex begin = idx->pidx;
+	tileset ts = tileset_remove(pdb->aux.ts, ZERO_TILE);
+
+	invert_index_map(&pdb->aux, &p, idx);
+
+	for (idx->eqidx = 0; idx->eqidx < n_eqclass; idx->eqidx++) {
+		n_move = generate_moves(moves, eqclass_from_index(&pdb->aux, idx));
+		for (idx->pidx = begin; idx->pidx < end; idx->pidx++) {
+			invert_index_rest(&pdb->aux, &p, idx);
+			offset = index_offset(&pdb->aux, idx);
+			h = pdb->data[offset];
+			entry = cfg->deltas + offset * n_tile;
+			memset(entry, DELTA_UNKNOWN, n_tile);
+
+			for (i = 0; i < n_move; i++) {
+				move(&p, moves[i].zloc);
+				tile = p.grid[moves[i].dest];
+				move(&p, moves[i].dest);
+				compute_index(&pdb->aux, &didx, &p);
+				move(&p, moves[i].zloc);
+
+				dh = pdb_lookup(pdb, &didx) - h;
+				if (dh < -1 || dh > 1) {
+					cfg->invalid = 1;
+					continue;
+				}
+
+				entry[delta_tile_index(ts, tile)] |=
+				    (dh + DELTA_SAME) << 2 * move_direction(moves[i].dest, moves[i].zloc);
+			}
+		}
+	}
+}
+
+/*
+ * Compute the delta table for pdb.  The table has n_tile entries for
+ * each entry of pdb, one per tile in the order of tile numbers.  Each
+ * of these holds four 2 bit fields, one for each direction tile can be
+ * moved in as given by move_direction().  Each field holds how the PDB
+ * entry changes when the tile is moved that way, encoded as
+ * DELTA_SAME + change, or DELTA_UNKNOWN if the move is not possible.
+ * Use pdb_delta() to look up entries.  Return the table on success or
+ * NULL on error with errno set.  If some move changes an entry of pdb
+ * by more than one (as can happen for identified PDBs), set errno to
+ * EINVAL.
+ */
+extern unsigned char *
+pdb_deltas(struct patterndb *pdb)
+{
+	struct delta_config cfg;
+
+	cfg.pcfg.pdb = pdb;
+	cfg.pcfg.split = 1;
+	cfg.pcfg.worker = delta_cohort;
+	cfg.invalid = 0;
+	cfg.deltas = malloc(search_space_size(&pdb->aux) * pdb->aux.n_tile);
+	if (cfg.deltas == NULL)
+		return (NULL);
+
+	pdb_iterate_parallel(&cfg.pcfg);
+
+	if (cfg.invalid) {
+		free(cfg.deltas);
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	return (cfg.deltas);
+}
@@ -27,8 +27,10 @@
 
 #include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "builtins.h"
 #include "puzzle.h"
 #include "tileset.h"
 #include "index.h"
@@ -36,54 +38,400 @@
 #include "parallel.h"
 
 /*
- * Update the PDB for configuration p by finding all positions we can
- * move to from the equivalence class represented by idx that are marked
- * as UNREACHED and then setting them to round.
+ * The frontier of a round are the entries reached in the round
+ * before.  Instead of scanning the whole PDB for them, the entries
+ * reached in a round can be recorded in a bitmap with one bit per PDB
+ * entry, so the next round only visits the frontier.  Maintaining the
+ * bitmap costs an extra write per entry reached, so it is only done
+ * if the next frontier is expected to be smaller than a
+ * FRONTIER_SPARSE'th of the PDB.  Otherwise the next round scans the
+ * whole PDB as usual.  The two bitmaps needed take up a quarter of the
+ * PDB's size.
  */
-static void
-update_pdb_entry(struct patterndb *pdb, struct puzzle *p,
-    const struct move *moves, size_t n_move, int round)
-{
-	struct index dist[MAX_MOVES];
-	size_t i;
+enum {
+	FRONTIER_SPARSE = 32,
+	FRONTIER_BITS = 64,
+};
 
-	for (i = 0; i < n_move; i++) {
-		move(p, moves[i].zloc);
-		move(p, moves[i].dest);
+/*
+ * In the middle rounds, the frontier is so large that most entries
+ * reached from it have already been reached before.  Pushing from the
+ * frontier then mostly performs random reads that find nothing to do.
+ * Instead, these rounds pull: they visit the entries still UNREACHED
+ * and check whether any of their neighbours is in the frontier.  As
+ * both directions expand about the same number of moves per entry
+ * visited, a round pulls if fewer than PULL_FACTOR times as many
+ * entries are left to reach as there are in the frontier.  When the
+ * frontier is in a bitmap, pushing does not need to scan the PDB.
+ * This scan is accounted for as expanding a PULL_SCAN'th of the PDB.
+ */
+enum {
+	PULL_FACTOR = 1,
+	PULL_SCAN = 1024,
+};
 
-		compute_index(&pdb->aux, dist + i, p);
+/*
+ * Instead of updating the entries reached right away, which are
+ * spread randomly over the whole PDB, push rounds can append them to
+ * scatter buffers if pdb_scatter is set.  There is one buffer for each
+ * thread, divided into buckets, each of which holds entries of a range
+ * of mapranks covering a 2^shift entry span of the PDB.  Once all
+ * entries have been expanded, the buckets are applied range by range,
+ * each range by a single thread, so the writes stay in cache.  A
+ * bucket that fills up early is applied right away.  The spans cover
+ * at least SCATTER_SPAN entries and are made larger if needed for the
+ * buckets to hold at least SCATTER_MIN entries each.  Entries are
+ * stored as offsets into their span; the round is the same for all.
+ */
+enum {
+	SCATTER_SPAN = 256 * 1024,
+	SCATTER_MIN = 64,
+};
 
-		move(p, moves[i].zloc);
-		pdb_prefetch(pdb, dist + i);
-	}
+size_t pdb_scatter = 0;
 
-	for (i = 0; i < n_move; i++)
-		pdb_conditional_update(pdb, dist + i, round);
-}
+/*
+ * One scatter buffer.  A worker claims a buffer by setting busy.
+ * fill[i] is the number of entries in bucket i, the entries of which
+ * are found at entries[i * cap].
+ */
+struct scatter_buffer {
+	_Atomic int busy;
+	size_t *fill;
+	unsigned *entries;
+};
+
+struct scatter {
+	size_t n_bucket, cap;
+	int n_buffer, shift;
+	struct scatter_buffer buffers[];
+};
 
 /*
- * Configuration for generate_patterndb.  count is the total number of
- * entries updated in this round.
+ * Configuration for generate_patterndb.  updated is the number of
+ * entries reached in this round.  If frontier is not NULL, it is a
+ * bitmap of the entries to expand, otherwise all entries are scanned
+ * for them.  If next is not NULL, the entries reached are recorded in
+ * it.  If scatter is not NULL, push rounds go through the scatter
+ * buffers.
  */
 struct pdbgen_config {
 	struct parallel_config pcfg;
-	_Atomic size_t count;
+	_Atomic size_t updated;
+	const _Atomic unsigned long long *frontier;
+	_Atomic unsigned long long *next;
+	struct scatter *scatter;
 	int round;
 };
 
 /*
- * Generate one cohort of one round of the PDB where round > 0.
- * It is safe to execute this in parallel on the same dataset.
+ * Update the entry at offset to round if it is UNREACHED.  If next is
+ * not NULL, record the entry in the frontier bitmap next.  Return 1 if
+ * the entry was updated, 0 otherwise.
+ */
+static int
+frontier_update(struct patterndb *pdb, _Atomic unsigned long long *next,
+    size_t offset, int round)
+{
+	unsigned char expected = UNREACHED;
+
+	if (atomic_load_explicit(pdb->data + offset, memory_order_relaxed) != UNREACHED)
+		return (0);
+
+	/* only count entries we actually updated so the frontier size is exact */
+	if (!atomic_compare_exchange_strong_explicit(pdb->data + offset, &expected,
+	    round, memory_order_relaxed, memory_order_relaxed))
+		return (0);
+
+	if (next != NULL)
+		atomic_fetch_or_explicit(next + offset / FRONTIER_BITS,
+		    1ull << offset % FRONTIER_BITS, memory_order_relaxed);
+
+	return (1);
+}
+
+/*
+ * Release the scatter buffers sc.
+ */
+static void
+scatter_free(struct scatter *sc)
+{
+	int i;
+
+	if (sc == NULL)
+		return;
+
+	for (i = 0; i < sc->n_buffer; i++) {
+		free(sc->buffers[i].fill);
+		free(sc->buffers[i].entries);
+	}
+
+	free(sc);
+}
+
+/*
+ * Allocate scatter buffers for pdb using at most pdb_scatter bytes
+ * for the entries.  Return NULL if pdb_scatter is too small for the
+ * PDB or if the buffers cannot be allocated.
+ */
+static struct scatter *
+scatter_allocate(const struct patterndb *pdb)
+{
+	struct scatter *sc;
+	size_t size = search_space_size(&pdb->aux), n_bucket, per_bucket;
+	int i, shift;
+
+	/* grow the spans until the buckets are large enough */
+	for (shift = 0; (size_t)1 << shift < SCATTER_SPAN; shift++)
+		;
+
+	for (;; shift++) {
+		/* offsets into spans must fit an unsigned */
+		if (shift > 32)
+			return (NULL);
+
+		n_bucket = (size + ((size_t)1 << shift) - 1) >> shift;
+		per_bucket = pdb_scatter / (pdb_jobs * n_bucket * sizeof *sc->buffers[0].entries);
+		if (per_bucket >= SCATTER_MIN)
+			break;
+	}
+
+	sc = malloc(sizeof *sc + pdb_jobs * sizeof *sc->buffers);
+	if (sc == NULL)
+		return (NULL);
+
+	sc->n_bucket = n_bucket;
+	sc->cap = per_bucket;
+	sc->n_buffer = pdb_jobs;
+	sc->shift = shift;
+
+	for (i = 0; i < sc->n_buffer; i++) {
+		sc->buffers[i].busy = 0;
+		sc->buffers[i].fill = calloc(n_bucket, sizeof *sc->buffers[i].fill);
+		sc->buffers[i].entries = malloc(n_bucket * per_bucket * sizeof *sc->buffers[i].entries);
+		if (sc->buffers[i].fill == NULL || sc->buffers[i].entries == NULL) {
+			free(sc->buffers[i].fill);
+			free(sc->buffers[i].entries);
+			sc->n_buffer = i;
+			scatter_free(sc);
+
+			return (NULL);
+		}
+	}
+
+	return (sc);
+}
+
+/*
+ * Claim a scatter buffer for the calling worker.  As there are as many
+ * buffers as threads, a free buffer is always found.
+ */
+static struct scatter_buffer *
+scatter_claim(struct scatter *sc)
+{
+	int i;
+
+	for (i = 0;; i = (i + 1) % sc->n_buffer)
+		if (!atomic_exchange_explicit(&sc->buffers[i].busy, 1, memory_order_acquire))
+			return (sc->buffers + i);
+}
+
+static void
+scatter_release(struct scatter_buffer *buf)
+{
+	atomic_store_explicit(&buf->busy, 0, memory_order_release);
+}
+
+/*
+ * Apply the entries in bucket of buf and empty the bucket.  Return the
+ * number of entries updated.
+ */
+static size_t
+scatter_apply(struct pdbgen_config *cfg, struct scatter_buffer *buf, size_t bucket)
+{
+	struct scatter *sc = cfg->scatter;
+	size_t i, base = bucket << sc->shift, updated = 0;
+	const unsigned *entries = buf->entries + bucket * sc->cap;
+
+	for (i = 0; i < buf->fill[bucket]; i++)
+		updated += frontier_update(cfg->pcfg.pdb, cfg->next, base + entries[i], cfg->round);
+
+	buf->fill[bucket] = 0;
+
+	return (updated);
+}
+
+/*
+ * Append the entry at offset to buf, applying its bucket first if it
+ * is full.  Return the number of entries updated.
+ */
+static size_t
+scatter_add(struct pdbgen_config *cfg, struct scatter_buffer *buf, size_t offset)
+{
+	struct scatter *sc = cfg->scatter;
+	size_t bucket = offset >> sc->shift, updated = 0;
+
+	if (buf->fill[bucket] == sc->cap)
+		updated = scatter_apply(cfg, buf, bucket);
+
+	buf->entries[bucket * sc->cap + buf->fill[bucket]++] =
+	    offset & (((size_t)1 << sc->shift) - 1);
+
+	return (updated);
+}
+
+/*
+ * Apply bucket of all scatter buffers.  This is the second pass of
+ * push rounds with scatter buffers, called through parallel_for().
+ */
+static void
+scatter_apply_all(void *cfgarg, size_t bucket)
+{
+	struct pdbgen_config *cfg = cfgarg;
+	size_t updated = 0;
+	int i;
+
+	for (i = 0; i < cfg->scatter->n_buffer; i++)
+		updated += scatter_apply(cfg, cfg->scatter->buffers + i, bucket);
+
+	cfg->updated += updated;
+}
+
+/*
+ * Compute the index of the configuration reached from p by moving the
+ * tile at m->dest to m->zloc and store it in dist.  idx is the index
+ * of p with idx->map set.  Instead of computing the index from
+ * scratch, only the change made by the move is accounted for, see
+ * compute_index_diff().  p is restored afterwards except for the
+ * location of the zero tile, which does not matter to us as the first
+ * move of each successor puts it where needed.
+ */
+static inline void
+successor_index(const struct index_aux *aux, struct index *dist,
+    const struct index *idx, struct puzzle *p, const struct move *m)
+{
+	unsigned tile;
+
+	move(p, m->zloc);
+	tile = p->grid[m->dest];
+	move(p, m->dest);
+
+	*dist = *idx;
+	compute_index_diff(aux, dist, p, tile);
+
+	move(p, m->zloc);
+}
+
+/*
+ * Turn p, a configuration for the cohort of idx with permutation index
+ * *cur, into the configuration for idx->pidx and set *cur to it.  If
+ * *cur is (permindex)-1, p is not valid yet.  In the factorial number
+ * system used for permutation indices, the least significant digit
+ * selects the square of the first tile among the squares of the map,
+ * the other tiles taking the remaining squares in order.  So if the
+ * two permutation indices differ in this digit only, the first tile
+ * moves to its new square and the tiles on the squares in between
+ * shift over by one square, the other tiles staying where they are.
+ * The tables are traversed in order of pidx, so this is the common
+ * case.  Otherwise, the configuration is rebuilt with
+ * invert_index_rest().
+ */
+static void
+step_permutation(const struct index_aux *aux, struct puzzle *p,
+    const struct index *idx, permindex *cur)
+{
+	tileset between;
+	unsigned first = tileset_get_least(tileset_remove(aux->ts, ZERO_TILE));
+	unsigned from, to, sq, carry, tile;
+
+	if (*cur == (permindex)-1 || *cur / aux->n_tile != idx->pidx / aux->n_tile) {
+		invert_index_rest(aux, p, idx);
+		*cur = idx->pidx;
+		return;
+	}
+
+	from = p->tiles[first];
+	to = tileset_get_least(rankselect(idx->map, idx->pidx % aux->n_tile));
+
+	if (from < to) {
+		/* each tile takes the square of its predecessor, the first tile ends up on to */
+		between = tileset_difference(tileset_least(to + 1), tileset_least(from));
+		for (between = tileset_intersect(between, idx->map); tileset_count(between) > 1;
+		    between = tileset_remove_least(between)) {
+			sq = tileset_get_least(between);
+			tile = p->grid[tileset_get_least(tileset_remove_least(between))];
+			p->grid[sq] = tile;
+			p->tiles[tile] = sq;
+		}
+
+		p->grid[to] = first;
+		p->tiles[first] = to;
+	} else {
+		/* each tile takes the square of its successor, starting with the first tile on to */
+		between = tileset_difference(tileset_least(from + 1), tileset_least(to));
+		carry = first;
+		for (between = tileset_intersect(between, idx->map); !tileset_empty(between);
+		    between = tileset_remove_least(between)) {
+			sq = tileset_get_least(between);
+			tile = p->grid[sq];
+			p->grid[sq] = carry;
+			p->tiles[carry] = sq;
+			carry = tile;
+		}
+	}
+
+	*cur = idx->pidx;
+}
+
+/*
+ * Update the PDB for configuration p by finding all positions we can
+ * move to from the equivalence class represented by idx that are marked
+ * as UNREACHED and then setting them to round.  idx->map must be set.
+ * Record the positions in the frontier bitmap next unless it is NULL.
+ * If buf is not NULL, append the positions to it instead.  Return the
+ * number of entries updated.
+ */
+static size_t
+update_pdb_entry(struct pdbgen_config *cfg, struct scatter_buffer *buf,
+    const struct index *idx, struct puzzle *p, const struct move *moves, size_t n_move)
+{
+	struct patterndb *pdb = cfg->pcfg.pdb;
+	struct index dist[MAX_MOVES];
+	size_t i, updated = 0;
+
+	for (i = 0; i < n_move; i++) {
+		successor_index(&pdb->aux, dist + i, idx, p, moves + i);
+		if (buf == NULL)
+			pdb_prefetch(pdb, dist + i);
+	}
+
+	for (i = 0; i < n_move; i++)
+		if (buf == NULL)
+			updated += frontier_update(pdb, cfg->next,
+			    index_offset(&pdb->aux, dist + i), cfg->round);
+		else
+			updated += scatter_add(cfg, buf, index_offset(&pdb->aux, dist + i));
+
+	return (updated);
+}
+
+/*
+ * Generate one round of the PDB where round > 0 for the permutation
+ * indices from idx->pidx to end of the cohort of idx.  It is safe to
+ * execute this in parallel on the same dataset.
  */
 static void
-generate_cohort(void *cfgarg, struct index *idx)
+generate_cohort(void *cfgarg, struct index *idx, permindex end)
 {
 	struct move moves[MAX_MOVES];
 	struct pdbgen_config *cfg = cfgarg;
 	struct patterndb *pdb = cfg->pcfg.pdb;
 	struct puzzle p;
+	struct scatter_buffer *buf = NULL;
 	size_t n_eqclass = eqclass_count(&pdb->aux, idx->maprank),
-	    n_move, count = 0;
+	    n_move, updated = 0, offset, limit, i;
+	unsigned long long word;
+	permindex begin = idx->pidx, cur = (permindex)-1;
 	int round = cfg->round;
 	tileset map = tileset_unrank(pdb->aux.n_tile, idx->maprank);
 
@@ -97,18 +445,146 @@ generate_cohort(void *cfgarg, struct index *idx)
 		return;
 
 	invert_index_map(&pdb->aux, &p, idx);
+	idx->map = map;
+	if (cfg->scatter != NULL)
+		buf = scatter_claim(cfg->scatter);
 
 	for (idx->eqidx = 0; idx->eqidx < n_eqclass; idx->eqidx++) {
 		n_move = generate_moves(moves, eqclass_from_index(&pdb->aux, idx));
-		for (idx->pidx = 0; idx->pidx < pdb->aux.n_perm; idx->pidx++)
-			if (pdb_lookup(pdb, idx) == round - 1) {
-				count++;
-				invert_index_rest(&pdb->aux, &p, idx);
-				update_pdb_entry(pdb, &p, moves, n_move, round);
+
+		if (cfg->frontier == NULL) {
+			for (idx->pidx = begin; idx->pidx < end; idx->pidx++)
+				if (pdb_lookup(pdb, idx) == round - 1) {
+					step_permutation(&pdb->aux, &p, idx, &cur);
+					updated += update_pdb_entry(cfg, buf, idx, &p, moves, n_move);
+				}
+
+			continue;
+		}
+
+		/* visit the bits for this equivalence class in the frontier */
+		idx->pidx = begin;
+		offset = index_offset(&pdb->aux, idx);
+		limit = offset + (end - begin);
+		for (i = offset / FRONTIER_BITS; i * FRONTIER_BITS < limit; i++) {
+			word = atomic_load_explicit(cfg->frontier + i, memory_order_relaxed);
+			if (i * FRONTIER_BITS < offset)
+				word &= ~0ull << offset % FRONTIER_BITS;
+
+			if ((i + 1) * FRONTIER_BITS > limit)
+				word &= ~(~0ull << limit % FRONTIER_BITS);
+
+			for (; word != 0; word &= word - 1) {
+				idx->pidx = begin + i * FRONTIER_BITS + ctzll(word) - offset;
+				step_permutation(&pdb->aux, &p, idx, &cur);
+				updated += update_pdb_entry(cfg, buf, idx, &p, moves, n_move);
 			}
+		}
 	}
 
-	cfg->count += count;
+	if (buf != NULL)
+		scatter_release(buf);
+
+	cfg->updated += updated;
+}
+
+/*
+ * Determine if any of the positions we can move to from configuration
+ * p with index idx with the given moves is at distance round.  As
+ * moves can be undone, these are exactly the positions p can be
+ * reached from.  idx->map must be set.
+ */
+static int
+has_neighbour(struct patterndb *pdb, const struct index *idx, struct puzzle *p,
+    const struct move *moves, size_t n_move, int round)
+{
+	struct index dist[MAX_MOVES];
+	size_t i;
+
+	for (i = 0; i < n_move; i++) {
+		successor_index(&pdb->aux, dist + i, idx, p, moves + i);
+		pdb_prefetch(pdb, dist + i);
+	}
+
+	for (i = 0; i < n_move; i++)
+		if (pdb_lookup(pdb, dist + i) == round)
+			return (1);
+
+	return (0);
+}
+
+/*
+ * Generate one cohort of one round of the PDB by pulling: instead of
+ * expanding the entries of round - 1, visit the entries still
+ * UNREACHED and set them to round if one of their neighbours is at
+ * round - 1.  Only the entry visited is written to, so the writes are
+ * sequential and no two threads write to the same entry.  Like
+ * generate_cohort(), this handles the permutation indices from
+ * idx->pidx to end.  It is safe to execute this in parallel on the
+ * same dataset.
+ */
+static void
+pull_cohort(void *cfgarg, struct index *idx, permindex end)
+{
+	struct move moves[MAX_MOVES];
+	struct pdbgen_config *cfg = cfgarg;
+	struct patterndb *pdb = cfg->pcfg.pdb;
+	struct puzzle p;
+	size_t n_eqclass = eqclass_count(&pdb->aux, idx->maprank),
+	    n_move, updated = 0, offset, i;
+	permindex begin = idx->pidx, cur = (permindex)-1;
+	int round = cfg->round;
+	tileset map = tileset_unrank(pdb->aux.n_tile, idx->maprank);
+
+	/* the entries reached in this round are those generate_cohort() skips */
+	if ((tileset_parity(map) ^ pdb->aux.solved_parity) != (round & 1))
+		return;
+
+	invert_index_map(&pdb->aux, &p, idx);
+	idx->map = map;
+
+	for (idx->eqidx = 0; idx->eqidx < n_eqclass; idx->eqidx++) {
+		n_move = generate_moves(moves, eqclass_from_index(&pdb->aux, idx));
+		idx->pidx = 0;
+		offset = index_offset(&pdb->aux, idx);
+
+		for (i = begin; i < end; i++) {
+			if (atomic_load_explicit(pdb->data + offset + i, memory_order_relaxed) != UNREACHED)
+				continue;
+
+			idx->pidx = i;
+			step_permutation(&pdb->aux, &p, idx, &cur);
+			if (!has_neighbour(pdb, idx, &p, moves, n_move, round - 1))
+				continue;
+
+			atomic_store_explicit(pdb->data + offset + i, round, memory_order_relaxed);
+			if (cfg->next != NULL)
+				atomic_fetch_or_explicit(cfg->next + (offset + i) / FRONTIER_BITS,
+				    1ull << (offset + i) % FRONTIER_BITS, memory_order_relaxed);
+
+			updated++;
+		}
+	}
+
+	cfg->updated += updated;
+}
+
+/*
+ * Compute the number of entries in pdb whose distance has parity 0
+ * and 1 and store them in sizes.
+ */
+static void
+parity_sizes(size_t sizes[2], const struct patterndb *pdb)
+{
+	tsrank maprank;
+	tileset map;
+
+	sizes[0] = sizes[1] = 0;
+	for (maprank = 0; maprank < pdb->aux.n_maprank; maprank++) {
+		map = tileset_unrank(pdb->aux.n_tile, maprank);
+		sizes[tileset_parity(map) ^ pdb->aux.solved_parity] +=
+		    eqclass_count(&pdb->aux, maprank) * pdb->aux.n_perm;
+	}
 }
 
 /*
@@ -117,29 +593,100 @@ generate_cohort(void *cfgarg, struct index *idx)
  * updates are written to f after each round.  This function returns
  * the number of rounds needed to fill the PDB.  This number is one
  * higher than the highest distance encountered.  Up to jobs threads
- * are used to compute the PDB in parallel.
+ * are used to compute the PDB in parallel.  Rounds with a small
+ * frontier only visit the frontier, see FRONTIER_SPARSE.  Rounds with
+ * fewer entries left to reach than entries in the frontier pull
+ * instead of push, see PULL_FACTOR.  If pdb_scatter is set, push
+ * rounds collect the entries reached in scatter buffers of at most
+ * that many bytes before writing them.  Status updates give the
+ * direction of each round and mark rounds that only visited the
+ * frontier with an asterisk.
  */
 extern int
 pdb_generate(struct patterndb *pdb, FILE *f)
 {
 	struct pdbgen_config cfg;
 	struct index idx;
+	_Atomic unsigned long long *bitmaps[2], *cur = NULL, *next;
+	size_t size = search_space_size(&pdb->aux), n_words, offset;
+	size_t frontier = 1, last_frontier = 1, expected, sizes[2], reached[2] = { 1, 0 }, unreached;
+	int pull;
 
 	cfg.pcfg.pdb = pdb;
-	cfg.pcfg.worker = generate_cohort;
+	cfg.pcfg.split = 1;
 	cfg.round = 0;
+	cfg.scatter = pdb_scatter != 0 ? scatter_allocate(pdb) : NULL;
+	if (pdb_scatter != 0 && cfg.scatter == NULL && f != NULL)
+		fprintf(f, "Cannot allocate scatter buffers, writing directly\n");
+
+	/* if the bitmaps cannot be allocated, always scan the whole PDB */
+	n_words = (size + FRONTIER_BITS - 1) / FRONTIER_BITS;
+	bitmaps[0] = calloc(n_words, sizeof *bitmaps[0]);
+	bitmaps[1] = calloc(n_words, sizeof *bitmaps[1]);
+	if (bitmaps[0] == NULL || bitmaps[1] == NULL) {
+		free(bitmaps[0]);
+		free(bitmaps[1]);
+		bitmaps[0] = bitmaps[1] = NULL;
+	}
 
 	pdb_clear(pdb);
 	compute_index(&pdb->aux, &idx, &solved_puzzle);
 	pdb_update(pdb, &idx, 0);
+	parity_sizes(sizes, pdb);
+
+	if (bitmaps[0] != NULL) {
+		offset = index_offset(&pdb->aux, &idx);
+		cur = bitmaps[0];
+		cur[offset / FRONTIER_BITS] = 1ull << offset % FRONTIER_BITS;
+	}
 
 	do {
-		cfg.count = 0;
 		cfg.round++;
-		pdb_iterate_parallel(&cfg.pcfg);
+
+		/* assume the frontier grows or shrinks as much as last round */
+		expected = frontier * frontier / last_frontier;
+		if (bitmaps[0] != NULL && expected < size / FRONTIER_SPARSE)
+			next = cur == bitmaps[0] ? bitmaps[1] : bitmaps[0];
+		else
+			next = NULL;
+
+		/*
+		 * Entries reached this round have the parity of round.  If
+		 * the frontier is in a bitmap, pushing saves the scan.
+		 */
+		unreached = sizes[cfg.round & 1] - reached[cfg.round & 1];
+		if (cur != NULL)
+			unreached += size / PULL_SCAN;
+
+		pull = unreached < frontier * PULL_FACTOR;
+
+		cfg.pcfg.worker = pull ? pull_cohort : generate_cohort;
+		cfg.frontier = pull ? NULL : cur;
+		cfg.next = next;
+		cfg.updated = 0;
+		if (frontier != 0) {
+			pdb_iterate_parallel(&cfg.pcfg);
+			if (!pull && cfg.scatter != NULL)
+				parallel_for(scatter_apply_all, &cfg, cfg.scatter->n_bucket);
+		}
+
 		if (f != NULL)
-			fprintf(f, "%3d: %20zu\n", cfg.round - 1, cfg.count);
-	} while (cfg.count != 0);
+			fprintf(f, "%3d: %20zu %s%s\n", cfg.round - 1, frontier,
+			    pull ? "pull" : "push", cfg.frontier != NULL ? " *" : "");
+
+		/* the bitmap of this round's frontier is reused for the round after next */
+		if (cur != NULL)
+			memset(cur, 0, n_words * sizeof *cur);
+
+		cur = next;
+		reached[cfg.round & 1] += cfg.updated;
+		last_frontier = frontier;
+		frontier = cfg.updated;
+	} while (last_frontier != 0);
+
+	free(bitmaps[0]);
+	free(bitmaps[1]);
+	scatter_free(cfg.scatter);
 
 	return (cfg.round);
 }
@@ -29,16 +29,18 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "hugepage.h"
 #include "tileset.h"
 #include "index.h"
 #include "pdb.h"
 #include "parallel.h"
 
 /*
- * Identify the equivalence classes of the cohort given by idx.
+ * Identify the equivalence classes of the cohort given by idx for the
+ * permutation indices from idx->pidx to end.
  */
 static void
-identify_worker(void *cfgarg, struct index *idx)
+identify_worker(void *cfgarg, struct index *idx, permindex end)
 {
 	struct parallel_config *cfg = cfgarg;
 	struct index_aux *aux = &cfg->pdb->aux;
@@ -50,7 +52,8 @@ identify_worker(void *cfgarg, struct index *idx)
 	if (n_eqclass == 1)
 		return;
 
-	for (pidx = 0; pidx < n_perm; pidx++) {
+	/* table points to the entry for idx->pidx */
+	for (pidx = 0; pidx < end - idx->pidx; pidx++) {
 		min = table[pidx];
 		for (eqidx = 1; eqidx < n_eqclass; eqidx++) {
 			entry = table[eqidx * n_perm + pidx];
@@ -70,6 +73,7 @@ move_tables(struct patterndb *pdb)
 {
 	struct index idx;
 	size_t n_maprank = pdb->aux.n_maprank, n_perm = pdb->aux.n_perm;
+	size_t oldsize = search_space_size(&pdb->aux);
 	void *oldloc, *newloc, *newdata;
 
 	idx.pidx = 0;
@@ -82,6 +86,11 @@ move_tables(struct patterndb *pdb)
 	}
 
 	make_index_aux(&pdb->aux, tileset_remove(pdb->aux.ts, ZERO_TILE));
+	if (pdb->huge != HUGE_NONE) {
+		huge_shrink(pdb->data, oldsize, search_space_size(&pdb->aux), pdb->huge);
+		return;
+	}
+
 	newdata = realloc(pdb->data, search_space_size(&pdb->aux));
 	if (newdata != NULL)
 		pdb->data = newdata;
@@ -105,6 +114,7 @@ pdb_identify(struct patterndb *pdb)
 	assert(!pdb->mapped);
 
 	cfg.pdb = pdb;
+	cfg.split = 1;
 	cfg.worker = identify_worker;
 
 	pdb_iterate_parallel(&cfg);
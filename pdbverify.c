@@ -129,21 +129,22 @@ struct verify_config {
 };
 
 /*
- * Verify one cohort of the PDB.  Set cfg->result to 1 if the PDB was
- * found to be inconsistent.
+ * Verify the permutation indices from idx->pidx to end of one cohort
+ * of the PDB.  Set cfg->result to 1 if the PDB was found to be
+ * inconsistent.
  */
 static void
-verify_cohort(void *cfgarg, struct index *idx)
+verify_cohort(void *cfgarg, struct index *idx, permindex end)
 {
 	struct verify_config *cfg = cfgarg;
 	struct patterndb *pdb = cfg->pcfg.pdb;
 	size_t i, j, n_eqclass = eqclass_count(&pdb->aux, idx->maprank),
-	    n_perm = pdb->aux.n_perm;
+	    begin = idx->pidx;
 	int result = 0;
 
 	for (i = 0; i < n_eqclass; i++) {
 		idx->eqidx = i;
-		for (j = 0; j < n_perm; j++) {
+		for (j = begin; j < end; j++) {
 			idx->pidx = j;
 			result |= verify_entry(pdb, idx, cfg->f);
 		}
@@ -166,6 +167,7 @@ pdb_verify(struct patterndb *pdb, FILE *f)
 	struct verify_config cfg;
 
 	cfg.pcfg.pdb = pdb;
+	cfg.pcfg.split = 1;
 	cfg.pcfg.worker = verify_cohort;
 	cfg.result = 0;
 	cfg.f = f;
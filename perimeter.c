@@ -0,0 +1,497 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* perimeter.c -- perimeter search around the solved configuration */
+
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "compact.h"
+#include "perimeter.h"
+#include "puzzle.h"
+
+/*
+ * The bits of hi not holding any tiles.  These hold the high bits of
+ * the distance of a perimeter node.
+ */
+#define HI_SPARE (~0ull << 60)
+
+/*
+ * Store cp with distance d into node.
+ */
+static inline void
+set_node(struct compact_puzzle *node, const struct compact_puzzle *cp, int d)
+{
+	node->lo = cp->lo & ~MOVE_MASK | d & MOVE_MASK;
+	node->hi = cp->hi & ~HI_SPARE | (unsigned long long)d >> 4 << 60;
+}
+
+/*
+ * Return the distance stored in node.
+ */
+static inline int
+node_distance(const struct compact_puzzle *node)
+{
+	return (move_mask(node) | node->hi >> 60 << 4);
+}
+
+/*
+ * Compute the hash of configuration cp, ignoring the bits holding the
+ * distance.
+ */
+static inline unsigned long long
+node_hash(const struct compact_puzzle *cp)
+{
+	unsigned long long hash;
+
+	hash = (cp->lo & ~MOVE_MASK) * 0x9e3779b97f4a7c15ull;
+	hash = (hash ^ cp->hi & ~HI_SPARE) * 0xc2b2ae3d27d4eb4full;
+
+	return (hash ^ hash >> 32);
+}
+
+/*
+ * Return the number of slots of a hash table for n nodes.  A load
+ * factor of at most 1/2 keeps the probe sequences short.
+ */
+static size_t
+table_size(size_t n)
+{
+	size_t slots;
+
+	for (slots = 1; slots < 2 * n; slots *= 2)
+		;
+
+	return (slots);
+}
+
+/*
+ * Append the nodes in layer with distance d to per->nodes.  On error,
+ * return -1 and set errno.  per is unchanged in this case.
+ */
+static int
+add_layer(struct perimeter *per, const struct cp_slice *layer, int d)
+{
+	struct compact_puzzle *nodes;
+	size_t i;
+
+	if (layer->len == 0)
+		return (0);
+
+	nodes = realloc(per->nodes, (per->n_nodes + layer->len) * sizeof *nodes);
+	if (nodes == NULL)
+		return (-1);
+
+	per->nodes = nodes;
+	for (i = 0; i < layer->len; i++)
+		set_node(per->nodes + per->n_nodes + i, layer->data + i, d);
+
+	per->n_nodes += layer->len;
+
+	return (0);
+}
+
+/*
+ * Turn the list of nodes in per->nodes into a hash table with linear
+ * probing.  Empty slots are all zero, which no configuration packs to.
+ * On error, return -1 and set errno.  per is unchanged in this case.
+ */
+static int
+make_table(struct perimeter *per)
+{
+	struct compact_puzzle *table;
+	size_t i, j, slots = table_size(per->n_nodes);
+
+	table = calloc(slots, sizeof *table);
+	if (table == NULL)
+		return (-1);
+
+	for (i = 0; i < per->n_nodes; i++) {
+		j = node_hash(per->nodes + i) & slots - 1;
+		while (table[j].lo != 0 || table[j].hi != 0)
+			j = j + 1 & slots - 1;
+
+		table[j] = per->nodes[i];
+	}
+
+	free(per->nodes);
+	per->nodes = table;
+	per->mask = slots - 1;
+
+	return (0);
+}
+
+/*
+ * Allocate an empty perimeter.  On error, return NULL and set errno.
+ */
+static struct perimeter *
+perimeter_allocate(int radius)
+{
+	struct perimeter *per;
+
+	per = malloc(sizeof *per);
+	if (per == NULL)
+		return (NULL);
+
+	per->nodes = NULL;
+	per->mask = 0;
+	per->n_nodes = 0;
+	per->radius = radius;
+	per->mapped = 0;
+
+	return (per);
+}
+
+/*
+ * Generate a perimeter of the given radius around the solved
+ * configuration.  If f is not NULL, print the size of each layer to f.
+ * On error, return NULL and set errno.
+ */
+extern struct perimeter *
+perimeter_generate(int radius, FILE *f)
+{
+	struct perimeter *per;
+	struct cp_slice old_cps, new_cps;
+	struct compact_puzzle cp;
+	int d, error;
+
+	if (radius < 0 || radius > PERIMETER_MAX_RADIUS) {
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	per = perimeter_allocate(radius);
+	if (per == NULL)
+		return (NULL);
+
+	cps_init(&new_cps);
+	pack_puzzle(&cp, &solved_puzzle);
+	cps_append(&new_cps, &cp);
+
+	for (d = 0;; d++) {
+		if (add_layer(per, &new_cps, d) != 0)
+			goto fail;
+
+		if (f != NULL)
+			fprintf(f, "Perimeter layer %2d: %zu configurations\n", d, new_cps.len);
+
+		if (d == radius)
+			break;
+
+		old_cps = new_cps;
+		cps_init(&new_cps);
+		cps_round(&new_cps, &old_cps);
+		cps_free(&old_cps);
+	}
+
+	if (make_table(per) != 0)
+		goto fail;
+
+	cps_free(&new_cps);
+
+	return (per);
+
+fail:	error = errno;
+	cps_free(&new_cps);
+	perimeter_free(per);
+	errno = error;
+
+	return (NULL);
+}
+
+/*
+ * Relabel the tiles of p such that a lower bound for the distance
+ * between p and the configuration from which relabel was computed can
+ * be looked up in a PDB catalogue.  Tile t becomes tile relabel[t].
+ */
+static void
+relabel_puzzle(struct puzzle *restrict q, const struct puzzle *restrict p,
+    const unsigned char relabel[TILE_COUNT])
+{
+	size_t t;
+
+	for (t = 0; t < TILE_COUNT; t++) {
+		q->tiles[relabel[t]] = p->tiles[t];
+		q->grid[p->tiles[t]] = relabel[t];
+	}
+}
+
+/*
+ * Search backwards from the solved configuration towards p and return
+ * a perimeter of all nodes whose distance from p is estimated to not
+ * exceed bound minus their distance from the solved configuration.
+ * The perimeter grows layer by layer as long as the next layer is
+ * expected to fit into size bytes.
+ *
+ * The distance from p is estimated using cat by relabeling the tiles
+ * such that p becomes the solved configuration.  This requires the
+ * zero tile of p to be in its solved location.  If it is not, p is
+ * first brought into a configuration p' where it is, moving the zero
+ * tile up and left, and the k moves needed are subtracted from the
+ * estimated distance from p'.  If f is not NULL, print a summary to f.
+ * On error, return NULL and set errno.
+ */
+extern struct perimeter *
+perimeter_towards(struct pdb_catalogue *cat, const struct puzzle *p,
+    size_t bound, size_t size, FILE *f)
+{
+	struct perimeter *per;
+	struct cp_slice old_cps, new_cps;
+	struct compact_puzzle cp;
+	struct puzzle q, r;
+	size_t i, j, k, t, n, h, zloc;
+	int d, error;
+	unsigned char relabel[TILE_COUNT];
+
+	per = perimeter_allocate(0);
+	if (per == NULL)
+		return (NULL);
+
+	q = *p;
+	for (k = 0; zloc = zero_location(&q), zloc != 0; k++)
+		move(&q, zloc >= 5 ? zloc - 5 : zloc - 1);
+
+	for (t = 0; t < TILE_COUNT; t++)
+		relabel[t] = q.tiles[t];
+
+	cps_init(&new_cps);
+	relabel_puzzle(&r, &solved_puzzle, relabel);
+	if (catalogue_hval(cat, &r) <= bound + k) {
+		pack_puzzle(&cp, &solved_puzzle);
+		cps_append(&new_cps, &cp);
+	}
+
+	for (d = 0;; d++) {
+		if (add_layer(per, &new_cps, d) != 0)
+			goto fail;
+
+		/*
+		 * Each node has at most three children.  Building the
+		 * table needs the list of nodes and the table at once.
+		 */
+		n = per->n_nodes + 3 * new_cps.len;
+		if (d == PERIMETER_MAX_RADIUS || d >= bound || new_cps.len == 0
+		    || (n + table_size(n) + new_cps.len) * sizeof cp > size)
+			break;
+
+		old_cps = new_cps;
+		cps_init(&new_cps);
+		cps_round(&new_cps, &old_cps);
+		cps_free(&old_cps);
+
+		/* keep only the children within the bound */
+		for (i = j = 0; i < new_cps.len; i++) {
+			unpack_puzzle(&q, new_cps.data + i);
+			relabel_puzzle(&r, &q, relabel);
+			h = catalogue_hval(cat, &r);
+			if (d + 1 + h <= bound + k)
+				new_cps.data[j++] = new_cps.data[i];
+		}
+
+		new_cps.len = j;
+	}
+
+	per->radius = d;
+	if (make_table(per) != 0)
+		goto fail;
+
+	cps_free(&new_cps);
+
+	if (f != NULL)
+		fprintf(f, "Searched backwards to depth %d, keeping %zu configurations.\n",
+		    d, per->n_nodes);
+
+	return (per);
+
+fail:	error = errno;
+	cps_free(&new_cps);
+	perimeter_free(per);
+	errno = error;
+
+	return (NULL);
+}
+
+/*
+ * Release all storage associated with per.
+ */
+extern void
+perimeter_free(struct perimeter *per)
+{
+	if (per->mapped)
+		munmap(per->nodes - 1, (per->mask + 2) * sizeof *per->nodes);
+	else
+		free(per->nodes);
+
+	free(per);
+}
+
+/*
+ * Write per to perfile.  The file holds a header slot with the radius
+ * in lo and the number of nodes in hi, followed by the hash table as
+ * is, so it can be mapped with perimeter_mmap().  Return 0 on success.
+ * On error, return -1 and set errno.
+ */
+extern int
+perimeter_store(FILE *perfile, const struct perimeter *per)
+{
+	struct compact_puzzle header;
+	size_t count;
+	int error;
+
+	header.lo = per->radius;
+	header.hi = per->n_nodes;
+
+	count = fwrite(&header, sizeof header, 1, perfile);
+	if (count == 1)
+		count += fwrite(per->nodes, sizeof *per->nodes, per->mask + 1, perfile);
+
+	if (count != per->mask + 2) {
+		error = errno;
+
+		/* tell apart end of medium from IO error */
+		if (!ferror(perfile))
+			errno = ENOSPC;
+		else
+			errno = error;
+
+		return (-1);
+	}
+
+	fflush(perfile);
+
+	return (0);
+}
+
+/*
+ * Load a perimeter written by perimeter_store() from file descriptor
+ * fd by mapping it into memory.  On error, return NULL and set errno.
+ */
+extern struct perimeter *
+perimeter_mmap(int fd)
+{
+	struct perimeter *per;
+	struct compact_puzzle *map;
+	struct stat st;
+	size_t slots;
+	int error;
+
+	if (fstat(fd, &st) != 0)
+		return (NULL);
+
+	/* the table must have a power of two slots */
+	slots = st.st_size / sizeof *map;
+	if (st.st_size % sizeof *map != 0 || slots < 2 || (slots - 1 & slots - 2) != 0) {
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		return (NULL);
+
+	if (map->lo > PERIMETER_MAX_RADIUS || map->hi > (slots - 1) / 2) {
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	per = perimeter_allocate(map->lo);
+	if (per == NULL) {
+		error = errno;
+		munmap(map, st.st_size);
+		errno = error;
+		return (NULL);
+	}
+
+	per->nodes = map + 1;
+	per->mask = slots - 2;
+	per->n_nodes = map->hi;
+	per->mapped = 1;
+
+	return (per);
+}
+
+/*
+ * Return the distance of p from the solved configuration if p is in
+ * per.  Otherwise, return PERIMETER_MISS.
+ */
+extern int
+perimeter_distance(const struct perimeter *per, const struct puzzle *p)
+{
+	struct compact_puzzle cp;
+	const struct compact_puzzle *node;
+	size_t i;
+
+	pack_puzzle(&cp, p);
+	for (i = node_hash(&cp) & per->mask;; i = i + 1 & per->mask) {
+		node = per->nodes + i;
+		if ((node->hi & ~HI_SPARE) == cp.hi && (node->lo & ~MOVE_MASK) == cp.lo)
+			return (node_distance(node));
+
+		if (node->lo == 0 && node->hi == 0)
+			return (PERIMETER_MISS);
+	}
+}
+
+/*
+ * Store a shortest path from p, which must be in per, to the solved
+ * configuration in moves.  The path is perimeter_distance(per, p)
+ * moves long.
+ */
+extern void
+perimeter_path(unsigned char *moves, const struct perimeter *per,
+    const struct puzzle *p)
+{
+	struct puzzle q = *p;
+	size_t i, n_moves, zloc;
+	int dist;
+	const signed char *next;
+
+	dist = perimeter_distance(per, &q);
+	assert(dist != PERIMETER_MISS);
+
+	/* walk down the layers of the perimeter */
+	for (; dist > 0; dist--) {
+		zloc = zero_location(&q);
+		n_moves = move_count(zloc);
+		next = get_moves(zloc);
+
+		for (i = 0; i < n_moves; i++) {
+			move(&q, next[i]);
+			if (perimeter_distance(per, &q) == dist - 1)
+				break;
+
+			move(&q, zloc);
+		}
+
+		assert(i < n_moves);
+		*moves++ = next[i];
+	}
+}
@@ -0,0 +1,82 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* perimeter.h -- perimeter search around the solved configuration */
+
+#ifndef PERIMETER_H
+#define PERIMETER_H
+
+#include <stdio.h>
+
+#include "catalogue.h"
+#include "compact.h"
+#include "puzzle.h"
+
+/*
+ * A perimeter holds all configurations within radius moves of the
+ * solved configuration, found by breadth-first search.  Each node has
+ * its distance from the solved configuration stored in place of the
+ * move mask (low bits) and in the four unused bits at the top of hi
+ * (high bits).  Hence, the radius cannot exceed PERIMETER_MAX_RADIUS.
+ * The nodes form a hash table of mask + 1 slots with linear probing.
+ * Searching towards the
+ * perimeter, a search can stop as soon as it reaches a perimeter node,
+ * the rest of the way being known.  A perimeter made by
+ * perimeter_towards() only holds the nodes a search with a given bound
+ * can reach.
+ */
+struct perimeter {
+	struct compact_puzzle *nodes;
+	size_t mask, n_nodes;
+	int radius, mapped;
+};
+
+enum {
+	PERIMETER_MAX_RADIUS = 255,
+	PERIMETER_MISS = -1,
+};
+
+/* perimeter.c */
+extern struct perimeter	*perimeter_generate(int, FILE *);
+extern struct perimeter	*perimeter_towards(struct pdb_catalogue *, const struct puzzle *, size_t, size_t, FILE *);
+extern void	perimeter_free(struct perimeter *);
+extern int	perimeter_store(FILE *, const struct perimeter *);
+extern struct perimeter	*perimeter_mmap(int);
+extern int	perimeter_distance(const struct perimeter *, const struct puzzle *);
+extern void	perimeter_path(unsigned char *, const struct perimeter *, const struct puzzle *);
+
+/*
+ * Return a lower bound for the distance of a configuration with the
+ * zero tile at zloc that is not in per: the least distance beyond the
+ * radius of per whose parity matches the distance of the zero tile
+ * from its solved location.
+ */
+static inline int
+perimeter_hval(const struct perimeter *per, size_t zloc)
+{
+	return (per->radius + 1 + ((per->radius + 1 ^ zloc / 5 ^ zloc % 5) & 1));
+}
+
+#endif /* PERIMETER_H */
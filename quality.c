@@ -25,14 +25,17 @@
 
 /* pdbquality.c -- determine PDB quality */
 
+#include <math.h>
 #include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "puzzle.h"
 #include "tileset.h"
 #include "index.h"
 #include "pdb.h"
+#include "parallel.h"
 #include "statistics.h"
 
 /*
@@ -51,6 +54,76 @@ region_bias(tileset ts)
 	return (bias);
 }
 
+/*
+ * Configuration for quality_sum().  The worker stores the contribution
+ * of each equivalence class in terms, indexed by the number of the
+ * equivalence class.
+ */
+struct quality_config {
+	struct parallel_config pcfg;
+	double *terms;
+};
+
+/*
+ * Sum up the contributions the worker function computes for all
+ * equivalence classes of pdb, using pdb_jobs threads.  The terms are
+ * added in the order of the equivalence classes, so the result does
+ * not depend on the number of threads.  If memory is insufficient,
+ * return NAN.
+ */
+static double
+quality_sum(struct patterndb *pdb, void (*worker)(void *, struct index *, permindex))
+{
+	struct quality_config cfg;
+	size_t i, n_eqclass = eqclass_total(&pdb->aux);
+	double sum = 0.0;
+
+	cfg.pcfg.pdb = pdb;
+	cfg.pcfg.split = 0;
+	cfg.pcfg.worker = worker;
+	cfg.terms = malloc(n_eqclass * sizeof *cfg.terms);
+	if (cfg.terms == NULL)
+		return (NAN);
+
+	pdb_iterate_parallel(&cfg.pcfg);
+
+	for (i = 0; i < n_eqclass; i++)
+		sum += cfg.terms[i];
+
+	free(cfg.terms);
+
+	return (sum);
+}
+
+/*
+ * Compute the contributions of the cohort idx to eta.  This is the
+ * worker function for pdb_eta().
+ */
+static void
+eta_worker(void *cfgarg, struct index *idx, permindex end)
+{
+	struct quality_config *cfg = cfgarg;
+	const struct index_aux *aux = &cfg->pcfg.pdb->aux;
+
+	for (idx->eqidx = 0; idx->eqidx < eqclass_count(aux, idx->maprank); idx->eqidx++) {
+		size_t i, histogram[PDB_HISTOGRAM_LEN];
+		double map_eta = 0.0;
+		const unsigned char *table;
+
+		memset(histogram, 0, sizeof histogram);
+		table = (const unsigned char *)pdb_entry_pointer(cfg->pcfg.pdb, idx);
+
+		for (i = 0; i < end; i++)
+			histogram[table[i]]++;
+
+		for (i = 0; i < PDB_HISTOGRAM_LEN; i++)
+			map_eta = histogram[PDB_HISTOGRAM_LEN - i - 1] + map_eta / B;
+
+		cfg->terms[index_offset(aux, idx) / aux->n_perm] =
+		    map_eta * region_bias(eqclass_from_index(aux, idx));
+	}
+}
+
 /*
  * Compute eta for a complete pattern database.  Works for both APDBs
  * and ZPDBs.
@@ -59,32 +132,36 @@ extern double
 pdb_eta(struct patterndb *pdb)
 {
 	const struct index_aux *aux = &pdb->aux;
-	double eta = 0.0;
-	struct index idx;
+	double eta;
 
-	idx.pidx = 0;
-
-	for (idx.maprank = 0; idx.maprank < aux->n_maprank; idx.maprank++)
-		for (idx.eqidx = 0; idx.eqidx < eqclass_count(aux, idx.maprank); idx.eqidx++) {
-			size_t i, histogram[PDB_HISTOGRAM_LEN];
-			double map_eta = 0.0;
-			const unsigned char *table;
-
-			memset(histogram, 0, sizeof histogram);
-			table = (const unsigned char *)pdb_entry_pointer(pdb, &idx);
+	eta = quality_sum(pdb, eta_worker);
+	eta /= (double)aux->n_perm * (TILE_COUNT - aux->n_tile) * (double)aux->n_maprank;
 
-			for (i = 0; i < aux->n_perm; i++)
-				histogram[table[i]]++;
+	return (eta);
+}
 
-			for (i = 0; i < PDB_HISTOGRAM_LEN; i++)
-				map_eta = histogram[PDB_HISTOGRAM_LEN - i - 1] + map_eta / B;
+/*
+ * Compute the contributions of the cohort idx to the average h value.
+ * This is the worker function for pdb_h_average().
+ */
+static void
+h_average_worker(void *cfgarg, struct index *idx, permindex end)
+{
+	struct quality_config *cfg = cfgarg;
+	const struct index_aux *aux = &cfg->pcfg.pdb->aux;
 
-			eta += map_eta * region_bias(eqclass_from_index(aux, &idx));
-		}
+	for (idx->eqidx = 0; idx->eqidx < eqclass_count(aux, idx->maprank); idx->eqidx++) {
+		long long unsigned map_hsum = 0;
+		size_t i;
+		const unsigned char *table;
 
-	eta /= (double)aux->n_perm * (TILE_COUNT - aux->n_tile) * (double)aux->n_maprank;
+		table = (const unsigned char *)pdb_entry_pointer(cfg->pcfg.pdb, idx);
+		for (i = 0; i < end; i++)
+			map_hsum += table[i];
 
-	return (eta);
+		cfg->terms[index_offset(aux, idx) / aux->n_perm] =
+		    map_hsum * region_bias(eqclass_from_index(aux, idx));
+	}
 }
 
 /*
@@ -95,24 +172,9 @@ extern double
 pdb_h_average(struct patterndb *pdb)
 {
 	const struct index_aux *aux = &pdb->aux;
-	double hsum = 0.0;
-	struct index idx;
-
-	idx.pidx = 0;
-
-	for (idx.maprank = 0; idx.maprank < aux->n_maprank; idx.maprank++)
-		for (idx.eqidx = 0; idx.eqidx < eqclass_count(aux, idx.maprank); idx.eqidx++) {
-			long long unsigned map_hsum = 0;
-			size_t i;
-			const unsigned char *table;
-
-			table = (const unsigned char *)pdb_entry_pointer(pdb, &idx);
-			for (i = 0; i < aux->n_perm; i++)
-				map_hsum += table[i];
-
-			hsum += map_hsum * region_bias(eqclass_from_index(aux, &idx));
-		}
+	double hsum;
 
+	hsum = quality_sum(pdb, h_average_worker);
 	hsum /= (double)aux->n_perm * (TILE_COUNT - aux->n_tile) * (double)aux->n_maprank;
 
 	return (hsum);
@@ -0,0 +1,797 @@
+/* ranktbl.c -- tables generated by util/rankgen.c */
+/* DO NOT EDIT */
+
+#include <tileset.h>
+
+const tsrank
+rank_tails[1 << RANK_SPLIT1] = {
+	      0,       0,       1,       0,       2,       1,       2,       0,
+	      3,       3,       4,       1,       5,       2,       3,       0,
+	      4,       6,       7,       4,       8,       5,       6,       1,
+	      9,       7,       8,       2,       9,       3,       4,       0,
+	      5,      10,      11,      10,      12,      11,      12,       5,
+	     13,      13,      14,       6,      15,       7,       8,       1,
+	     14,      16,      17,       9,      18,      10,      11,       2,
+	     19,      12,      13,       3,      14,       4,       5,       0,
+	      6,      15,      16,      20,      17,      21,      22,      15,
+	     18,      23,      24,      16,      25,      17,      18,       6,
+	     19,      26,      27,      19,      28,      20,      21,       7,
+	     29,      22,      23,       8,      24,       9,      10,       1,
+	     20,      30,      31,      25,      32,      26,      27,      11,
+	     33,      28,      29,      12,      30,      13,      14,       2,
+	     34,      31,      32,      15,      33,      16,      17,       3,
+	     34,      18,      19,       4,      20,       5,       6,       0,
+	      7,      21,      22,      35,      23,      36,      37,      35,
+	     24,      38,      39,      36,      40,      37,      38,      21,
+	     25,      41,      42,      39,      43,      40,      41,      22,
+	     44,      42,      43,      23,      44,      24,      25,       7,
+	     26,      45,      46,      45,      47,      46,      47,      26,
+	     48,      48,      49,      27,      50,      28,      29,       8,
+	     49,      51,      52,      30,      53,      31,      32,       9,
+	     54,      33,      34,      10,      35,      11,      12,       1,
+	     27,      50,      51,      55,      52,      56,      57,      36,
+	     53,      58,      59,      37,      60,      38,      39,      13,
+	     54,      61,      62,      40,      63,      41,      42,      14,
+	     64,      43,      44,      15,      45,      16,      17,       2,
+	     55,      65,      66,      46,      67,      47,      48,      18,
+	     68,      49,      50,      19,      51,      20,      21,       3,
+	     69,      52,      53,      22,      54,      23,      24,       4,
+	     55,      25,      26,       5,      27,       6,       7,       0,
+	      8,      28,      29,      56,      30,      57,      58,      70,
+	     31,      59,      60,      71,      61,      72,      73,      56,
+	     32,      62,      63,      74,      64,      75,      76,      57,
+	     65,      77,      78,      58,      79,      59,      60,      28,
+	     33,      66,      67,      80,      68,      81,      82,      61,
+	     69,      83,      84,      62,      85,      63,      64,      29,
+	     70,      86,      87,      65,      88,      66,      67,      30,
+	     89,      68,      69,      31,      70,      32,      33,       8,
+	     34,      71,      72,      90,      73,      91,      92,      71,
+	     74,      93,      94,      72,      95,      73,      74,      34,
+	     75,      96,      97,      75,      98,      76,      77,      35,
+	     99,      78,      79,      36,      80,      37,      38,       9,
+	     76,     100,     101,      81,     102,      82,      83,      39,
+	    103,      84,      85,      40,      86,      41,      42,      10,
+	    104,      87,      88,      43,      89,      44,      45,      11,
+	     90,      46,      47,      12,      48,      13,      14,       1,
+	     35,      77,      78,     105,      79,     106,     107,      91,
+	     80,     108,     109,      92,     110,      93,      94,      49,
+	     81,     111,     112,      95,     113,      96,      97,      50,
+	    114,      98,      99,      51,     100,      52,      53,      15,
+	     82,     115,     116,     101,     117,     102,     103,      54,
+	    118,     104,     105,      55,     106,      56,      57,      16,
+	    119,     107,     108,      58,     109,      59,      60,      17,
+	    110,      61,      62,      18,      63,      19,      20,       2,
+	     83,     120,     121,     111,     122,     112,     113,      64,
+	    123,     114,     115,      65,     116,      66,      67,      21,
+	    124,     117,     118,      68,     119,      69,      70,      22,
+	    120,      71,      72,      23,      73,      24,      25,       3,
+	    125,     121,     122,      74,     123,      75,      76,      26,
+	    124,      77,      78,      27,      79,      28,      29,       4,
+	    125,      80,      81,      30,      82,      31,      32,       5,
+	     83,      33,      34,       6,      35,       7,       8,       0,
+	      9,      36,      37,      84,      38,      85,      86,     126,
+	     39,      87,      88,     127,      89,     128,     129,     126,
+	     40,      90,      91,     130,      92,     131,     132,     127,
+	     93,     133,     134,     128,     135,     129,     130,      84,
+	     41,      94,      95,     136,      96,     137,     138,     131,
+	     97,     139,     140,     132,     141,     133,     134,      85,
+	     98,     142,     143,     135,     144,     136,     137,      86,
+	    145,     138,     139,      87,     140,      88,      89,      36,
+	     42,      99,     100,     146,     101,     147,     148,     141,
+	    102,     149,     150,     142,     151,     143,     144,      90,
+	    103,     152,     153,     145,     154,     146,     147,      91,
+	    155,     148,     149,      92,     150,      93,      94,      37,
+	    104,     156,     157,     151,     158,     152,     153,      95,
+	    159,     154,     155,      96,     156,      97,      98,      38,
+	    160,     157,     158,      99,     159,     100,     101,      39,
+	    160,     102,     103,      40,     104,      41,      42,       9,
+	     43,     105,     106,     161,     107,     162,     163,     161,
+	    108,     164,     165,     162,     166,     163,     164,     105,
+	    109,     167,     168,     165,     169,     166,     167,     106,
+	    170,     168,     169,     107,     170,     108,     109,      43,
+	    110,     171,     172,     171,     173,     172,     173,     110,
+	    174,     174,     175,     111,     176,     112,     113,      44,
+	    175,     177,     178,     114,     179,     115,     116,      45,
+	    180,     117,     118,      46,     119,      47,      48,      10,
+	    111,     176,     177,     181,     178,     182,     183,     120,
+	    179,     184,     185,     121,     186,     122,     123,      49,
+	    180,     187,     188,     124,     189,     125,     126,      50,
+	    190,     127,     128,      51,     129,      52,      53,      11,
+	    181,     191,     192,     130,     193,     131,     132,      54,
+	    194,     133,     134,      55,     135,      56,      57,      12,
+	    195,     136,     137,      58,     138,      59,      60,      13,
+	    139,      61,      62,      14,      63,      15,      16,       1,
+	     44,     112,     113,     182,     114,     183,     184,     196,
+	    115,     185,     186,     197,     187,     198,     199,     140,
+	    116,     188,     189,     200,     190,     201,     202,     141,
+	    191,     203,     204,     142,     205,     143,     144,      64,
+	    117,     192,     193,     206,     194,     207,     208,     145,
+	    195,     209,     210,     146,     211,     147,     148,      65,
+	    196,     212,     213,     149,     214,     150,     151,      66,
+	    215,     152,     153,      67,     154,      68,      69,      17,
+	    118,     197,     198,     216,     199,     217,     218,     155,
+	    200,     219,     220,     156,     221,     157,     158,      70,
+	    201,     222,     223,     159,     224,     160,     161,      71,
+	    225,     162,     163,      72,     164,      73,      74,      18,
+	    202,     226,     227,     165,     228,     166,     167,      75,
+	    229,     168,     169,      76,     170,      77,      78,      19,
+	    230,     171,     172,      79,     173,      80,      81,      20,
+	    174,      82,      83,      21,      84,      22,      23,       2,
+	    119,     203,     204,     231,     205,     232,     233,     175,
+	    206,     234,     235,     176,     236,     177,     178,      85,
+	    207,     237,     238,     179,     239,     180,     181,      86,
+	    240,     182,     183,      87,     184,      88,      89,      24,
+	    208,     241,     242,     185,     243,     186,     187,      90,
+	    244,     188,     189,      91,     190,      92,      93,      25,
+	    245,     191,     192,      94,     193,      95,      96,      26,
+	    194,      97,      98,      27,      99,      28,      29,       3,
+	    209,     246,     247,     195,     248,     196,     197,     100,
+	    249,     198,     199,     101,     200,     102,     103,      30,
+	    250,     201,     202,     104,     203,     105,     106,      31,
+	    204,     107,     108,      32,     109,      33,      34,       4,
+	    251,     205,     206,     110,     207,     111,     112,      35,
+	    208,     113,     114,      36,     115,      37,      38,       5,
+	    209,     116,     117,      39,     118,      40,      41,       6,
+	    119,      42,      43,       7,      44,       8,       9,       0,
+	     10,      45,      46,     120,      47,     121,     122,     210,
+	     48,     123,     124,     211,     125,     212,     213,     252,
+	     49,     126,     127,     214,     128,     215,     216,     253,
+	    129,     217,     218,     254,     219,     255,     256,     210,
+	     50,     130,     131,     220,     132,     221,     222,     257,
+	    133,     223,     224,     258,     225,     259,     260,     211,
+	    134,     226,     227,     261,     228,     262,     263,     212,
+	    229,     264,     265,     213,     266,     214,     215,     120,
+	     51,     135,     136,     230,     137,     231,     232,     267,
+	    138,     233,     234,     268,     235,     269,     270,     216,
+	    139,     236,     237,     271,     238,     272,     273,     217,
+	    239,     274,     275,     218,     276,     219,     220,     121,
+	    140,     240,     241,     277,     242,     278,     279,     221,
+	    243,     280,     281,     222,     282,     223,     224,     122,
+	    244,     283,     284,     225,     285,     226,     227,     123,
+	    286,     228,     229,     124,     230,     125,     126,      45,
+	     52,     141,     142,     245,     143,     246,     247,     287,
+	    144,     248,     249,     288,     250,     289,     290,     231,
+	    145,     251,     252,     291,     253,     292,     293,     232,
+	    254,     294,     295,     233,     296,     234,     235,     127,
+	    146,     255,     256,     297,     257,     298,     299,     236,
+	    258,     300,     301,     237,     302,     238,     239,     128,
+	    259,     303,     304,     240,     305,     241,     242,     129,
+	    306,     243,     244,     130,     245,     131,     132,      46,
+	    147,     260,     261,     307,     262,     308,     309,     246,
+	    263,     310,     311,     247,     312,     248,     249,     133,
+	    264,     313,     314,     250,     315,     251,     252,     134,
+	    316,     253,     254,     135,     255,     136,     137,      47,
+	    265,     317,     318,     256,     319,     257,     258,     138,
+	    320,     259,     260,     139,     261,     140,     141,      48,
+	    321,     262,     263,     142,     264,     143,     144,      49,
+	    265,     145,     146,      50,     147,      51,      52,      10,
+	     53,     148,     149,     266,     150,     267,     268,     322,
+	    151,     269,     270,     323,     271,     324,     325,     266,
+	    152,     272,     273,     326,     274,     327,     328,     267,
+	    275,     329,     330,     268,     331,     269,     270,     148,
+	    153,     276,     277,     332,     278,     333,     334,     271,
+	    279,     335,     336,     272,     337,     273,     274,     149,
+	    280,     338,     339,     275,     340,     276,     277,     150,
+	    341,     278,     279,     151,     280,     152,     153,      53,
+	    154,     281,     282,     342,     283,     343,     344,     281,
+	    284,     345,     346,     282,     347,     283,     284,     154,
+	    285,     348,     349,     285,     350,     286,     287,     155,
+	    351,     288,     289,     156,     290,     157,     158,      54,
+	    286,     352,     353,     291,     354,     292,     293,     159,
+	    355,     294,     295,     160,     296,     161,     162,      55,
+	    356,     297,     298,     163,     299,     164,     165,      56,
+	    300,     166,     167,      57,     168,      58,      59,      11,
+	    155,     287,     288,     357,     289,     358,     359,     301,
+	    290,     360,     361,     302,     362,     303,     304,     169,
+	    291,     363,     364,     305,     365,     306,     307,     170,
+	    366,     308,     309,     171,     310,     172,     173,      60,
+	    292,     367,     368,     311,     369,     312,     313,     174,
+	    370,     314,     315,     175,     316,     176,     177,      61,
+	    371,     317,     318,     178,     319,     179,     180,      62,
+	    320,     181,     182,      63,     183,      64,      65,      12,
+	    293,     372,     373,     321,     374,     322,     323,     184,
+	    375,     324,     325,     185,     326,     186,     187,      66,
+	    376,     327,     328,     188,     329,     189,     190,      67,
+	    330,     191,     192,      68,     193,      69,      70,      13,
+	    377,     331,     332,     194,     333,     195,     196,      71,
+	    334,     197,     198,      72,     199,      73,      74,      14,
+	    335,     200,     201,      75,     202,      76,      77,      15,
+	    203,      78,      79,      16,      80,      17,      18,       1,
+	     54,     156,     157,     294,     158,     295,     296,     378,
+	    159,     297,     298,     379,     299,     380,     381,     336,
+	    160,     300,     301,     382,     302,     383,     384,     337,
+	    303,     385,     386,     338,     387,     339,     340,     204,
+	    161,     304,     305,     388,     306,     389,     390,     341,
+	    307,     391,     392,     342,     393,     343,     344,     205,
+	    308,     394,     395,     345,     396,     346,     347,     206,
+	    397,     348,     349,     207,     350,     208,     209,      81,
+	    162,     309,     310,     398,     311,     399,     400,     351,
+	    312,     401,     402,     352,     403,     353,     354,     210,
+	    313,     404,     405,     355,     406,     356,     357,     211,
+	    407,     358,     359,     212,     360,     213,     214,      82,
+	    314,     408,     409,     361,     410,     362,     363,     215,
+	    411,     364,     365,     216,     366,     217,     218,      83,
+	    412,     367,     368,     219,     369,     220,     221,      84,
+	    370,     222,     223,      85,     224,      86,      87,      19,
+	    163,     315,     316,     413,     317,     414,     415,     371,
+	    318,     416,     417,     372,     418,     373,     374,     225,
+	    319,     419,     420,     375,     421,     376,     377,     226,
+	    422,     378,     379,     227,     380,     228,     229,      88,
+	    320,     423,     424,     381,     425,     382,     383,     230,
+	    426,     384,     385,     231,     386,     232,     233,      89,
+	    427,     387,     388,     234,     389,     235,     236,      90,
+	    390,     237,     238,      91,     239,      92,      93,      20,
+	    321,     428,     429,     391,     430,     392,     393,     240,
+	    431,     394,     395,     241,     396,     242,     243,      94,
+	    432,     397,     398,     244,     399,     245,     246,      95,
+	    400,     247,     248,      96,     249,      97,      98,      21,
+	    433,     401,     402,     250,     403,     251,     252,      99,
+	    404,     253,     254,     100,     255,     101,     102,      22,
+	    405,     256,     257,     103,     258,     104,     105,      23,
+	    259,     106,     107,      24,     108,      25,      26,       2,
+	    164,     322,     323,     434,     324,     435,     436,     406,
+	    325,     437,     438,     407,     439,     408,     409,     260,
+	    326,     440,     441,     410,     442,     411,     412,     261,
+	    443,     413,     414,     262,     415,     263,     264,     109,
+	    327,     444,     445,     416,     446,     417,     418,     265,
+	    447,     419,     420,     266,     421,     267,     268,     110,
+	    448,     422,     423,     269,     424,     270,     271,     111,
+	    425,     272,     273,     112,     274,     113,     114,      27,
+	    328,     449,     450,     426,     451,     427,     428,     275,
+	    452,     429,     430,     276,     431,     277,     278,     115,
+	    453,     432,     433,     279,     434,     280,     281,     116,
+	    435,     282,     283,     117,     284,     118,     119,      28,
+	    454,     436,     437,     285,     438,     286,     287,     120,
+	    439,     288,     289,     121,     290,     122,     123,      29,
+	    440,     291,     292,     124,     293,     125,     126,      30,
+	    294,     127,     128,      31,     129,      32,      33,       3,
+	    329,     455,     456,     441,     457,     442,     443,     295,
+	    458,     444,     445,     296,     446,     297,     298,     130,
+	    459,     447,     448,     299,     449,     300,     301,     131,
+	    450,     302,     303,     132,     304,     133,     134,      34,
+	    460,     451,     452,     305,     453,     306,     307,     135,
+	    454,     308,     309,     136,     310,     137,     138,      35,
+	    455,     311,     312,     139,     313,     140,     141,      36,
+	    314,     142,     143,      37,     144,      38,      39,       4,
+	    461,     456,     457,     315,     458,     316,     317,     145,
+	    459,     318,     319,     146,     320,     147,     148,      40,
+	    460,     321,     322,     149,     323,     150,     151,      41,
+	    324,     152,     153,      42,     154,      43,      44,       5,
+	    461,     325,     326,     155,     327,     156,     157,      45,
+	    328,     158,     159,      46,     160,      47,      48,       6,
+	    329,     161,     162,      49,     163,      50,      51,       7,
+	    164,      52,      53,       8,      54,       9,      10,       0,
+};
+
+const tsrank
+rank_mids[RANK_SPLIT1 + 1][1 << RANK_SPLIT2 - RANK_SPLIT1] = {
+	      0,      11,      12,      77,      13,      89,      90,     363,
+	     14,     102,     103,     441,     104,     453,     454,    1364,
+	     15,     116,     117,     532,     118,     544,     545,    1728,
+	    119,     557,     558,    1806,     559,    1818,    1819,    4367,
+	     16,     131,     132,     637,     133,     649,     650,    2183,
+	    134,     662,     663,    2261,     664,    2273,    2274,    5732,
+	    135,     676,     677,    2352,     678,    2364,    2365,    6096,
+	    679,    2377,    2378,    6174,    2379,    6186,    6187,   12375,
+	     17,     147,     148,     757,     149,     769,     770,    2743,
+	    150,     782,     783,    2821,     784,    2833,    2834,    7552,
+	    151,     796,     797,    2912,     798,    2924,    2925,    7916,
+	    799,    2937,    2938,    7994,    2939,    8006,    8007,   16743,
+	    152,     811,     812,    3017,     813,    3029,    3030,    8371,
+	    814,    3042,    3043,    8449,    3044,    8461,    8462,   18108,
+	    815,    3056,    3057,    8540,    3058,    8552,    8553,   18472,
+	   3059,    8565,    8566,   18550,    8567,   18562,   18563,   31823,
+
+	      0,      55,      66,     275,      78,     341,     352,     990,
+	     91,     419,     430,    1276,     442,    1342,    1353,    2992,
+	    105,     510,     521,    1640,     533,    1706,    1717,    3993,
+	    546,    1784,    1795,    4279,    1807,    4345,    4356,    7997,
+	    120,     615,     626,    2095,     638,    2161,    2172,    5358,
+	    651,    2239,    2250,    5644,    2262,    5710,    5721,   11000,
+	    665,    2330,    2341,    6008,    2353,    6074,    6085,   12001,
+	   2366,    6152,    6163,   12287,    6175,   12353,   12364,   19437,
+	    136,     735,     746,    2655,     758,    2721,    2732,    7178,
+	    771,    2799,    2810,    7464,    2822,    7530,    7541,   15368,
+	    785,    2890,    2901,    7828,    2913,    7894,    7905,   16369,
+	   2926,    7972,    7983,   16655,    7995,   16721,   16732,   27445,
+	    800,    2995,    3006,    8283,    3018,    8349,    8360,   17734,
+	   3031,    8427,    8438,   18020,    8450,   18086,   18097,   30448,
+	   3045,    8518,    8529,   18384,    8541,   18450,   18461,   31449,
+	   8554,   18528,   18539,   31735,   18551,   31801,   31812,   43747,
+
+	      0,     165,     220,     660,     286,     880,     935,    1947,
+	    364,    1166,    1221,    2662,    1287,    2882,    2937,    4950,
+	    455,    1530,    1585,    3663,    1651,    3883,    3938,    6952,
+	   1729,    4169,    4224,    7667,    4290,    7887,    7942,   11385,
+	    560,    1985,    2040,    5028,    2106,    5248,    5303,    9955,
+	   2184,    5534,    5589,   10670,    5655,   10890,   10945,   16390,
+	   2275,    5898,    5953,   11671,    6019,   11891,   11946,   18392,
+	   6097,   12177,   12232,   19107,   12298,   19327,   19382,   24255,
+	    680,    2545,    2600,    6848,    2666,    7068,    7123,   14323,
+	   2744,    7354,    7409,   15038,    7475,   15258,   15313,   24398,
+	   2835,    7718,    7773,   16039,    7839,   16259,   16314,   26400,
+	   7917,   16545,   16600,   27115,   16666,   27335,   27390,   35695,
+	   2940,    8173,    8228,   17404,    8294,   17624,   17679,   29403,
+	   8372,   17910,   17965,   30118,   18031,   30338,   30393,   40700,
+	   8463,   18274,   18329,   31119,   18395,   31339,   31394,   42702,
+	  18473,   31625,   31680,   43417,   31746,   43637,   43692,   48565,
+
+	      0,     330,     495,    1122,     715,    1617,    1782,    2838,
+	   1001,    2332,    2497,    4125,    2717,    4620,    4785,    6270,
+	   1365,    3333,    3498,    6127,    3718,    6622,    6787,    9273,
+	   4004,    7337,    7502,   10560,    7722,   11055,   11220,   12705,
+	   1820,    4698,    4863,    9130,    5083,    9625,    9790,   14278,
+	   5369,   10340,   10505,   15565,   10725,   16060,   16225,   19140,
+	   5733,   11341,   11506,   17567,   11726,   18062,   18227,   22143,
+	  12012,   18777,   18942,   23430,   19162,   23925,   24090,   24145,
+	   2380,    6518,    6683,   13498,    6903,   13993,   14158,   22286,
+	   7189,   14708,   14873,   23573,   15093,   24068,   24233,   30580,
+	   7553,   15709,   15874,   25575,   16094,   26070,   26235,   33583,
+	  16380,   26785,   26950,   34870,   27170,   35365,   35530,   37015,
+	   8008,   17074,   17239,   28578,   17459,   29073,   29238,   38588,
+	  17745,   29788,   29953,   39875,   30173,   40370,   40535,   43450,
+	  18109,   30789,   30954,   41877,   31174,   42372,   42537,   46453,
+	  31460,   43087,   43252,   47740,   43472,   48235,   48400,   43593,
+
+	      0,     462,     792,    1386,    1287,    2178,    2508,    3102,
+	   2002,    3465,    3795,    4818,    4290,    5610,    5940,    6105,
+	   3003,    5467,    5797,    7821,    6292,    8613,    8943,    9537,
+	   7007,    9900,   10230,   11253,   10725,   12045,   12375,   11110,
+	   4368,    8470,    8800,   12826,    9295,   13618,   13948,   15972,
+	  10010,   14905,   15235,   17688,   15730,   18480,   18810,   17545,
+	  11011,   16907,   17237,   20691,   17732,   21483,   21813,   20977,
+	  18447,   22770,   23100,   22693,   23595,   23485,   23815,   19118,
+	   6188,   12838,   13168,   20834,   13663,   21626,   21956,   27412,
+	  14378,   22913,   23243,   29128,   23738,   29920,   30250,   30415,
+	  15379,   24915,   25245,   32131,   25740,   32923,   33253,   33847,
+	  26455,   34210,   34540,   35563,   35035,   36355,   36685,   30558,
+	  16744,   27918,   28248,   37136,   28743,   37928,   38258,   40282,
+	  29458,   39215,   39545,   41998,   40040,   42790,   43120,   36993,
+	  30459,   41217,   41547,   45001,   42042,   45793,   46123,   40425,
+	  42757,   47080,   47410,   42141,   47905,   42933,   43263,   31494,
+
+	      0,     462,     924,    1254,    1716,    2178,    2640,    2541,
+	   3003,    3894,    4356,    4257,    5148,    5181,    5643,    4543,
+	   5005,    6897,    7359,    7689,    8151,    8613,    9075,    7546,
+	   9438,   10329,   10791,    9262,   11583,   10186,   10648,    7546,
+	   8008,   11902,   12364,   14124,   13156,   15048,   15510,   13981,
+	  14443,   16764,   17226,   15697,   18018,   16621,   17083,   12551,
+	  16445,   19767,   20229,   19129,   21021,   20053,   20515,   15554,
+	  22308,   21769,   22231,   17270,   23023,   18194,   18656,   11914,
+	  12376,   19910,   20372,   25564,   21164,   26488,   26950,   26851,
+	  22451,   28204,   28666,   28567,   29458,   29491,   29953,   23991,
+	  24453,   31207,   31669,   31999,   32461,   32923,   33385,   26994,
+	  33748,   34639,   35101,   28710,   35893,   29634,   30096,   19922,
+	  27456,   36212,   36674,   38434,   37466,   39358,   39820,   33429,
+	  38753,   41074,   41536,   35145,   42328,   36069,   36531,   24927,
+	  40755,   44077,   44539,   38577,   45331,   39501,   39963,   27930,
+	  46618,   41217,   41679,   29646,   42471,   30570,   31032,   18102,
+
+	      0,     330,     792,     825,    1716,    1617,    2079,    1540,
+	   3432,    3333,    3795,    2827,    4719,    3619,    4081,    2541,
+	   6435,    6765,    7227,    5830,    8151,    6622,    7084,    4543,
+	   9867,    8338,    8800,    5830,    9724,    6622,    7084,    3906,
+	  11440,   13200,   13662,   12265,   14586,   13057,   13519,    9548,
+	  16302,   14773,   15235,   10835,   16159,   11627,   12089,    6909,
+	  19305,   18205,   18667,   13838,   19591,   14630,   15092,    8911,
+	  21307,   16346,   16808,   10198,   17732,   10990,   11452,    5726,
+	  19448,   24640,   25102,   25135,   26026,   25927,   26389,   20988,
+	  27742,   27643,   28105,   22275,   29029,   23067,   23529,   14917,
+	  30745,   31075,   31537,   25278,   32461,   26070,   26532,   16919,
+	  34177,   27786,   28248,   18206,   29172,   18998,   19460,   10094,
+	  35750,   37510,   37972,   31713,   38896,   32505,   32967,   21924,
+	  40612,   34221,   34683,   23211,   35607,   24003,   24465,   13097,
+	  43615,   37653,   38115,   26214,   39039,   27006,   27468,   15099,
+	  40755,   28722,   29184,   16386,   30108,   17178,   17640,    8106,
+
+	      0,     165,     495,     385,    1287,     880,    1210,     671,
+	   3003,    2167,    2497,    1386,    3289,    1881,    2211,    1035,
+	   6435,    5170,    5500,    3388,    6292,    3883,    4213,    2036,
+	   8008,    5170,    5500,    2751,    6292,    3246,    3576,    1490,
+	  12870,   11605,   11935,    8393,   12727,    8888,    9218,    5039,
+	  14443,   10175,   10505,    5754,   11297,    6249,    6579,    2855,
+	  17875,   13178,   13508,    7756,   14300,    8251,    8581,    3856,
+	  16016,    9538,    9868,    4571,   10660,    5066,    5396,    2050,
+	  24310,   24475,   24805,   19833,   25597,   20328,   20658,   13047,
+	  27313,   21615,   21945,   13762,   22737,   14257,   14587,    7223,
+	  30745,   24618,   24948,   15764,   25740,   16259,   16589,    8224,
+	  27456,   17546,   17876,    8939,   18668,    9434,    9764,    3870,
+	  37180,   31053,   31383,   20769,   32175,   21264,   21594,   11227,
+	  33891,   22551,   22881,   11942,   23673,   12437,   12767,    5235,
+	  37323,   25554,   25884,   13944,   26676,   14439,   14769,    6236,
+	  28392,   15726,   16056,    6951,   16848,    7446,    7776,    2730,
+
+	      0,      55,     220,     121,     715,     341,     506,     199,
+	   2002,    1056,    1221,     485,    1716,     705,     870,     290,
+	   5005,    3058,    3223,    1486,    3718,    1706,    1871,     654,
+	   5005,    2421,    2586,     940,    3081,    1160,    1325,     395,
+	  11440,    8063,    8228,    4489,    8723,    4709,    4874,    2019,
+	  10010,    5424,    5589,    2305,    6084,    2525,    2690,     850,
+	  13013,    7426,    7591,    3306,    8086,    3526,    3691,    1214,
+	   9373,    4241,    4406,    1500,    4901,    1720,    1885,     515,
+	  24310,   19503,   19668,   12497,   20163,   12717,   12882,    6387,
+	  21450,   13432,   13597,    6673,   14092,    6893,    7058,    2670,
+	  24453,   15434,   15599,    7674,   16094,    7894,    8059,    3034,
+	  17381,    8609,    8774,    3320,    9269,    3540,    3705,    1075,
+	  30888,   20439,   20604,   10677,   21099,   10897,   11062,    4399,
+	  22386,   11612,   11777,    4685,   12272,    4905,    5070,    1530,
+	  25389,   13614,   13779,    5686,   14274,    5906,    6071,    1894,
+	  15561,    6621,    6786,    2180,    7281,    2400,    2565,     651,
+
+	      0,      11,      66,      23,     286,      89,     144,      36,
+	   1001,     375,     430,     114,     650,     180,     235,      50,
+	   3003,    1376,    1431,     478,    1651,     544,     599,     141,
+	   2366,     830,     885,     219,    1105,     285,     340,      65,
+	   8008,    4379,    4434,    1843,    4654,    1909,    1964,     596,
+	   5369,    2195,    2250,     674,    2470,     740,     795,     170,
+	   7371,    3196,    3251,    1038,    3471,    1104,    1159,     261,
+	   4186,    1390,    1445,     339,    1665,     405,     460,      81,
+	  19448,   12387,   12442,    6211,   12662,    6277,    6332,    2416,
+	  13377,    6563,    6618,    2494,    6838,    2560,    2615,     730,
+	  15379,    7564,    7619,    2858,    7839,    2924,    2979,     821,
+	   8554,    3210,    3265,     899,    3485,     965,    1020,     201,
+	  20384,   10567,   10622,    4223,   10842,    4289,    4344,    1276,
+	  11557,    4575,    4630,    1354,    4850,    1420,    1475,     306,
+	  13559,    5576,    5631,    1718,    5851,    1784,    1839,     397,
+	   6566,    2070,    2125,     475,    2345,     541,     596,      98,
+
+	      0,       1,      12,       2,      78,      14,      25,       3,
+	    364,      92,     103,      16,     169,      28,      39,       4,
+	   1365,     456,     467,     107,     533,     119,     130,      18,
+	    819,     197,     208,      31,     274,      43,      54,       5,
+	   4368,    1821,    1832,     562,    1898,     574,     585,     123,
+	   2184,     652,     663,     136,     729,     148,     159,      20,
+	   3185,    1016,    1027,     227,    1093,     239,     250,      34,
+	   1379,     317,     328,      47,     394,      59,      70,       6,
+	  12376,    6189,    6200,    2382,    6266,    2394,    2405,     683,
+	   6552,    2472,    2483,     696,    2549,     708,     719,     140,
+	   7553,    2836,    2847,     787,    2913,     799,     810,     154,
+	   3199,     877,     888,     167,     954,     179,     190,      22,
+	  10556,    4201,    4212,    1242,    4278,    1254,    1265,     259,
+	   4564,    1332,    1343,     272,    1409,     284,     295,      37,
+	   5565,    1696,    1707,     363,    1773,     375,     386,      51,
+	   2059,     453,     464,      64,     530,      76,      87,       7,
+
+	      0,       0,       1,       0,      13,       1,       2,       0,
+	     91,      14,      15,       1,      27,       2,       3,       0,
+	    455,     105,     106,      15,     118,      16,      17,       1,
+	    196,      29,      30,       2,      42,       3,       4,       0,
+	   1820,     560,     561,     120,     573,     121,     122,      16,
+	    651,     134,     135,      17,     147,      18,      19,       1,
+	   1015,     225,     226,      31,     238,      32,      33,       2,
+	    316,      45,      46,       3,      58,       4,       5,       0,
+	   6188,    2380,    2381,     680,    2393,     681,     682,     136,
+	   2471,     694,     695,     137,     707,     138,     139,      17,
+	   2835,     785,     786,     151,     798,     152,     153,      18,
+	    876,     165,     166,      19,     178,      20,      21,       1,
+	   4200,    1240,    1241,     256,    1253,     257,     258,      33,
+	   1331,     270,     271,      34,     283,      35,      36,       2,
+	   1695,     361,     362,      48,     374,      49,      50,       3,
+	    452,      62,      63,       4,      75,       5,       6,       0,
+};
+
+const tsrank
+rank_heads[RANK_SPLIT2 + 1][1 << TILE_COUNT - RANK_SPLIT2] = {
+	      0,      18,      19,     189,      20,     208,     209,    1329,
+	     21,     228,     229,    1519,     230,    1538,    1539,    7314,
+	     22,     249,     250,    1729,     251,    1748,    1749,    8644,
+	    252,    1768,    1769,    8834,    1770,    8853,    8854,   33648,
+	     23,     271,     272,    1960,     273,    1979,    1980,   10184,
+	    274,    1999,    2000,   10374,    2001,   10393,   10394,   40963,
+	    275,    2020,    2021,   10584,    2022,   10603,   10604,   42293,
+	   2023,   10623,   10624,   42483,   10625,   42502,   42503,  134595,
+	     24,     294,     295,    2213,     296,    2232,    2233,   11955,
+	    297,    2252,    2253,   12145,    2254,   12164,   12165,   49818,
+	    298,    2273,    2274,   12355,    2275,   12374,   12375,   51148,
+	   2276,   12394,   12395,   51338,   12396,   51357,   51358,  168244,
+	    299,    2295,    2296,   12586,    2297,   12605,   12606,   52688,
+	   2298,   12625,   12626,   52878,   12627,   52897,   52898,  175559,
+	   2299,   12646,   12647,   53088,   12648,   53107,   53108,  176889,
+	  12649,   53127,   53128,  177079,   53129,  177098,  177099,  480699,
+
+	      0,     153,     171,    1122,     190,    1293,    1311,    5967,
+	    210,    1483,    1501,    7107,    1520,    7278,    7296,   26316,
+	    231,    1693,    1711,    8437,    1730,    8608,    8626,   32301,
+	   1750,    8798,    8816,   33441,    8835,   33612,   33630,  100929,
+	    253,    1924,    1942,    9977,    1961,   10148,   10166,   39616,
+	   1981,   10338,   10356,   40756,   10375,   40927,   40945,  127263,
+	   2002,   10548,   10566,   42086,   10585,   42257,   42275,  133248,
+	  10605,   42447,   42465,  134388,   42484,  134559,  134577,  346086,
+	    276,    2177,    2195,   11748,    2214,   11919,   11937,   48471,
+	   2234,   12109,   12127,   49611,   12146,   49782,   49800,  160912,
+	   2255,   12319,   12337,   50941,   12356,   51112,   51130,  166897,
+	  12376,   51302,   51320,  168037,   51339,  168208,  168226,  447033,
+	   2277,   12550,   12568,   52481,   12587,   52652,   52670,  174212,
+	  12607,   52842,   52860,  175352,   52879,  175523,  175541,  473367,
+	  12628,   53052,   53070,  176682,   53089,  176853,  176871,  479352,
+	  53109,  177043,  177061,  480492,  177080,  480663,  480681, 1081557,
+
+	      0,     816,     969,    4692,    1140,    5661,    5814,   20196,
+	   1330,    6801,    6954,   25041,    7125,   26010,   26163,   74460,
+	   1540,    8131,    8284,   31026,    8455,   31995,   32148,   94809,
+	   8645,   33135,   33288,   99654,   33459,  100623,  100776,  245004,
+	   1771,    9671,    9824,   38341,    9995,   39310,   39463,  121143,
+	  10185,   40450,   40603,  125988,   40774,  126957,  127110,  319617,
+	  10395,   41780,   41933,  131973,   42104,  132942,  133095,  339966,
+	  42294,  134082,  134235,  344811,  134406,  345780,  345933,  735318,
+	   2024,   11442,   11595,   47196,   11766,   48165,   48318,  154792,
+	  11956,   49305,   49458,  159637,   49629,  160606,  160759,  420564,
+	  12166,   50635,   50788,  165622,   50959,  166591,  166744,  440913,
+	  51149,  167731,  167884,  445758,  168055,  446727,  446880,  980475,
+	  12397,   52175,   52328,  172937,   52499,  173906,  174059,  467247,
+	  52689,  175046,  175199,  472092,  175370,  473061,  473214, 1055088,
+	  52899,  176376,  176529,  478077,  176700,  479046,  479199, 1075437,
+	 176890,  480186,  480339, 1080282,  480510, 1081251, 1081404, 2042822,
+
+	      0,    3060,    3876,   14688,    4845,   18564,   19380,   53448,
+	   5985,   23409,   24225,   68952,   25194,   72828,   73644,  169728,
+	   7315,   29394,   30210,   89301,   31179,   93177,   93993,  223992,
+	  32319,   98022,   98838,  239496,   99807,  243372,  244188,  489498,
+	   8855,   36709,   37525,  115635,   38494,  119511,  120327,  298605,
+	  39634,  124356,  125172,  314109,  126141,  317985,  318801,  660042,
+	  40964,  130341,  131157,  334458,  132126,  338334,  339150,  714306,
+	 133266,  343179,  343995,  729810,  344964,  733686,  734502, 1306688,
+	  10626,   45564,   46380,  149284,   47349,  153160,  153976,  399552,
+	  48489,  158005,  158821,  415056,  159790,  418932,  419748,  905199,
+	  49819,  163990,  164806,  435405,  165775,  439281,  440097,  959463,
+	 166915,  444126,  444942,  974967,  445911,  978843,  979659, 1797002,
+	  51359,  171305,  172121,  461739,  173090,  465615,  466431, 1034076,
+	 174230,  470460,  471276, 1049580,  472245, 1053456, 1054272, 1967546,
+	 175560,  476445,  477261, 1069929,  478230, 1073805, 1074621, 2021810,
+	 479370, 1078650, 1079466, 2037314, 1080435, 2041190, 2042006, 3267944,
+
+	      0,    8568,   11628,   35700,   15504,   47328,   50388,  113220,
+	  20349,   62832,   65892,  151980,   69768,  163608,  166668,  316710,
+	  26334,   83181,   86241,  206244,   90117,  217872,  220932,  432990,
+	  94962,  233376,  236436,  471750,  240312,  483378,  486438,  814130,
+	  33649,  109515,  112575,  280857,  116451,  292485,  295545,  603534,
+	 121296,  307989,  311049,  642294,  314925,  653922,  656982, 1133900,
+	 127281,  328338,  331398,  696558,  335274,  708186,  711246, 1250180,
+	 340119,  723690,  726750, 1288940,  730626, 1300568, 1303628, 1958196,
+	  42504,  143164,  146224,  381804,  150100,  393432,  396492,  848691,
+	 154945,  408936,  411996,  887451,  415872,  899079,  902139, 1624214,
+	 160930,  429285,  432345,  941715,  436221,  953343,  956403, 1740494,
+	 441066,  968847,  971907, 1779254,  975783, 1790882, 1793942, 2775386,
+	 168245,  455619,  458679, 1016328,  462555, 1027956, 1031016, 1911038,
+	 467400, 1043460, 1046520, 1949798, 1050396, 1961426, 1964486, 3095156,
+	 473385, 1063809, 1066869, 2004062, 1070745, 2015690, 2018750, 3211436,
+	1075590, 2031194, 2034254, 3250196, 2038130, 3261824, 3264884, 4454340,
+
+	      0,   18564,   27132,   68952,   38760,   96084,  104652,  194922,
+	  54264,  134844,  143412,  272442,  155040,  299574,  308142,  488852,
+	  74613,  189108,  197676,  388722,  209304,  415854,  424422,  692342,
+	 224808,  454614,  463182,  769862,  474810,  796994,  805562, 1135498,
+	 100947,  263721,  272289,  559266,  283917,  586398,  594966, 1012112,
+	 299421,  625158,  633726, 1089632,  645354, 1116764, 1125332, 1632918,
+	 319770,  679422,  687990, 1205912,  699618, 1233044, 1241612, 1836408,
+	 715122, 1271804, 1280372, 1913928, 1292000, 1941060, 1949628, 2487576,
+	 134596,  364668,  373236,  804423,  384864,  831555,  840123, 1502426,
+	 400368,  870315,  878883, 1579946,  890511, 1607078, 1615646, 2450108,
+	 420717,  924579,  933147, 1696226,  944775, 1723358, 1731926, 2653598,
+	 960279, 1762118, 1770686, 2731118, 1782314, 2758250, 2766818, 3631642,
+	 447051,  999192, 1007760, 1866770, 1019388, 1893902, 1902470, 2973368,
+	1034892, 1932662, 1941230, 3050888, 1952858, 3078020, 3086588, 4129062,
+	1055241, 1986926, 1995494, 3167168, 2007122, 3194300, 3202868, 4332552,
+	2022626, 3233060, 3241628, 4410072, 3253256, 4437204, 4445772, 5191732,
+
+	      0,   31824,   50388,  107406,   77520,  157794,  176358,  275366,
+	 116280,  235314,  253878,  401336,  281010,  451724,  470288,  628082,
+	 170544,  351594,  370158,  604826,  397290,  655214,  673778,  922012,
+	 436050,  732734,  751298, 1047982,  778430, 1098370, 1116934, 1333514,
+	 245157,  522138,  540702,  924596,  567834,  974984,  993548, 1419432,
+	 606594, 1052504, 1071068, 1545402, 1098200, 1595790, 1614354, 1980160,
+	 660858, 1168784, 1187348, 1748892, 1214480, 1799280, 1817844, 2274090,
+	1253240, 1876800, 1895364, 2400060, 1922496, 2450448, 2469012, 2685592,
+	 346104,  767295,  785859, 1414910,  812991, 1465298, 1483862, 2236622,
+	 851751, 1542818, 1561382, 2362592, 1588514, 2412980, 2431544, 3124226,
+	 906015, 1659098, 1677662, 2566082, 1704794, 2616470, 2635034, 3418156,
+	1743554, 2693990, 2712554, 3544126, 2739686, 3594514, 3613078, 4037670,
+	 980628, 1829642, 1848206, 2885852, 1875338, 2936240, 2954804, 3915576,
+	1914098, 3013760, 3032324, 4041546, 3059456, 4091934, 4110498, 4684316,
+	1968362, 3130040, 3148604, 4245036, 3175736, 4295424, 4313988, 4978246,
+	3214496, 4372944, 4391508, 5104216, 4418640, 5154604, 5173168, 5181736,
+
+	      0,   43758,   75582,  136136,  125970,  211718,  243542,  320892,
+	 203490,  337688,  369512,  488852,  419900,  564434,  596258,  673608,
+	 319770,  541178,  573002,  782782,  623390,  858364,  890188, 1026324,
+	 700910,  984334, 1016158, 1194284, 1066546, 1269866, 1301690, 1320254,
+	 490314,  860948,  892772, 1280202,  943160, 1355784, 1387608, 1672970,
+	1020680, 1481754, 1513578, 1840930, 1563966, 1916512, 1948336, 2025686,
+	1136960, 1685244, 1717068, 2134860, 1767456, 2210442, 2242266, 2378402,
+	1844976, 2336412, 2368236, 2546362, 2418624, 2621944, 2653768, 2464320,
+	 735471, 1351262, 1383086, 2097392, 1433474, 2172974, 2204798, 2817036,
+	1510994, 2298944, 2330768, 2984996, 2381156, 3060578, 3092402, 3377764,
+	1627274, 2502434, 2534258, 3278926, 2584646, 3354508, 3386332, 3730480,
+	2662166, 3480478, 3512302, 3898440, 3562690, 3974022, 4005846, 3816398,
+	1797818, 2822204, 2854028, 3776346, 2904416, 3851928, 3883752, 4377126,
+	2981936, 3977898, 4009722, 4545086, 4060110, 4620668, 4652492, 4521830,
+	3098216, 4181388, 4213212, 4839016, 4263600, 4914598, 4946422, 4874546,
+	4341120, 5040568, 5072392, 5042506, 5122780, 5118088, 5149912, 4425576,
+
+	      0,   48620,   92378,  140998,  167960,  233376,  277134,  308958,
+	 293930,  401336,  445094,  493714,  520676,  586092,  629850,  602888,
+	 497420,  695266,  739024,  846430,  814606,  938808,  982566,  955604,
+	 940576, 1106768, 1150526, 1140360, 1226108, 1232738, 1276496, 1100308,
+	 817190, 1192686, 1236444, 1493076, 1312026, 1585454, 1629212, 1661036,
+	1437996, 1753414, 1797172, 1845792, 1872754, 1938170, 1981928, 1746954,
+	1641486, 2047344, 2091102, 2198508, 2166684, 2290886, 2334644, 2099670,
+	2292654, 2458846, 2502604, 2284426, 2578186, 2376804, 2420562, 1917498,
+	1307504, 2009876, 2053634, 2637142, 2129216, 2729520, 2773278, 3013114,
+	2255186, 2897480, 2941238, 3197870, 3016820, 3290248, 3334006, 3099032,
+	2458676, 3191410, 3235168, 3550586, 3310750, 3642964, 3686722, 3451748,
+	3436720, 3810924, 3854682, 3636504, 3930264, 3728882, 3772640, 3061564,
+	2778446, 3688830, 3732588, 4197232, 3808170, 4289610, 4333368, 4157180,
+	3934140, 4457570, 4501328, 4341936, 4576910, 4434314, 4478072, 3708210,
+	4137630, 4751500, 4795258, 4694652, 4870840, 4787030, 4830788, 4060926,
+	4996810, 4954990, 4998748, 4245682, 5074330, 4338060, 4381818, 3225002,
+
+	      0,   43758,   92378,  119340,  184756,  211718,  260338,  245310,
+	 352716,  396474,  445094,  413270,  537472,  505648,  554268,  448800,
+	 646646,  749190,  797810,  765986,  890188,  858364,  906984,  742730,
+	1058148, 1043120, 1091740,  910690, 1184118, 1003068, 1051688,  768570,
+	1144066, 1395836, 1444456, 1471418, 1536834, 1563796, 1612416, 1389376,
+	1704794, 1748552, 1797172, 1557336, 1889550, 1649714, 1698334, 1265990,
+	1998724, 2101268, 2149888, 1910052, 2242266, 2002430, 2051050, 1559920,
+	2410226, 2187186, 2235806, 1727880, 2328184, 1820258, 1868878, 1258884,
+	1961256, 2539902, 2588522, 2823496, 2680900, 2915874, 2964494, 2741454,
+	2848860, 3100630, 3149250, 2909414, 3241628, 3001792, 3050412, 2410056,
+	3142790, 3453346, 3501966, 3262130, 3594344, 3354508, 3403128, 2703986,
+	3762304, 3539264, 3587884, 2871946, 3680262, 2964324, 3012944, 2076074,
+	3640210, 4099992, 4148612, 3967562, 4240990, 4059940, 4108560, 3350632,
+	4408950, 4244696, 4293316, 3518592, 4385694, 3610970, 3659590, 2573494,
+	4702880, 4597412, 4646032, 3871308, 4738410, 3963686, 4012306, 2867424,
+	4906370, 4148442, 4197062, 3035384, 4289440, 3127762, 3176382, 1994355,
+
+	      0,   31824,   75582,   82212,  167960,  157794,  201552,  159732,
+	 352716,  325754,  369512,  285702,  461890,  361284,  405042,  276012,
+	 705432,  678470,  722228,  579632,  814606,  655214,  698972,  479502,
+	 999362,  823174,  866932,  605472,  959310,  681054,  724812,  446556,
+	1352078, 1383902, 1427660, 1226278, 1520038, 1301860, 1345618,  976922,
+	1704794, 1469820, 1513578, 1102892, 1605956, 1178474, 1222232,  766326,
+	2057510, 1822536, 1866294, 1396822, 1958672, 1472404, 1516162,  969816,
+	2143428, 1640364, 1684122, 1095786, 1776500, 1171368, 1215126,  691713,
+	2496144, 2735980, 2779738, 2578356, 2872116, 2653938, 2697696, 2120988,
+	3056872, 2821898, 2865656, 2246958, 2958034, 2322540, 2366298, 1583516,
+	3409588, 3174614, 3218372, 2540888, 3310750, 2616470, 2660228, 1787006,
+	3495506, 2784430, 2828188, 1912976, 2920566, 1988558, 2032316, 1182027,
+	4056234, 3880046, 3923804, 3187534, 4016182, 3263116, 3306874, 2284426,
+	4200938, 3431076, 3474834, 2410396, 3567212, 2485978, 2529736, 1501797,
+	4553654, 3783792, 3827550, 2704326, 3919928, 2779908, 2823666, 1705287,
+	4104684, 2947868, 2991626, 1831257, 3084004, 1906839, 1950597, 1037817,
+
+	      0,   18564,   50388,   45696,  125970,   96084,  127908,   84456,
+	 293930,  222054,  253878,  161976,  329460,  212364,  244188,  138720,
+	 646646,  515984,  547808,  365466,  623390,  415854,  447678,  255000,
+	 791350,  541824,  573648,  332520,  649230,  382908,  414732,  213333,
+	1352078, 1162630, 1194454,  862886, 1270036,  913274,  945098,  574770,
+	1437996, 1039244, 1071068,  652290, 1146650,  702678,  734502,  383877,
+	1790712, 1333174, 1364998,  855780, 1440580,  906168,  937992,  500157,
+	1608540, 1032138, 1063962,  577677, 1139544,  628065,  659889,  314280,
+	2704156, 2514708, 2546532, 2006952, 2622114, 2057340, 2089164, 1391960,
+	2790074, 2183310, 2215134, 1469480, 2290716, 1519868, 1551692,  874191,
+	3142790, 2477240, 2509064, 1672970, 2584646, 1723358, 1755182,  990471,
+	2752606, 1849328, 1881152, 1067991, 1956734, 1118379, 1150203,  559437,
+	3848222, 3123886, 3155710, 2170390, 3231292, 2220778, 2252602, 1310241,
+	3399252, 2346748, 2378572, 1387761, 2454154, 1438149, 1469973,  729981,
+	3751968, 2640678, 2672502, 1591251, 2748084, 1641639, 1673463,  846261,
+	2916044, 1767609, 1799433,  923781, 1875015,  974169, 1005993,  448876,
+
+	      0,    8568,   27132,   20196,   77520,   47328,   65892,   35700,
+	 203490,  124848,  143412,   74460,  193800,  101592,  120156,   56049,
+	 497420,  328338,  346902,  190740,  397290,  217872,  236436,  110313,
+	 523260,  295392,  313956,  149073,  364344,  176205,  194769,   82383,
+	1144066,  825758,  844322,  510510,  894710,  537642,  556206,  280857,
+	1020680,  615162,  633726,  319617,  684114,  346749,  365313,  156996,
+	1314610,  818652,  837216,  435897,  887604,  463029,  481593,  211260,
+	1013574,  540549,  559113,  250020,  609501,  277152,  295716,  116032,
+	2496144, 1969824, 1988388, 1327700, 2038776, 1354832, 1373396,  771171,
+	2164746, 1432352, 1450916,  809931, 1501304,  837063,  855627,  402153,
+	2458676, 1635842, 1654406,  926211, 1704794,  953343,  971907,  456417,
+	1830764, 1030863, 1049427,  495177, 1099815,  522309,  540873,  216979,
+	3105322, 2133262, 2151826, 1245981, 2202214, 1273113, 1291677,  626961,
+	2328184, 1350633, 1369197,  665721, 1419585,  692853,  711417,  291592,
+	2622114, 1554123, 1572687,  782001, 1623075,  809133,  827697,  345856,
+	1749045,  886653,  905217,  384616,  955605,  411748,  430312,  158536,
+
+	      0,    3060,   11628,    6936,   38760,   18564,   27132,   11781,
+	 116280,   57324,   65892,   27285,   93024,   38913,   47481,   17766,
+	 319770,  173604,  182172,   81549,  209304,   93177,  101745,   38115,
+	 286824,  131937,  140505,   53619,  167637,   65247,   73815,   25081,
+	 817190,  493374,  501942,  252093,  529074,  263721,  272289,  112728,
+	 606594,  302481,  311049,  128232,  338181,  139860,  148428,   51415,
+	 810084,  418761,  427329,  182496,  454461,  194124,  202692,   71764,
+	 531981,  232884,  241452,   87268,  268584,   98896,  107464,   33936,
+	1961256, 1310564, 1319132,  742407, 1346264,  754035,  762603,  357885,
+	1423784,  792795,  801363,  373389,  828495,  385017,  393585,  152362,
+	1627274,  909075,  917643,  427653,  944775,  439281,  447849,  172711,
+	1022295,  478041,  486609,  188215,  513741,  199843,  208411,   67585,
+	2124694, 1228845, 1237413,  598197, 1264545,  609825,  618393,  247324,
+	1342065,  648585,  657153,  262828,  684285,  274456,  283024,   93919,
+	1545555,  764865,  773433,  317092,  800565,  328720,  337288,  114268,
+	 878085,  367480,  376048,  129772,  403180,  141400,  149968,   44562,
+
+	      0,     816,    3876,    1785,   15504,    5661,    8721,    2925,
+	  54264,   21165,   24225,    7770,   35853,   11646,   14706,    4255,
+	 170544,   75429,   78489,   28119,   90117,   31995,   35055,   10240,
+	 128877,   47499,   50559,   15085,   62187,   18961,   22021,    5795,
+	 490314,  245973,  249033,  102732,  260661,  106608,  109668,   36574,
+	 299421,  122112,  125172,   41419,  136800,   45295,   48355,   13110,
+	 415701,  176376,  179436,   61768,  191064,   65644,   68704,   19095,
+	 229824,   81148,   84208,   23940,   95836,   27816,   30876,    7566,
+	1307504,  736287,  739347,  347889,  750975,  351765,  354825,  137521,
+	 789735,  367269,  370329,  142366,  381957,  146242,  149302,   46759,
+	 906015,  421533,  424593,  162715,  436221,  166591,  169651,   52744,
+	 474981,  182095,  185155,   57589,  196783,   61465,   64525,   16421,
+	1225785,  592077,  595137,  237328,  606765,  241204,  244264,   79078,
+	 645525,  256708,  259768,   83923,  271396,   87799,   90859,   23736,
+	 761805,  310972,  314032,  104272,  325660,  108148,  111208,   29721,
+	 364420,  123652,  126712,   34566,  138340,   38442,   41502,    9590,
+
+	      0,     153,     969,     324,    4845,    1293,    2109,     514,
+	  20349,    6138,    6954,    1654,   10830,    2623,    3439,     724,
+	  74613,   26487,   27303,    7639,   31179,    8608,    9424,    2054,
+	  46683,   13453,   14269,    3194,   18145,    4163,    4979,     955,
+	 245157,  101100,  101916,   33973,  105792,   34942,   35758,    9369,
+	 121296,   39787,   40603,   10509,   44479,   11478,   12294,    2495,
+	 175560,   60136,   60952,   16494,   64828,   17463,   18279,    3825,
+	  80332,   22308,   23124,    4965,   27000,    5934,    6750,    1208,
+	 735471,  346257,  347073,  134920,  350949,  135889,  136705,   43018,
+	 366453,  140734,  141550,   44158,  145426,   45127,   45943,   11350,
+	 420717,  161083,  161899,   50143,  165775,   51112,   51928,   12680,
+	 181279,   55957,   56773,   13820,   60649,   14789,   15605,    2979,
+	 591261,  235696,  236512,   76477,  240388,   77446,   78262,   19995,
+	 255892,   82291,   83107,   21135,   86983,   22104,   22920,    4519,
+	 310156,  102640,  103456,   27120,  107332,   28089,   28905,    5849,
+	 122836,   32934,   33750,    6989,   37626,    7958,    8774,    1484,
+
+	      0,      18,     171,      37,    1140,     208,     361,      57,
+	   5985,    1348,    1501,     247,    2470,     418,     571,      78,
+	  26334,    7333,    7486,    1577,    8455,    1748,    1901,     288,
+	  13300,    2888,    3041,     478,    4010,     649,     802,     100,
+	 100947,   33667,   33820,    8892,   34789,    9063,    9216,    1828,
+	  39634,   10203,   10356,    2018,   11325,    2189,    2342,     331,
+	  59983,   16188,   16341,    3348,   17310,    3519,    3672,     541,
+	  22155,    4659,    4812,     731,    5781,     902,    1055,     123,
+	 346104,  134614,  134767,   42541,  135736,   42712,   42865,   10683,
+	 140581,   43852,   44005,   10873,   44974,   11044,   11197,    2102,
+	 160930,   49837,   49990,   12203,   50959,   12374,   12527,    2312,
+	  55804,   13514,   13667,    2502,   14636,    2673,    2826,     376,
+	 235543,   76171,   76324,   19518,   77293,   19689,   19842,    3852,
+	  82138,   20829,   20982,    4042,   21951,    4213,    4366,     607,
+	 102487,   26814,   26967,    5372,   27936,    5543,    5696,     817,
+	  32781,    6683,    6836,    1007,    7805,    1178,    1331,     147,
+
+	      0,       1,      19,       2,     190,      21,      39,       3,
+	   1330,     211,     229,      23,     400,      42,      60,       4,
+	   7315,    1541,    1559,     233,    1730,     252,     270,      25,
+	   2870,     442,     460,      45,     631,      64,      82,       5,
+	  33649,    8856,    8874,    1773,    9045,    1792,    1810,     256,
+	  10185,    1982,    2000,     276,    2171,     295,     313,      27,
+	  16170,    3312,    3330,     486,    3501,     505,     523,      48,
+	   4641,     695,     713,      68,     884,      87,     105,       6,
+	 134596,   42505,   42523,   10628,   42694,   10647,   10665,    2027,
+	  43834,   10837,   10855,    2047,   11026,    2066,    2084,     280,
+	  49819,   12167,   12185,    2257,   12356,    2276,    2294,     301,
+	  13496,    2466,    2484,     321,    2655,     340,     358,      29,
+	  76153,   19482,   19500,    3797,   19671,    3816,    3834,     532,
+	  20811,    4006,    4024,     552,    4195,     571,     589,      51,
+	  26796,    5336,    5354,     762,    5525,     781,     799,      72,
+	   6665,     971,     989,      92,    1160,     111,     129,       7,
+
+	      0,       0,       1,       0,      20,       1,       2,       0,
+	    210,      21,      22,       1,      41,       2,       3,       0,
+	   1540,     231,     232,      22,     251,      23,      24,       1,
+	    441,      43,      44,       2,      63,       3,       4,       0,
+	   8855,    1771,    1772,     253,    1791,     254,     255,      23,
+	   1981,     274,     275,      24,     294,      25,      26,       1,
+	   3311,     484,     485,      45,     504,      46,      47,       2,
+	    694,      66,      67,       3,      86,       4,       5,       0,
+	  42504,   10626,   10627,    2024,   10646,    2025,    2026,     276,
+	  10836,    2045,    2046,     277,    2065,     278,     279,      24,
+	  12166,    2255,    2256,     298,    2275,     299,     300,      25,
+	   2465,     319,     320,      26,     339,      27,      28,       1,
+	  19481,    3795,    3796,     529,    3815,     530,     531,      47,
+	   4005,     550,     551,      48,     570,      49,      50,       2,
+	   5335,     760,     761,      69,     780,      70,      71,       3,
+	    970,      90,      91,       4,     110,       5,       6,       0,
+};
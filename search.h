@@ -55,6 +55,16 @@ enum {
 	IDA_VERBOSE = 1 << 1,
 	/* verify that a correct path was found */
 	IDA_VERIFY = 1 << 2,
+	/* search with pdb_jobs threads */
+	IDA_PARALLEL = 1 << 3,
+	/* start each iteration from a stored frontier */
+	IDA_FRONTIER = 1 << 4,
+	/* continue the search from ida_checkpoint */
+	IDA_RESUME = 1 << 5,
+	/* only generate children within the bound (EPEIDA*) */
+	IDA_EPE = 1 << 6,
+	/* search backwards from the solved configuration, too */
+	IDA_BIDIRECTIONAL = 1 << 7,
 };
 
 struct path {
@@ -62,6 +72,62 @@ struct path {
 	unsigned char moves[SEARCH_PATH_LEN];
 };
 
+/*
+ * The transposition table used by search_ida_bounded() or NULL if no
+ * transposition table is to be used.  Like pdb_jobs, this is meant to
+ * be set once during program initialization.  As the table only holds
+ * distances to the solved configuration, it may be shared between
+ * multiple searches running at the same time.
+ */
+struct ttable;
+extern struct ttable *ida_ttable;
+
+/*
+ * The perimeter searched towards by search_ida_bounded() or NULL if
+ * the search is to go all the way to the solved configuration.  Like
+ * ida_ttable, this is meant to be set once during program
+ * initialization.  If the catalogue has an endgame table with a larger
+ * radius, that table is used instead.  Nodes on the perimeter are not expanded as their
+ * distance is known.  Nodes with h within the radius of the perimeter
+ * but not on it get their h value raised beyond the radius.  As the
+ * path to the solved configuration is completed from the perimeter,
+ * only one solution is found through each perimeter node, even with
+ * IDA_LAST_FULL.
+ */
+struct perimeter;
+extern struct perimeter *ida_perimeter;
+
+/*
+ * With IDA_BIDIRECTIONAL, search_ida_bounded() searches backwards from
+ * the solved configuration before each iteration, keeping all nodes
+ * whose f value towards the puzzle being solved is within the bound.
+ * The nodes are kept in a perimeter of at most ida_bidirectional_size
+ * bytes which then takes the place of ida_perimeter.  As nodes missing
+ * from this perimeter may only be pruned for the current bound, the
+ * transposition table is not used in a bidirectional search.
+ */
+extern size_t ida_bidirectional_size;
+
+/*
+ * The number of searches each thread interleaves, switching to the
+ * next one whenever PDB entries have been prefetched.  This is used for
+ * the subtrees of a parallel search and by programs driving multiple
+ * searches with search_ida_step().
+ */
+enum { IDA_MAX_INTERLEAVE = 64 };
+extern int ida_interleave;
+
+/*
+ * If ida_checkpoint is not NULL, search_ida_bounded() saves the state
+ * of the search to the file it names after each iteration and every
+ * ida_checkpoint_interval seconds during an iteration.  With
+ * IDA_RESUME, the search is continued from that file if it holds a
+ * checkpoint for the same puzzle.  A parallel search is only saved
+ * and resumed at the beginning of an iteration.
+ */
+extern const char *ida_checkpoint;
+extern int ida_checkpoint_interval;
+
 /* search.c */
 extern void	 path_string(char[PATH_STR_LEN], const struct path *);
 extern char	*path_parse(struct path *, const char *);
@@ -71,4 +137,12 @@ extern void	 path_walk(struct puzzle *, const struct path *);
 extern unsigned long long	search_ida(struct pdb_catalogue *, const struct fsm *, const struct puzzle *, struct path *, void (*)(const struct path *, void *), void *, int);
 extern unsigned long long	search_ida_bounded(struct pdb_catalogue *, const struct fsm *, const struct puzzle *, size_t, struct path *, void (*)(const struct path *, void *), void *, int);
 
+/* step by step searches */
+struct ida_search;
+extern struct ida_search	*search_ida_start(struct pdb_catalogue *, const struct fsm *, const struct puzzle *, size_t, struct path *, void (*)(const struct path *, void *), void *, int);
+extern int			 search_ida_step(struct ida_search *);
+extern unsigned long long	 search_ida_finish(struct ida_search *);
+extern int			 search_ida_save(const struct ida_search *, const char *);
+extern int			 search_ida_load(struct ida_search *, const char *);
+
 #endif /* SEARCH_H */
@@ -26,6 +26,7 @@
 /* indexbench.c -- benchmark the performance of compute_index() */
 
 #define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -34,6 +35,7 @@
 
 #include "puzzle.h"
 #include "index.h"
+#include "isa.h"
 #include "random.h"
 #include "pdb.h"
 
@@ -70,6 +72,8 @@ static tileset bench_ts[TESTWIDTH] = {
 enum {
 	WANT_LOOKUP = 1 << 0,
 	WANT_ZPDB = 1 << 1,
+	WANT_VECTOR = 1 << 2,
+	WANT_INVERT = 1 << 3,
 };
 
 /*
@@ -99,16 +103,47 @@ randomize(struct patterndb *pdb)
 
 /*
  * Benchmark: compute the indices for npuzzle puzzles in npdb pdbs.  If
- * flags & WANT_LOOKUP, also look the result up in the pdbs.
+ * flags & WANT_LOOKUP, also look the result up in the pdbs.  If
+ * flags & WANT_VECTOR, use the vectorised functions from indexvec.c.
+ * If flags & WANT_INVERT, also invert each index with invert_index().
  */
 static void
 dobench(struct patterndb **pdbs, const tileset *tilesets, size_t npdb,
     const struct puzzle *puzzles, size_t npuzzle, int flags)
 {
 	struct index idx;
+	struct puzzle p;
+	const atomic_uchar *tables[TESTWIDTH];
+	permindex pidx[TESTWIDTH];
+	tsrank maprank[TESTWIDTH];
+	tileset tsnz[TESTWIDTH];
 	size_t i, j;
 	volatile int sink; /* prevent the compiler from optimising this away */
-	int sum;
+	int sum, h[TESTWIDTH];
+
+	if (flags & WANT_VECTOR) {
+		for (j = 0; j < npdb; j++) {
+			tsnz[j] = tileset_remove(tilesets[j], ZERO_TILE);
+			tables[j] = pdbs[j]->data;
+		}
+
+		for (i = 0; i < npuzzle; i++) {
+			compute_index_16a6(pidx, maprank, puzzles + i, tsnz);
+			if (flags & WANT_ZPDB)
+				eqclass_offsets_16a6(maprank, pdbs[0]->aux.idxt, zero_location(puzzles + i));
+
+			if (flags & WANT_LOOKUP) {
+				pdb_lookup_16a6(h, pidx, maprank, tables);
+				for (sum = 0, j = 0; j < npdb; j++)
+					sum += h[j];
+
+				sink = sum;
+			} else
+				sink = pidx[0] + maprank[0];
+		}
+
+		return;
+	}
 
 	for (i = 0; i < npuzzle; i++) {
 		sum = 0;
@@ -116,6 +151,11 @@ dobench(struct patterndb **pdbs, const tileset *tilesets, size_t npdb,
 			compute_index(&pdbs[j]->aux, &idx, puzzles + i);
 			if (flags & WANT_LOOKUP)
 				sum += pdb_lookup(pdbs[j], &idx);
+
+			if (flags & WANT_INVERT) {
+				invert_index(&pdbs[j]->aux, &p, &idx);
+				sum += p.grid[j];
+			}
 		}
 
 		sink = sum;
@@ -125,7 +165,7 @@ dobench(struct patterndb **pdbs, const tileset *tilesets, size_t npdb,
 static void
 usage(const char *argv0)
 {
-	fprintf(stderr, "Usage: %s [-lz] [runs]\n", argv0);
+	fprintf(stderr, "Usage: %s [-ilvz] [runs]\n", argv0);
 	exit(EXIT_FAILURE);
 }
 
@@ -140,8 +180,12 @@ main(int argc, char *argv[])
 	size_t i;
 	int optchar, flags = 0;
 
-	while (optchar = getopt(argc, argv, "lz"), optchar != -1)
+	while (optchar = getopt(argc, argv, "ilvz"), optchar != -1)
 		switch (optchar) {
+		case 'i':
+			flags |= WANT_INVERT;
+			break;
+
 		case 'z':
 			flags |= WANT_ZPDB;
 			break;
@@ -150,6 +194,10 @@ main(int argc, char *argv[])
 			flags |= WANT_LOOKUP;
 			break;
 
+		case 'v':
+			flags |= WANT_VECTOR;
+			break;
+
 		default:
 			usage(argv[0]);
 		}
@@ -216,7 +264,8 @@ main(int argc, char *argv[])
 	fend = end.tv_sec + end.tv_nsec / 1e9;
 	dur = fend - fbegin;
 
-	printf("%gs elapsed, %gs per lookup.\n", dur, dur / NPUZZLE / TESTWIDTH / runs);
+	printf("%gs elapsed, %gs per lookup using %s index functions.\n",
+	    dur, dur / NPUZZLE / TESTWIDTH / runs, isa_name(isa_current));
 
 	return (EXIT_SUCCESS);
 }
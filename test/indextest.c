@@ -35,10 +35,14 @@
 #include "puzzle.h"
 #include "tileset.h"
 #include "index.h"
+#include "isa.h"
 #include "random.h"
 
 #define TEST_TS 0x00000fe
 
+/* number of maps in each table for test_lookup() */
+enum { LOOKUP_MAPS = 64 };
+
 /*
  * Check if idx1 and idx2 refer to the same index with respect to ts.
  * Return 1 if they do, 0 if they do not.
@@ -115,6 +119,168 @@ test_index(const struct index_aux *aux, const struct index *idx)
 	return (1);
 }
 
+/*
+ * Walk n random moves from p, updating the index with
+ * compute_index_diff() and checking it against compute_index() after
+ * each move.  Return 1 if they always agree, return 0 and print some
+ * information if they don't.
+ */
+static int
+test_diff(const struct index_aux *aux, struct puzzle *p, size_t n)
+{
+	char puzzle_str[PUZZLE_STR_LEN], index_str[INDEX_STR_LEN];
+	struct index idx, idx2;
+	size_t i, zloc, dest, tile;
+
+	compute_index(aux, &idx, p);
+	for (i = 0; i < n; i++) {
+		zloc = zero_location(p);
+		dest = get_moves(zloc)[random32() % move_count(zloc)];
+		tile = p->grid[dest];
+		move(p, dest);
+
+		compute_index_diff(aux, &idx, p, tile);
+		compute_index(aux, &idx2, p);
+
+		if (!index_equal(aux->ts, &idx, &idx2)) {
+			printf("test_diff failed for 0x%07x moving tile %zu:\n", aux->ts, tile);
+			puzzle_string(puzzle_str, p);
+			puts(puzzle_str);
+			index_string(aux->ts, index_str, &idx);
+			puts(index_str);
+			index_string(aux->ts, index_str, &idx2);
+			puts(index_str);
+
+			return (0);
+		}
+	}
+
+	return (1);
+}
+
+/*
+ * Return a random tile set of six nonzero tiles as used with the
+ * vectorised index functions.
+ */
+static tileset
+random_a6_tileset(void)
+{
+	tileset ts = EMPTY_TILESET;
+
+	while (tileset_count(ts) < 6)
+		ts = tileset_add(ts, 1 + random32() % (TILE_COUNT - 1));
+
+	return (ts);
+}
+
+/*
+ * Compute the indices of p for the first width (8 or 16) tile sets of
+ * ts with compute_index_8a6() or compute_index_16a6() and check them
+ * against compute_index().  Then turn the map ranks into map offsets
+ * with eqclass_offsets_8a6() or eqclass_offsets_16a6() and check them
+ * against index_offset() for the same tile sets with the zero tile.
+ * Return 1 if they always agree, return 0 and print some information
+ * if they don't.
+ */
+static int
+test_vector(const struct puzzle *p, const tileset ts[VECTORWIDTH], size_t width)
+{
+	char puzzle_str[PUZZLE_STR_LEN], index_str[INDEX_STR_LEN];
+	struct index_aux aux;
+	struct index idx;
+	permindex pidx[VECTORWIDTH];
+	tsrank maprank[VECTORWIDTH];
+	size_t i, offset;
+
+	if (width == 8)
+		compute_index_8a6(pidx, maprank, p, ts);
+	else
+		compute_index_16a6(pidx, maprank, p, ts);
+
+	for (i = 0; i < width; i++) {
+		make_index_aux(&aux, ts[i]);
+		compute_index(&aux, &idx, p);
+		if (pidx[i] == idx.pidx && maprank[i] == idx.maprank)
+			continue;
+
+		printf("compute_index_%zua6 failed for 0x%07x in lane %zu: (%u %u) instead of\n",
+		    width, ts[i], i, maprank[i], pidx[i]);
+		index_string(aux.ts, index_str, &idx);
+		puts(index_str);
+		puzzle_string(puzzle_str, p);
+		puts(puzzle_str);
+
+		return (0);
+	}
+
+	/* all tile sets of six nonzero tiles share the same index table */
+	make_index_aux(&aux, tileset_add(ts[0], ZERO_TILE));
+	if (width == 8)
+		eqclass_offsets_8a6(maprank, aux.idxt, zero_location(p));
+	else
+		eqclass_offsets_16a6(maprank, aux.idxt, zero_location(p));
+
+	for (i = 0; i < width; i++) {
+		make_index_aux(&aux, tileset_add(ts[i], ZERO_TILE));
+		compute_index(&aux, &idx, p);
+		offset = index_offset(&aux, &idx) / aux.n_perm;
+		if (maprank[i] == offset)
+			continue;
+
+		printf("eqclass_offsets_%zua6 failed for 0x%07x in lane %zu: %u instead of %zu\n",
+		    width, aux.ts, i, maprank[i], offset);
+		puzzle_string(puzzle_str, p);
+		puts(puzzle_str);
+
+		return (0);
+	}
+
+	return (1);
+}
+
+/*
+ * Look up random entries in width (8 or 16) tables of LOOKUP_MAPS maps
+ * with pdb_lookup_8a6() or pdb_lookup_16a6() and check them against
+ * accessing the tables directly.  The tables are placed at random
+ * alignments in buf, which must hold VECTORWIDTH tables and three
+ * more bytes.  The first lane looks up the last entry of its table.
+ * Return 1 if they agree, return 0 and print some information if they
+ * don't.
+ */
+static int
+test_lookup(const atomic_uchar *buf, size_t width)
+{
+	const atomic_uchar *tables[VECTORWIDTH];
+	permindex pidx[VECTORWIDTH];
+	tsrank maprank[VECTORWIDTH];
+	size_t i, offset;
+	int h[VECTORWIDTH];
+
+	for (i = 0; i < width; i++) {
+		tables[i] = buf + i * LOOKUP_MAPS * A6_PERMUTATIONS + random32() % 4;
+		maprank[i] = i == 0 ? LOOKUP_MAPS - 1 : random32() % LOOKUP_MAPS;
+		pidx[i] = i == 0 ? A6_PERMUTATIONS - 1 : random32() % A6_PERMUTATIONS;
+	}
+
+	if (width == 8)
+		pdb_lookup_8a6(h, pidx, maprank, tables);
+	else
+		pdb_lookup_16a6(h, pidx, maprank, tables);
+
+	for (i = 0; i < width; i++) {
+		offset = (size_t)maprank[i] * A6_PERMUTATIONS + pidx[i];
+		if (h[i] == tables[i][offset])
+			continue;
+
+		printf("pdb_lookup_%zua6 failed in lane %zu at (%u %u): %d instead of %d\n",
+		    width, i, maprank[i], pidx[i], h[i], (int)tables[i][offset]);
+
+		return (0);
+	}
+
+	return (1);
+}
+
 static void
 usage(char *argv0)
 {
@@ -124,12 +290,13 @@ usage(char *argv0)
 extern int
 main(int argc, char *argv[])
 {
-	size_t i, n = 10000;
+	size_t i, j, n = 10000, buflen = VECTORWIDTH * LOOKUP_MAPS * A6_PERMUTATIONS + 3;
 	struct puzzle p;
 	struct index idx;
 	struct index_aux aux;
-	tileset ts = TEST_TS;
-	int optchar;
+	tileset ts = TEST_TS, vts[VECTORWIDTH];
+	atomic_uchar *buf;
+	int optchar, isa;
 
 	while (optchar = getopt(argc, argv, "i:t:"), optchar != -1)
 		switch (optchar) {
@@ -152,17 +319,53 @@ main(int argc, char *argv[])
 	set_seed(time(NULL));
 	make_index_aux(&aux, ts);
 
-	for (i = 0; i < n; i++) {
-		random_puzzle(&p);
-		if (!test_puzzle(&aux, &p))
-			return (EXIT_FAILURE);
+	buf = malloc(buflen);
+	if (buf == NULL) {
+		perror("malloc");
+		return (EXIT_FAILURE);
 	}
 
-	for (i = 0; i < n; i++) {
-		random_index(&aux, &idx);
-		if (!test_index(&aux, &idx))
-			return (EXIT_FAILURE);
+	for (i = 0; i < buflen; i++)
+		buf[i] = random32();
+
+	/* test the index functions for each instruction set extension level */
+	for (isa = ISA_GENERIC; isa <= isa_detect(); isa++) {
+		isa_select(isa);
+
+		for (i = 0; i < n; i++) {
+			random_puzzle(&p);
+			if (!test_puzzle(&aux, &p))
+				goto fail;
+		}
+
+		for (i = 0; i < n; i++) {
+			random_index(&aux, &idx);
+			if (!test_index(&aux, &idx))
+				goto fail;
+		}
+
+		random_puzzle(&p);
+		if (!test_diff(&aux, &p, n))
+			goto fail;
+
+		for (i = 0; i < n; i++) {
+			random_puzzle(&p);
+			for (j = 0; j < VECTORWIDTH; j++)
+				vts[j] = random_a6_tileset();
+
+			if (!test_vector(&p, vts, 8) || !test_vector(&p, vts, VECTORWIDTH))
+				goto fail;
+
+			if (!test_lookup(buf, 8) || !test_lookup(buf, VECTORWIDTH))
+				goto fail;
+		}
 	}
 
+	free(buf);
+
 	return (EXIT_SUCCESS);
+
+fail:
+	printf("using %s index functions\n", isa_name(isa));
+	return (EXIT_FAILURE);
 }
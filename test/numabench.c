@@ -0,0 +1,141 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* numabench.c -- compare PDB lookup rates on local and remote NUMA nodes */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "numa.h"
+
+#ifndef MAP_ANONYMOUS
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* keeps the lookups from being optimised out */
+static volatile unsigned sink;
+
+/*
+ * Perform n lookups at pseudo-random offsets into the size bytes of
+ * table and return the time taken in seconds.  Like PDB lookups, the
+ * lookups are independent of each other.
+ */
+static double
+dobench(const unsigned char *table, size_t size, size_t n)
+{
+	struct timespec begin, end;
+	unsigned long long x = 0x9e3779b97f4a7c15ull;
+	size_t i;
+	unsigned sum = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < n; i++) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		sum += table[x % size];
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	sink = sum;
+
+	return ((end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9);
+}
+
+static void
+usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [-n lookups] [-s size_mb]\n", argv0);
+
+	exit(EXIT_FAILURE);
+}
+
+extern int
+main(int argc, char *argv[])
+{
+	unsigned char *table;
+	size_t size = 1024, n = 100000000;
+	double dur;
+	int optchar, cpunode, memnode, n_nodes;
+
+	while (optchar = getopt(argc, argv, "n:s:"), optchar != -1)
+		switch (optchar) {
+		case 'n':
+			n = strtoull(optarg, NULL, 0);
+			break;
+
+		case 's':
+			size = strtoull(optarg, NULL, 0);
+			break;
+
+		default:
+			usage(argv[0]);
+		}
+
+	if (argc != optind || size == 0)
+		usage(argv[0]);
+
+	size <<= 20;
+	n_nodes = numa_nodes();
+	printf("%d NUMA node%s, %zu MiB table, %zu lookups\n",
+	    n_nodes, n_nodes == 1 ? "" : "s", size >> 20, n);
+
+	for (memnode = 0; memnode < n_nodes; memnode++) {
+		table = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (table == MAP_FAILED) {
+			perror("mmap");
+			return (EXIT_FAILURE);
+		}
+
+		if (numa_bind(table, size, memnode) != 0)
+			perror("numa_bind");
+
+		memset(table, 0x55, size);
+
+		for (cpunode = 0; cpunode < n_nodes; cpunode++) {
+			if (numa_pin(cpunode) != 0)
+				perror("numa_pin");
+
+			/* warm up round */
+			dobench(table, size, n / 10);
+
+			dur = dobench(table, size, n);
+			printf("CPU node %d, memory node %d (%s): %.1f Mlookups/s, %.2f ns per lookup\n",
+			    cpunode, memnode, cpunode == memnode ? "local" : "remote",
+			    n / dur * 1e-6, dur / n * 1e9);
+		}
+
+		munmap(table, size);
+	}
+
+	return (EXIT_SUCCESS);
+}
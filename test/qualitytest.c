@@ -84,7 +84,8 @@ qualitytest_worker(void *qtcfg_arg)
 	size_t histogram[PDB_HISTOGRAM_LEN] = {};
 	size_t bestheu[HEURISTICS_LEN] = {}, onlyheu[HEURISTICS_LEN] = {};
 	size_t i, j, n, old_progress;
-	unsigned dist, tdist, heumap;
+	unsigned long long heumap;
+	unsigned dist, tdist;
 
 	for (;;) {
 		old_progress = atomic_fetch_add(&qtcfg->progress, CHUNK_SIZE);
@@ -121,10 +122,10 @@ qualitytest_worker(void *qtcfg_arg)
 
 			/* is only one bit set in heumap? */
 			if (heumap != 0 && (heumap & heumap - 1) == 0)
-				onlyheu[ctz(heumap)]++;
+				onlyheu[ctzll(heumap)]++;
 
 			for (j = 0; j < qtcfg->cat->n_heuristics; j++)
-				if (heumap & 1 << j)
+				if (heumap & 1ull << j)
 					bestheu[j]++;
 		}
 	}
@@ -76,6 +76,21 @@ alignas(64) const unsigned char automorphisms[AUTOMORPHISM_COUNT][2][32] = {
 };
 #undef PAD
 
+/*
+ * For each automorphism, the direction (as given by move_direction())
+ * a move in each direction becomes when the automorphism is applied.
+ */
+const unsigned char morphed_directions[AUTOMORPHISM_COUNT][4] = {
+	0, 1, 2, 3,
+	1, 3, 0, 2,
+	3, 2, 1, 0,
+	2, 0, 3, 1,
+	1, 0, 3, 2,
+	3, 1, 2, 0,
+	2, 3, 0, 1,
+	0, 2, 1, 3,
+};
+
 /*
  * The result of concatenating different automorphisms.  The first
  * index is the automorphism to be applied first, the second index is
@@ -0,0 +1,105 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* ttable.c -- transposition tables for IDA* */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hugepage.h"
+#include "ttable.h"
+
+/*
+ * Allocate a transposition table using at most size bytes of storage.
+ * The number of buckets is rounded down to a power of two.  If storage
+ * is insufficient or size is too small to hold a single bucket, return
+ * NULL and set errno.  If huge_pages is set, the table is backed by
+ * huge pages.
+ */
+extern struct ttable *
+ttable_allocate(size_t size)
+{
+	struct ttable *tt;
+	size_t n_buckets;
+	int error;
+
+	if (size < sizeof *tt->buckets) {
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	for (n_buckets = 1; n_buckets <= size / sizeof *tt->buckets / 2; n_buckets *= 2)
+		;
+
+	tt = malloc(sizeof *tt);
+	if (tt == NULL)
+		return (NULL);
+
+	if (huge_pages)
+		tt->buckets = huge_alloc(n_buckets * sizeof *tt->buckets, &tt->huge);
+	else {
+		tt->buckets = aligned_alloc(alignof(struct ttable_bucket), n_buckets * sizeof *tt->buckets);
+		tt->huge = HUGE_NONE;
+	}
+
+	if (tt->buckets == NULL) {
+		error = errno;
+		free(tt);
+		errno = error;
+
+		return (NULL);
+	}
+
+	tt->mask = n_buckets - 1;
+	ttable_clear(tt);
+
+	return (tt);
+}
+
+/*
+ * Release all storage associated with tt.
+ */
+extern void
+ttable_free(struct ttable *tt)
+{
+	if (tt->huge != HUGE_NONE)
+		huge_unmap(tt->buckets, (tt->mask + 1) * sizeof *tt->buckets, tt->huge);
+	else
+		free(tt->buckets);
+
+	free(tt);
+}
+
+/*
+ * Remove all entries from tt.  This must not be called while the
+ * table is in use by another thread.
+ */
+extern void
+ttable_clear(struct ttable *tt)
+{
+	memset(tt->buckets, 0, (tt->mask + 1) * sizeof *tt->buckets);
+}
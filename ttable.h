@@ -0,0 +1,152 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* ttable.h -- transposition tables for IDA* */
+
+#ifndef TTABLE_H
+#define TTABLE_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "builtins.h"
+#include "compact.h"
+#include "fsm.h"
+
+/*
+ * A transposition table remembers for configurations seen during the
+ * search a lower bound for their distance to the solved configuration
+ * learned by searching the subtree below them.  As the finite state
+ * machine prunes different moves depending on the path taken, an entry
+ * is keyed by the configuration and the FSM state it was reached with.
+ * The bound only holds for paths accepted by the finite state machine
+ * from that state.
+ *
+ * The table is organised into buckets of two slots each.  The first
+ * slot keeps the entry with the highest distance (i.e. the largest
+ * subtree searched), the second slot is always replaced.  Slots are
+ * read and written without locks.  Each slot holds the key xor'ed with
+ * the data such that torn slots are detected as misses.
+ */
+struct ttable_slot {
+	_Atomic unsigned long long lo, hi, data;
+};
+
+struct ttable_bucket {
+	alignas(64) struct ttable_slot slots[2];
+};
+
+struct ttable {
+	struct ttable_bucket *buckets;
+	size_t mask;	/* number of buckets minus 1 */
+	int huge;	/* how buckets is backed by huge pages */
+};
+
+enum {
+	/* highest distance that can be stored in a transposition table */
+	TTABLE_MAX_H = 255,
+};
+
+/* ttable.c */
+extern struct ttable	*ttable_allocate(size_t);
+extern void	ttable_free(struct ttable *);
+extern void	ttable_clear(struct ttable *);
+
+/*
+ * Compute the bucket in tt for cp and state.
+ */
+static inline struct ttable_bucket *
+ttable_bucket(struct ttable *tt, const struct compact_puzzle *cp, unsigned state)
+{
+	unsigned long long hash;
+
+	hash = (cp->lo ^ (unsigned long long)state << 32) * 0x9e3779b97f4a7c15ull;
+	hash = (hash ^ cp->hi) * 0xc2b2ae3d27d4eb4full;
+
+	return (tt->buckets + ((hash ^ hash >> 32) & tt->mask));
+}
+
+/*
+ * Prefetch the bucket for cp and state.
+ */
+static inline void
+ttable_prefetch(struct ttable *tt, const struct compact_puzzle *cp, unsigned state)
+{
+	prefetch(ttable_bucket(tt, cp, state));
+}
+
+/*
+ * Look up the distance bound stored for cp reached in FSM state
+ * state in tt and return it.  If no entry is present, return 0.
+ */
+static inline unsigned
+ttable_lookup(struct ttable *tt, const struct compact_puzzle *cp, unsigned state)
+{
+	struct ttable_bucket *b = ttable_bucket(tt, cp, state);
+	unsigned long long lo, hi, data;
+	size_t i;
+	unsigned h = 0;
+
+	for (i = 0; i < 2; i++) {
+		data = atomic_load_explicit(&b->slots[i].data, memory_order_relaxed);
+		lo = atomic_load_explicit(&b->slots[i].lo, memory_order_relaxed) ^ data;
+		hi = atomic_load_explicit(&b->slots[i].hi, memory_order_relaxed) ^ data;
+
+		if (lo == cp->lo && hi == cp->hi && data >> 32 == state && (data & 0xff) > h)
+			h = data & 0xff;
+	}
+
+	return (h);
+}
+
+/*
+ * Remember that cp reached in FSM state state is at least h moves
+ * away from the solved configuration.
+ */
+static inline void
+ttable_store(struct ttable *tt, const struct compact_puzzle *cp, unsigned state, unsigned h)
+{
+	struct ttable_bucket *b = ttable_bucket(tt, cp, state);
+	struct ttable_slot *slot;
+	unsigned long long data, olddata;
+
+	if (h > TTABLE_MAX_H)
+		h = TTABLE_MAX_H;
+
+	data = (unsigned long long)state << 32 | h;
+
+	/* replace the first slot if we searched a larger subtree */
+	slot = b->slots + 0;
+	olddata = atomic_load_explicit(&slot->data, memory_order_relaxed);
+	if ((olddata & 0xff) > h)
+		slot = b->slots + 1;
+
+	atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+	atomic_store_explicit(&slot->lo, cp->lo ^ data, memory_order_relaxed);
+	atomic_store_explicit(&slot->hi, cp->hi ^ data, memory_order_relaxed);
+}
+
+#endif /* TTABLE_H */
@@ -0,0 +1,180 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* warmup.c -- bring large tables into memory ahead of time */
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "pdb.h"
+#include "warmup.h"
+
+/*
+ * A table being warmed up.  The table spans len bytes from the page
+ * aligned address base.
+ */
+struct warmup_config {
+	const volatile unsigned char *base;
+	size_t len, pagesize;
+	_Atomic size_t nextchunk;
+};
+
+/*
+ * Extend the region of len bytes at addr to whole pages.  Store the
+ * start of the first page in *base and return the new length.
+ */
+static size_t
+page_align(const void **base, const void *addr, size_t len, size_t pagesize)
+{
+	uintptr_t head = (uintptr_t)addr & (pagesize - 1);
+
+	*base = (const char *)addr - head;
+
+	return ((len + head + pagesize - 1) & ~(pagesize - 1));
+}
+
+/*
+ * Touch one byte of each page in the chunks picked up by this thread
+ * until no chunks are left.
+ */
+static void *
+warmup_worker(void *cfgarg)
+{
+	struct warmup_config *cfg = cfgarg;
+	size_t i, begin, end;
+
+	for (;;) {
+		begin = atomic_fetch_add(&cfg->nextchunk, 1) * WARMUP_CHUNK_SIZE;
+		if (begin >= cfg->len)
+			break;
+
+		end = begin + WARMUP_CHUNK_SIZE;
+		if (end > cfg->len)
+			end = cfg->len;
+
+		for (i = begin; i < end; i += cfg->pagesize)
+			(void)cfg->base[i];
+	}
+
+	return (NULL);
+}
+
+/*
+ * Bring the len bytes of table into memory, using pdb_jobs threads to
+ * fault in its pages.  If flags contains WARMUP_LOCK, also lock the
+ * table into memory.  Return 0 on success.  If the table could not be
+ * locked, return -1 and set errno.  The table is warmed up regardless.
+ */
+extern int
+table_warmup(const void *table, size_t len, int flags)
+{
+	struct warmup_config cfg;
+	pthread_t pool[PDB_MAX_JOBS];
+	const void *base;
+	int i, jobs = pdb_jobs, error;
+
+	cfg.pagesize = sysconf(_SC_PAGESIZE);
+	cfg.len = page_align(&base, table, len, cfg.pagesize);
+	cfg.base = base;
+	cfg.nextchunk = 0;
+
+	/* start readahead for file mappings, the threads then find the pages ready */
+	madvise((void *)base, cfg.len, MADV_WILLNEED);
+
+	if (jobs == 1)
+		warmup_worker(&cfg);
+	else {
+		for (i = 0; i < jobs; i++) {
+			error = pthread_create(pool + i, NULL, warmup_worker, &cfg);
+			if (error == 0)
+				continue;
+
+			/* the calling thread can always warm up the table itself */
+			errno = error;
+			perror("pthread_create");
+			break;
+		}
+
+		jobs = i;
+		if (jobs == 0)
+			warmup_worker(&cfg);
+
+		for (i = 0; i < jobs; i++) {
+			error = pthread_join(pool[i], NULL);
+			if (error == 0)
+				continue;
+
+			errno = error;
+			perror("pthread_join");
+			abort();
+		}
+	}
+
+	if (flags & WARMUP_LOCK)
+		return (mlock(base, cfg.len));
+
+	return (0);
+}
+
+/*
+ * Return how many of the len bytes at table are resident in memory.
+ * If this cannot be found out, return (size_t)-1.
+ */
+extern size_t
+table_resident(const void *table, size_t len)
+{
+	const void *base;
+	size_t i, n_pages, pagesize = sysconf(_SC_PAGESIZE), resident = 0, alen;
+	unsigned char *vec;
+
+	alen = page_align(&base, table, len, pagesize);
+	n_pages = alen / pagesize;
+
+	vec = malloc(n_pages);
+	if (vec == NULL)
+		return ((size_t)-1);
+
+	if (mincore((void *)base, alen, vec) != 0) {
+		free(vec);
+		return ((size_t)-1);
+	}
+
+	for (i = 0; i < n_pages; i++)
+		resident += vec[i] & 1;
+
+	free(vec);
+
+	resident *= pagesize;
+
+	return (resident < len ? resident : len);
+}
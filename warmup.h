@@ -0,0 +1,51 @@
+/*-
+ * Copyright (c) 2020 Robert Clausecker. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* warmup.h -- bring large tables into memory ahead of time */
+
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include <stddef.h>
+
+/*
+ * PDBs are usually mapped from their files and only read from disk as
+ * the search faults in their pages.  table_warmup() instead reads the
+ * whole table ahead of time, touching it with pdb_jobs threads, and
+ * optionally locks it into memory so it cannot be evicted during the
+ * search.  table_resident() tells how much of a table is in memory.
+ */
+enum {
+	/* flags for table_warmup() */
+	WARMUP_LOCK = 1 << 0,	/* lock table into memory with mlock() */
+
+	/* how much of a table each thread touches at once */
+	WARMUP_CHUNK_SIZE = 1024 * 1024,
+};
+
+extern int	table_warmup(const void *, size_t, int);
+extern size_t	table_resident(const void *, size_t);
+
+#endif /* WARMUP_H */